@@ -2,17 +2,956 @@
 #include <vtkXMLUnstructuredGridReader.h>
 #include <vtkUnstructuredGrid.h>
 #include <vtkPoints.h>
-#include <vtkCell.h>
+#include <vtkCellArray.h>
+#include <vtkCellType.h>
 #include <vtkCellData.h>
 #include <vtkPointData.h>
+#include <vtkFieldData.h>
 #include <vtkDoubleArray.h>
+#include <vtkUnsignedCharArray.h>
 #include <vtkDataArray.h>
+#include <vtkArrayDispatch.h>
+#include <vtkDataArrayRange.h>
+#include <vtkIdList.h>
+#include <vtkTypeInt64Array.h>
+#include <vtkMath.h>
+#include <vtkSMPTools.h>
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include <glob.h>
 
-void WriteAbaqusINP(vtkUnstructuredGrid* grid, const std::string& filename)
+// Per-chunk text buffers, kept between sections so their capacity is reused
+struct INPFormatBuffers
 {
-    std::ofstream outFile(filename);
+    std::vector<std::string> chunks;
+    std::vector<char> stream;
+};
+
+void AppendId(std::string& text, vtkIdType value)
+{
+    char digits[24];
+    std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), value);
+    text.append(digits, result.ptr);
+}
+
+// Shortest representation that reads back to the same double
+void AppendReal(std::string& text, double value)
+{
+    char digits[32];
+    std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), value);
+    text.append(digits, result.ptr);
+}
+
+// Format items [0, numItems) with 'format(text, i)'. Items are split into fixed-size chunks
+// that are formatted in parallel and written in order, a batch of chunks at a time so the
+// memory held by the buffers stays bounded.
+template <typename Formatter>
+void WriteFormattedChunks(std::ofstream& outFile, vtkIdType numItems, INPFormatBuffers& buffers, Formatter format)
+{
+    const vtkIdType chunkSize = 16384;
+    const vtkIdType chunksPerBatch = 32;
+    buffers.chunks.resize(chunksPerBatch);
+    for (vtkIdType batchBegin = 0; batchBegin < numItems; batchBegin += chunkSize * chunksPerBatch)
+    {
+        vtkIdType batchEnd = std::min(numItems, batchBegin + chunkSize * chunksPerBatch);
+        vtkIdType numChunks = (batchEnd - batchBegin + chunkSize - 1) / chunkSize;
+        vtkSMPTools::For(0, numChunks, 1, [&](vtkIdType firstChunk, vtkIdType lastChunk)
+        {
+            for (vtkIdType c = firstChunk; c < lastChunk; ++c)
+            {
+                std::string& text = buffers.chunks[c];
+                text.clear();
+                vtkIdType end = std::min(batchEnd, batchBegin + (c + 1) * chunkSize);
+                for (vtkIdType i = batchBegin + c * chunkSize; i < end; ++i)
+                {
+                    format(text, i);
+                }
+            }
+        });
+        for (vtkIdType c = 0; c < numChunks; ++c)
+        {
+            outFile.write(buffers.chunks[c].data(), buffers.chunks[c].size());
+        }
+    }
+}
+
+// Write "id, c0, c1, ..." lines for every tuple of a numeric array. The array is dispatched
+// once to its concrete type, so the values are read from the typed storage directly.
+struct WriteTuplesWorker
+{
+    template <typename ArrayT>
+    void operator()(ArrayT* array, std::ofstream& outFile, INPFormatBuffers& buffers)
+    {
+        const auto values = vtk::DataArrayValueRange(array);
+        const int numComponents = array->GetNumberOfComponents();
+        WriteFormattedChunks(outFile, array->GetNumberOfTuples(), buffers, [&](std::string& text, vtkIdType j)
+        {
+            AppendId(text, j + 1);
+            for (int k = 0; k < numComponents; ++k)
+            {
+                text += ", ";
+                AppendReal(text, static_cast<double>(values[j * numComponents + k]));
+            }
+            text += '\n';
+        });
+    }
+};
+
+void WriteArrayTuples(std::ofstream& outFile, vtkDataArray* dataArray, INPFormatBuffers& buffers)
+{
+    WriteTuplesWorker worker;
+    if (!vtkArrayDispatch::Dispatch::Execute(dataArray, worker, outFile, buffers))
+    {
+        worker(dataArray, outFile, buffers);
+    }
+}
+
+// Abaqus element matching a VTK cell type. 'order' maps Abaqus node positions to VTK point
+// positions; VTK wedges list the first triangle in the opposite direction.
+struct AbaqusElementType
+{
+    int vtkType;
+    const char* name;
+    int numPoints;
+    int order[10];
+};
+
+const AbaqusElementType AbaqusElementTypes[] = {
+    {VTK_TETRA, "C3D4", 4, {0, 1, 2, 3}},
+    {VTK_HEXAHEDRON, "C3D8", 8, {0, 1, 2, 3, 4, 5, 6, 7}},
+    {VTK_WEDGE, "C3D6", 6, {0, 2, 1, 3, 5, 4}},
+    {VTK_QUADRATIC_TETRA, "C3D10", 10, {0, 1, 2, 3, 4, 5, 6, 7, 8, 9}},
+};
+const int NumAbaqusElementTypes = sizeof(AbaqusElementTypes) / sizeof(AbaqusElementTypes[0]);
+
+// Group the cells by element type with a counting sort over the cell types and write one
+// *ELEMENT block per type. Point ids come straight from the cell array storage.
+template <typename CellArrayT>
+void WriteElementBlocks(std::ofstream& outFile, vtkUnsignedCharArray* cellTypes, CellArrayT* offsetsArray,
+                        CellArrayT* connectivityArray, INPFormatBuffers& buffers)
+{
+    int typeToBlock[256];
+    std::fill(typeToBlock, typeToBlock + 256, NumAbaqusElementTypes);
+    for (int b = 0; b < NumAbaqusElementTypes; ++b)
+    {
+        typeToBlock[AbaqusElementTypes[b].vtkType] = b;
+    }
+
+    // Count the cells of each type; the last block collects unsupported types
+    const unsigned char* types = cellTypes->GetPointer(0);
+    vtkIdType numCells = cellTypes->GetNumberOfTuples();
+    std::vector<vtkIdType> blockOffsets(NumAbaqusElementTypes + 3, 0);
+    for (vtkIdType i = 0; i < numCells; ++i)
+    {
+        blockOffsets[typeToBlock[types[i]] + 2]++;
+    }
+    for (int b = 2; b < NumAbaqusElementTypes + 3; ++b)
+    {
+        blockOffsets[b] += blockOffsets[b - 1];
+    }
+
+    // Scatter the cell ids so each block is contiguous and keeps the input order
+    std::vector<vtkIdType> sortedCells(numCells);
+    for (vtkIdType i = 0; i < numCells; ++i)
+    {
+        sortedCells[blockOffsets[typeToBlock[types[i]] + 1]++] = i;
+    }
+
+    vtkIdType numSkipped = numCells - blockOffsets[NumAbaqusElementTypes];
+    if (numSkipped > 0)
+    {
+        std::cerr << "Skipping " << numSkipped << " cells without an Abaqus element type" << std::endl;
+    }
+
+    const auto* offsets = offsetsArray->GetPointer(0);
+    const auto* connectivity = connectivityArray->GetPointer(0);
+    for (int b = 0; b < NumAbaqusElementTypes; ++b)
+    {
+        const AbaqusElementType& elementType = AbaqusElementTypes[b];
+        const vtkIdType* blockCells = sortedCells.data() + blockOffsets[b];
+        vtkIdType blockSize = blockOffsets[b + 1] - blockOffsets[b];
+        if (blockSize == 0)
+        {
+            continue;
+        }
+
+        outFile << "*ELEMENT, TYPE=" << elementType.name << "\n";
+        WriteFormattedChunks(outFile, blockSize, buffers, [&](std::string& text, vtkIdType i)
+        {
+            vtkIdType cellId = blockCells[i];
+            const auto* cellPoints = connectivity + offsets[cellId];
+            AppendId(text, cellId + 1);
+            for (int j = 0; j < elementType.numPoints; ++j)
+            {
+                text += ", ";
+                AppendId(text, static_cast<vtkIdType>(cellPoints[elementType.order[j]]) + 1);
+            }
+            text += '\n';
+        });
+    }
+}
+
+// Cell arrays with one integer component, such as RegionId or Interface, are written as
+// element sets
+bool IsIntegerArray(vtkDataArray* dataArray)
+{
+    if (dataArray->GetNumberOfComponents() != 1)
+    {
+        return false;
+    }
+    switch (dataArray->GetDataType())
+    {
+        case VTK_CHAR:
+        case VTK_SIGNED_CHAR:
+        case VTK_UNSIGNED_CHAR:
+        case VTK_SHORT:
+        case VTK_UNSIGNED_SHORT:
+        case VTK_INT:
+        case VTK_UNSIGNED_INT:
+        case VTK_LONG:
+        case VTK_UNSIGNED_LONG:
+        case VTK_LONG_LONG:
+        case VTK_UNSIGNED_LONG_LONG:
+        case VTK_ID_TYPE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Set name for one value of a cell array, e.g. RegionId_3 (RegionId_m3 for -3)
+std::string GetElementSetName(const char* arrayName, long long value)
+{
+    std::string name = arrayName ? arrayName : "CellData";
+    name += value < 0 ? "_m" : "_";
+    name += std::to_string(value < 0 ? -value : value);
+    return name;
+}
+
+// Write the sorted element ids of one set. Arithmetic progressions of 3 or more ids become
+// GENERATE ranges, the remaining ids are listed 16 per line.
+void WriteElementSet(std::ofstream& outFile, const std::string& name, const vtkIdType* ids, vtkIdType numIds,
+                     INPFormatBuffers& buffers)
+{
+    struct GenerateRange
+    {
+        vtkIdType first;
+        vtkIdType last;
+        vtkIdType increment;
+    };
+    std::vector<GenerateRange> ranges;
+    std::vector<vtkIdType> singles;
+    vtkIdType runBegin = 0;
+    while (runBegin < numIds)
+    {
+        vtkIdType runEnd = runBegin + 1;
+        if (runEnd < numIds)
+        {
+            vtkIdType increment = ids[runEnd] - ids[runBegin];
+            while (runEnd + 1 < numIds && ids[runEnd + 1] - ids[runEnd] == increment)
+            {
+                ++runEnd;
+            }
+            if (runEnd - runBegin >= 2)
+            {
+                ranges.push_back({ids[runBegin], ids[runEnd], increment});
+                runBegin = runEnd + 1;
+                continue;
+            }
+        }
+        singles.push_back(ids[runBegin]);
+        ++runBegin;
+    }
+
+    if (!ranges.empty())
+    {
+        outFile << "*ELSET, ELSET=" << name << ", GENERATE\n";
+        WriteFormattedChunks(outFile, static_cast<vtkIdType>(ranges.size()), buffers, [&](std::string& text, vtkIdType r)
+        {
+            AppendId(text, ranges[r].first + 1);
+            text += ", ";
+            AppendId(text, ranges[r].last + 1);
+            text += ", ";
+            AppendId(text, ranges[r].increment);
+            text += '\n';
+        });
+    }
+    if (!singles.empty())
+    {
+        const vtkIdType idsPerLine = 16;
+        vtkIdType numSingles = static_cast<vtkIdType>(singles.size());
+        outFile << "*ELSET, ELSET=" << name << "\n";
+        WriteFormattedChunks(outFile, (numSingles + idsPerLine - 1) / idsPerLine, buffers, [&](std::string& text, vtkIdType line)
+        {
+            vtkIdType end = std::min(numSingles, (line + 1) * idsPerLine);
+            for (vtkIdType i = line * idsPerLine; i < end; ++i)
+            {
+                if (i > line * idsPerLine)
+                {
+                    text += ", ";
+                }
+                AppendId(text, singles[i] + 1);
+            }
+            text += '\n';
+        });
+    }
+}
+
+// Copy a one-component array to long longs. The array is dispatched to its concrete type so
+// the parallel read goes through the typed storage instead of the shared GetTuple buffer.
+struct ReadIntegerValuesWorker
+{
+    template <typename ArrayT>
+    void operator()(ArrayT* array, std::vector<long long>& values)
+    {
+        const auto range = vtk::DataArrayValueRange<1>(array);
+        vtkSMPTools::For(0, array->GetNumberOfTuples(), [&](vtkIdType begin, vtkIdType end)
+        {
+            for (vtkIdType i = begin; i < end; ++i)
+            {
+                values[i] = static_cast<long long>(range[i]);
+            }
+        });
+    }
+};
+
+// Write an integer cell array as one element set per distinct value. Cell ids are grouped
+// with a parallel counting sort: every block of cells builds a histogram of set indices, the
+// histograms are prefix-summed in (set, block) order and each block scatters its ids on its
+// own, so every set comes out in increasing id order. Returns false, writing nothing, when
+// the array has too many distinct values to be a region labelling.
+bool WriteElementSets(std::ofstream& outFile, vtkDataArray* dataArray, INPFormatBuffers& buffers)
+{
+    const vtkIdType numBlocks = 64;
+    const size_t maxNumSets = 65536;
+    vtkIdType numCells = dataArray->GetNumberOfTuples();
+    vtkIdType blockSize = (numCells + numBlocks - 1) / numBlocks;
+
+    // Read the values and collect the distinct values of each block
+    std::vector<long long> values(numCells);
+    ReadIntegerValuesWorker reader;
+    if (!vtkArrayDispatch::Dispatch::Execute(dataArray, reader, values))
+    {
+        reader(dataArray, values);
+    }
+    std::vector<std::vector<long long>> blockValues(numBlocks);
+    vtkSMPTools::For(0, numBlocks, 1, [&](vtkIdType firstBlock, vtkIdType lastBlock)
+    {
+        for (vtkIdType b = firstBlock; b < lastBlock; ++b)
+        {
+            std::vector<long long>& distinct = blockValues[b];
+            vtkIdType end = std::min(numCells, (b + 1) * blockSize);
+            for (vtkIdType i = b * blockSize; i < end; ++i)
+            {
+                if (distinct.empty() || distinct.back() != values[i])
+                {
+                    distinct.push_back(values[i]);
+                }
+            }
+            std::sort(distinct.begin(), distinct.end());
+            distinct.erase(std::unique(distinct.begin(), distinct.end()), distinct.end());
+        }
+    });
+
+    std::vector<long long> setValues;
+    for (const std::vector<long long>& distinct : blockValues)
+    {
+        setValues.insert(setValues.end(), distinct.begin(), distinct.end());
+    }
+    std::sort(setValues.begin(), setValues.end());
+    setValues.erase(std::unique(setValues.begin(), setValues.end()), setValues.end());
+    if (setValues.size() > maxNumSets)
+    {
+        return false;
+    }
+    vtkIdType numSets = static_cast<vtkIdType>(setValues.size());
+
+    // Histogram of set indices per block
+    std::vector<int> setIndices(numCells);
+    std::vector<vtkIdType> offsets(numBlocks * numSets, 0);
+    vtkSMPTools::For(0, numBlocks, 1, [&](vtkIdType firstBlock, vtkIdType lastBlock)
+    {
+        for (vtkIdType b = firstBlock; b < lastBlock; ++b)
+        {
+            vtkIdType* counts = offsets.data() + b * numSets;
+            vtkIdType end = std::min(numCells, (b + 1) * blockSize);
+            for (vtkIdType i = b * blockSize; i < end; ++i)
+            {
+                setIndices[i] = static_cast<int>(
+                    std::lower_bound(setValues.begin(), setValues.end(), values[i]) - setValues.begin());
+                counts[setIndices[i]]++;
+            }
+        }
+    });
+
+    // Exclusive prefix sum in (set, block) order
+    std::vector<vtkIdType> setOffsets(numSets + 1, 0);
+    vtkIdType total = 0;
+    for (vtkIdType s = 0; s < numSets; ++s)
+    {
+        setOffsets[s] = total;
+        for (vtkIdType b = 0; b < numBlocks; ++b)
+        {
+            vtkIdType count = offsets[b * numSets + s];
+            offsets[b * numSets + s] = total;
+            total += count;
+        }
+    }
+    setOffsets[numSets] = total;
+
+    // Scatter the cell ids
+    std::vector<vtkIdType> sortedCells(numCells);
+    vtkSMPTools::For(0, numBlocks, 1, [&](vtkIdType firstBlock, vtkIdType lastBlock)
+    {
+        for (vtkIdType b = firstBlock; b < lastBlock; ++b)
+        {
+            vtkIdType* next = offsets.data() + b * numSets;
+            vtkIdType end = std::min(numCells, (b + 1) * blockSize);
+            for (vtkIdType i = b * blockSize; i < end; ++i)
+            {
+                sortedCells[next[setIndices[i]]++] = i;
+            }
+        }
+    });
+
+    for (vtkIdType s = 0; s < numSets; ++s)
+    {
+        WriteElementSet(outFile, GetElementSetName(dataArray->GetName(), setValues[s]),
+                        sortedCells.data() + setOffsets[s], setOffsets[s + 1] - setOffsets[s], buffers);
+    }
+    return true;
+}
+
+// Quantized cell of a point for node welding, ordered so points of one cell are adjacent
+struct WeldKey
+{
+    vtkTypeInt64 cell[3];
+    vtkIdType pointId;
+
+    bool operator<(const WeldKey& other) const
+    {
+        return std::tie(cell[0], cell[1], cell[2], pointId) < std::tie(other.cell[0], other.cell[1], other.cell[2], other.pointId);
+    }
+};
+
+template <typename ConnectivityArrayT>
+void RemapConnectivity(ConnectivityArrayT* connectivity, const std::vector<vtkIdType>& pointMap)
+{
+    auto* ids = connectivity->GetPointer(0);
+    vtkSMPTools::For(0, connectivity->GetNumberOfValues(), [&](vtkIdType first, vtkIdType last)
+    {
+        for (vtkIdType i = first; i < last; ++i)
+        {
+            ids[i] = pointMap[ids[i]];
+        }
+    });
+}
+
+// Replace every array of 'data' by the tuples listed in 'ids', in that order
+void GatherArrays(vtkFieldData* data, vtkIdList* ids)
+{
+    for (int i = 0; i < data->GetNumberOfArrays(); ++i)
+    {
+        vtkAbstractArray* array = data->GetAbstractArray(i);
+        vtkSmartPointer<vtkAbstractArray> gathered = vtkSmartPointer<vtkAbstractArray>::Take(array->NewInstance());
+        gathered->SetName(array->GetName());
+        gathered->SetNumberOfComponents(array->GetNumberOfComponents());
+        gathered->SetNumberOfTuples(ids->GetNumberOfIds());
+        array->GetTuples(ids, gathered);
+        data->AddArray(gathered);
+    }
+}
+
+// Merge points closer than 'tolerance'. Points are hashed into cells of size 'tolerance', so
+// matches are found among the 27 neighbouring cells; each point is replaced by the lowest
+// numbered point it matches. Connectivity is remapped in place and point data keeps the
+// values of the surviving points. Returns the number of points removed.
+vtkIdType WeldPoints(vtkUnstructuredGrid* grid, double tolerance)
+{
+    vtkPoints* points = grid->GetPoints();
+    vtkIdType numPoints = points ? points->GetNumberOfPoints() : 0;
+    if (numPoints == 0 || tolerance <= 0.0)
+    {
+        return 0;
+    }
+
+    // Quantize and sort the points by cell
+    std::vector<WeldKey> keys(numPoints);
+    vtkSMPTools::For(0, numPoints, [&](vtkIdType first, vtkIdType last)
+    {
+        for (vtkIdType i = first; i < last; ++i)
+        {
+            double p[3];
+            points->GetPoint(i, p);
+            for (int k = 0; k < 3; ++k)
+            {
+                keys[i].cell[k] = static_cast<vtkTypeInt64>(std::floor(p[k] / tolerance));
+            }
+            keys[i].pointId = i;
+        }
+    });
+    std::vector<WeldKey> sortedKeys = keys;
+    vtkSMPTools::Sort(sortedKeys.begin(), sortedKeys.end());
+
+    // Lowest numbered match of every point, searching the neighbouring cells in parallel
+    std::vector<vtkIdType> pointMap(numPoints);
+    double toleranceSquared = tolerance * tolerance;
+    vtkSMPTools::For(0, numPoints, [&](vtkIdType first, vtkIdType last)
+    {
+        for (vtkIdType i = first; i < last; ++i)
+        {
+            double p[3];
+            points->GetPoint(i, p);
+            vtkIdType match = i;
+            for (int n = 0; n < 27; ++n)
+            {
+                WeldKey neighbor = {{keys[i].cell[0] + n % 3 - 1, keys[i].cell[1] + n / 3 % 3 - 1, keys[i].cell[2] + n / 9 - 1}, 0};
+                std::vector<WeldKey>::const_iterator candidate = std::lower_bound(sortedKeys.begin(), sortedKeys.end(), neighbor);
+                for (; candidate != sortedKeys.end() && candidate->pointId < match &&
+                       std::equal(candidate->cell, candidate->cell + 3, neighbor.cell); ++candidate)
+                {
+                    double q[3];
+                    points->GetPoint(candidate->pointId, q);
+                    if (vtkMath::Distance2BetweenPoints(p, q) <= toleranceSquared)
+                    {
+                        match = candidate->pointId;
+                        break;
+                    }
+                }
+            }
+            pointMap[i] = match;
+        }
+    });
+
+    // Follow chains of matches to the surviving point and number the survivors in order
+    vtkSmartPointer<vtkIdList> keptIds = vtkSmartPointer<vtkIdList>::New();
+    for (vtkIdType i = 0; i < numPoints; ++i)
+    {
+        if (pointMap[i] == i)
+        {
+            pointMap[i] = keptIds->GetNumberOfIds();
+            keptIds->InsertNextId(i);
+        }
+        else
+        {
+            pointMap[i] = pointMap[pointMap[i]];
+        }
+    }
+    vtkIdType numKept = keptIds->GetNumberOfIds();
+    if (numKept == numPoints)
+    {
+        return 0;
+    }
+
+    vtkSmartPointer<vtkPoints> weldedPoints = vtkSmartPointer<vtkPoints>::New();
+    weldedPoints->SetDataType(points->GetDataType());
+    weldedPoints->SetNumberOfPoints(numKept);
+    points->GetData()->GetTuples(keptIds, weldedPoints->GetData());
+
+    GatherArrays(grid->GetPointData(), keptIds);
+
+    vtkCellArray* cells = grid->GetCells();
+    if (cells->IsStorage64Bit())
+    {
+        RemapConnectivity(cells->GetConnectivityArray64(), pointMap);
+    }
+    else
+    {
+        RemapConnectivity(cells->GetConnectivityArray32(), pointMap);
+    }
+    cells->Modified();
+    grid->SetPoints(weldedPoints);
+    return numPoints - numKept;
+}
+
+enum RenumberMethod
+{
+    RenumberNone, RenumberRCM, RenumberHilbert
+};
+
+// Position along a 3D Hilbert curve of a point with 'bits' bits per axis, using Skilling's
+// transform of the axes to the transposed Hilbert index
+uint64_t HilbertIndex(uint32_t x[3], int bits)
+{
+    uint32_t highBit = 1u << (bits - 1);
+    for (uint32_t q = highBit; q > 1; q >>= 1)
+    {
+        uint32_t mask = q - 1;
+        for (int i = 0; i < 3; ++i)
+        {
+            if (x[i] & q)
+            {
+                x[0] ^= mask;
+            }
+            else
+            {
+                uint32_t swap = (x[0] ^ x[i]) & mask;
+                x[0] ^= swap;
+                x[i] ^= swap;
+            }
+        }
+    }
+    x[1] ^= x[0];
+    x[2] ^= x[1];
+    uint32_t flip = 0;
+    for (uint32_t q = highBit; q > 1; q >>= 1)
+    {
+        if (x[2] & q)
+        {
+            flip ^= q - 1;
+        }
+    }
+    uint64_t index = 0;
+    for (int b = bits - 1; b >= 0; --b)
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            index = (index << 1) | (((x[i] ^ flip) >> b) & 1);
+        }
+    }
+    return index;
+}
+
+// Sort ids by key in parallel, keeping the input order for equal keys
+std::vector<vtkIdType> SortByKey(const std::vector<uint64_t>& keys)
+{
+    vtkIdType numItems = static_cast<vtkIdType>(keys.size());
+    std::vector<std::pair<uint64_t, vtkIdType>> pairs(numItems);
+    vtkSMPTools::For(0, numItems, [&](vtkIdType first, vtkIdType last)
+    {
+        for (vtkIdType i = first; i < last; ++i)
+        {
+            pairs[i] = std::make_pair(keys[i], i);
+        }
+    });
+    vtkSMPTools::Sort(pairs.begin(), pairs.end());
+    std::vector<vtkIdType> order(numItems);
+    vtkSMPTools::For(0, numItems, [&](vtkIdType first, vtkIdType last)
+    {
+        for (vtkIdType i = first; i < last; ++i)
+        {
+            order[i] = pairs[i].second;
+        }
+    });
+    return order;
+}
+
+// Hilbert keys of the points, or of the cell centroids, quantized to 21 bits per axis over
+// the grid bounds
+template <typename CellArrayT>
+std::vector<uint64_t> ComputeHilbertKeys(vtkPoints* points, CellArrayT* offsetsArray, CellArrayT* connectivityArray,
+                                         bool cellCentroids)
+{
+    const int bits = 21;
+    double bounds[6];
+    points->GetBounds(bounds);
+    double scale[3];
+    for (int k = 0; k < 3; ++k)
+    {
+        double length = bounds[2 * k + 1] - bounds[2 * k];
+        scale[k] = length > 0.0 ? ((1u << bits) - 1) / length : 0.0;
+    }
+
+    const auto* offsets = offsetsArray->GetPointer(0);
+    const auto* connectivity = connectivityArray->GetPointer(0);
+    vtkIdType numItems = cellCentroids ? offsetsArray->GetNumberOfValues() - 1 : points->GetNumberOfPoints();
+    std::vector<uint64_t> keys(numItems);
+    vtkSMPTools::For(0, numItems, [&](vtkIdType first, vtkIdType last)
+    {
+        for (vtkIdType i = first; i < last; ++i)
+        {
+            double center[3] = {0.0, 0.0, 0.0};
+            if (cellCentroids)
+            {
+                for (auto j = offsets[i]; j < offsets[i + 1]; ++j)
+                {
+                    double p[3];
+                    points->GetPoint(connectivity[j], p);
+                    vtkMath::Add(center, p, center);
+                }
+                vtkMath::MultiplyScalar(center, 1.0 / std::max<vtkIdType>(1, offsets[i + 1] - offsets[i]));
+            }
+            else
+            {
+                points->GetPoint(i, center);
+            }
+            uint32_t x[3];
+            for (int k = 0; k < 3; ++k)
+            {
+                x[k] = static_cast<uint32_t>((center[k] - bounds[2 * k]) * scale[k]);
+            }
+            keys[i] = HilbertIndex(x, bits);
+        }
+    });
+    return keys;
+}
+
+// Reverse Cuthill-McKee order of the node graph, in which points sharing a cell are
+// neighbours. The graph is assembled in parallel from the point-to-cell incidence; the
+// breadth-first search runs per connected component from a pseudo-peripheral start node.
+template <typename CellArrayT>
+std::vector<vtkIdType> ComputeRCMOrder(vtkIdType numPoints, CellArrayT* offsetsArray, CellArrayT* connectivityArray)
+{
+    const auto* offsets = offsetsArray->GetPointer(0);
+    const auto* connectivity = connectivityArray->GetPointer(0);
+    vtkIdType numCells = offsetsArray->GetNumberOfValues() - 1;
+    vtkIdType connectivitySize = offsets[numCells];
+
+    // Cells of every point
+    std::vector<vtkIdType> incidenceOffsets(numPoints + 1, 0);
+    for (vtkIdType j = 0; j < connectivitySize; ++j)
+    {
+        incidenceOffsets[connectivity[j] + 1]++;
+    }
+    for (vtkIdType i = 0; i < numPoints; ++i)
+    {
+        incidenceOffsets[i + 1] += incidenceOffsets[i];
+    }
+    std::vector<vtkIdType> incidence(connectivitySize);
+    std::vector<vtkIdType> fill(incidenceOffsets.begin(), incidenceOffsets.end() - 1);
+    for (vtkIdType c = 0; c < numCells; ++c)
+    {
+        for (auto j = offsets[c]; j < offsets[c + 1]; ++j)
+        {
+            incidence[fill[connectivity[j]]++] = c;
+        }
+    }
+
+    // Distinct neighbours of every point, gathered in parallel
+    std::vector<std::vector<vtkIdType>> neighbors(numPoints);
+    vtkSMPTools::For(0, numPoints, [&](vtkIdType first, vtkIdType last)
+    {
+        for (vtkIdType i = first; i < last; ++i)
+        {
+            std::vector<vtkIdType>& pointNeighbors = neighbors[i];
+            for (vtkIdType k = incidenceOffsets[i]; k < incidenceOffsets[i + 1]; ++k)
+            {
+                vtkIdType c = incidence[k];
+                for (auto j = offsets[c]; j < offsets[c + 1]; ++j)
+                {
+                    if (connectivity[j] != i)
+                    {
+                        pointNeighbors.push_back(connectivity[j]);
+                    }
+                }
+            }
+            std::sort(pointNeighbors.begin(), pointNeighbors.end());
+            pointNeighbors.erase(std::unique(pointNeighbors.begin(), pointNeighbors.end()), pointNeighbors.end());
+        }
+    });
+    vtkSMPTools::For(0, numPoints, [&](vtkIdType first, vtkIdType last)
+    {
+        for (vtkIdType i = first; i < last; ++i)
+        {
+            std::stable_sort(neighbors[i].begin(), neighbors[i].end(), [&](vtkIdType a, vtkIdType b)
+            {
+                return neighbors[a].size() < neighbors[b].size();
+            });
+        }
+    });
+
+    // Breadth-first levels from 'start'; returns the last node reached, which is as far from
+    // 'start' as any
+    std::vector<vtkIdType> order;
+    order.reserve(numPoints);
+    std::vector<char> visited(numPoints, 0);
+    std::vector<vtkIdType> level(numPoints, -1);
+    auto farthestNode = [&](vtkIdType start, std::vector<vtkIdType>& component)
+    {
+        component.clear();
+        component.push_back(start);
+        level[start] = 0;
+        for (size_t head = 0; head < component.size(); ++head)
+        {
+            for (vtkIdType neighbor : neighbors[component[head]])
+            {
+                if (level[neighbor] < 0)
+                {
+                    level[neighbor] = level[component[head]] + 1;
+                    component.push_back(neighbor);
+                }
+            }
+        }
+        vtkIdType farthest = component.back();
+        for (vtkIdType node : component)
+        {
+            if (level[node] == level[farthest] && neighbors[node].size() < neighbors[farthest].size())
+            {
+                farthest = node;
+            }
+        }
+        for (vtkIdType node : component)
+        {
+            level[node] = -1;
+        }
+        return farthest;
+    };
+
+    std::vector<vtkIdType> component;
+    for (vtkIdType seed = 0; seed < numPoints; ++seed)
+    {
+        if (visited[seed])
+        {
+            continue;
+        }
+        vtkIdType start = farthestNode(farthestNode(seed, component), component);
+        size_t componentBegin = order.size();
+        order.push_back(start);
+        visited[start] = 1;
+        for (size_t head = componentBegin; head < order.size(); ++head)
+        {
+            for (vtkIdType neighbor : neighbors[order[head]])
+            {
+                if (!visited[neighbor])
+                {
+                    visited[neighbor] = 1;
+                    order.push_back(neighbor);
+                }
+            }
+        }
+    }
+    std::reverse(order.begin(), order.end());
+    return order;
+}
+
+template <typename CellArrayT>
+void RenumberCells(vtkUnstructuredGrid* grid, CellArrayT* offsetsArray, CellArrayT* connectivityArray,
+                   RenumberMethod method)
+{
+    vtkPoints* points = grid->GetPoints();
+    vtkIdType numPoints = points->GetNumberOfPoints();
+    vtkIdType numCells = offsetsArray->GetNumberOfValues() - 1;
+    const auto* offsets = offsetsArray->GetPointer(0);
+    const auto* connectivity = connectivityArray->GetPointer(0);
+
+    // New order of the points, and the new id of every old point
+    std::vector<vtkIdType> pointOrder = method == RenumberRCM
+        ? ComputeRCMOrder(numPoints, offsetsArray, connectivityArray)
+        : SortByKey(ComputeHilbertKeys(points, offsetsArray, connectivityArray, false));
+    std::vector<vtkIdType> pointRank(numPoints);
+    vtkSMPTools::For(0, numPoints, [&](vtkIdType first, vtkIdType last)
+    {
+        for (vtkIdType i = first; i < last; ++i)
+        {
+            pointRank[pointOrder[i]] = i;
+        }
+    });
+
+    // Cells follow their lowest renumbered point for RCM, their centroid for Hilbert
+    std::vector<uint64_t> cellKeys;
+    if (method == RenumberRCM)
+    {
+        cellKeys.resize(numCells);
+        vtkSMPTools::For(0, numCells, [&](vtkIdType first, vtkIdType last)
+        {
+            for (vtkIdType c = first; c < last; ++c)
+            {
+                vtkIdType lowest = numPoints;
+                for (auto j = offsets[c]; j < offsets[c + 1]; ++j)
+                {
+                    lowest = std::min(lowest, pointRank[connectivity[j]]);
+                }
+                cellKeys[c] = static_cast<uint64_t>(lowest);
+            }
+        });
+    }
+    else
+    {
+        cellKeys = ComputeHilbertKeys(points, offsetsArray, connectivityArray, true);
+    }
+    std::vector<vtkIdType> cellOrder = SortByKey(cellKeys);
+
+    // Rebuild the cells in the new order with renumbered points
+    vtkSmartPointer<vtkTypeInt64Array> newOffsets = vtkSmartPointer<vtkTypeInt64Array>::New();
+    newOffsets->SetNumberOfValues(numCells + 1);
+    vtkTypeInt64* newOffsetData = newOffsets->GetPointer(0);
+    newOffsetData[0] = 0;
+    for (vtkIdType c = 0; c < numCells; ++c)
+    {
+        newOffsetData[c + 1] = newOffsetData[c] + (offsets[cellOrder[c] + 1] - offsets[cellOrder[c]]);
+    }
+    vtkSmartPointer<vtkTypeInt64Array> newConnectivity = vtkSmartPointer<vtkTypeInt64Array>::New();
+    newConnectivity->SetNumberOfValues(newOffsetData[numCells]);
+    vtkTypeInt64* newConnectivityData = newConnectivity->GetPointer(0);
+    vtkSmartPointer<vtkUnsignedCharArray> newTypes = vtkSmartPointer<vtkUnsignedCharArray>::New();
+    newTypes->SetNumberOfValues(numCells);
+    const unsigned char* types = grid->GetCellTypesArray()->GetPointer(0);
+    unsigned char* newTypeData = newTypes->GetPointer(0);
+    vtkSMPTools::For(0, numCells, [&](vtkIdType first, vtkIdType last)
+    {
+        for (vtkIdType c = first; c < last; ++c)
+        {
+            vtkIdType oldCell = cellOrder[c];
+            newTypeData[c] = types[oldCell];
+            vtkTypeInt64* cellPoints = newConnectivityData + newOffsetData[c];
+            for (auto j = offsets[oldCell]; j < offsets[oldCell + 1]; ++j)
+            {
+                *cellPoints++ = pointRank[connectivity[j]];
+            }
+        }
+    });
+
+    vtkSmartPointer<vtkPoints> newPoints = vtkSmartPointer<vtkPoints>::New();
+    newPoints->SetDataType(points->GetDataType());
+    newPoints->SetNumberOfPoints(numPoints);
+    vtkSmartPointer<vtkIdList> pointIds = vtkSmartPointer<vtkIdList>::New();
+    pointIds->SetNumberOfIds(numPoints);
+    std::copy(pointOrder.begin(), pointOrder.end(), pointIds->GetPointer(0));
+    points->GetData()->GetTuples(pointIds, newPoints->GetData());
+    GatherArrays(grid->GetPointData(), pointIds);
+    vtkSmartPointer<vtkIdList> cellIds = vtkSmartPointer<vtkIdList>::New();
+    cellIds->SetNumberOfIds(numCells);
+    std::copy(cellOrder.begin(), cellOrder.end(), cellIds->GetPointer(0));
+    GatherArrays(grid->GetCellData(), cellIds);
+
+    vtkSmartPointer<vtkCellArray> newCells = vtkSmartPointer<vtkCellArray>::New();
+    newCells->SetData(newOffsets, newConnectivity);
+    grid->SetPoints(newPoints);
+    grid->SetCells(newTypes, newCells);
+}
+
+// Reorder nodes and elements to reduce the bandwidth of the assembled system, carrying the
+// point and cell data along
+void RenumberGrid(vtkUnstructuredGrid* grid, RenumberMethod method)
+{
+    if (method == RenumberNone || !grid->GetPoints() || grid->GetNumberOfCells() == 0)
+    {
+        return;
+    }
+    vtkCellArray* cells = grid->GetCells();
+    if (cells->IsStorage64Bit())
+    {
+        RenumberCells(grid, cells->GetOffsetsArray64(), cells->GetConnectivityArray64(), method);
+    }
+    else
+    {
+        RenumberCells(grid, cells->GetOffsetsArray32(), cells->GetConnectivityArray32(), method);
+    }
+}
+
+void WriteAbaqusINP(vtkUnstructuredGrid* grid, const std::string& filename, INPFormatBuffers& buffers)
+{
+    // Give the stream a large buffer before opening so chunk writes go straight to the file
+    buffers.stream.resize(1 << 22);
+    std::ofstream outFile;
+    outFile.rdbuf()->pubsetbuf(buffers.stream.data(), buffers.stream.size());
+    outFile.open(filename, std::ios::binary);
 
     if (!outFile.is_open())
     {
@@ -27,27 +966,33 @@ void WriteAbaqusINP(vtkUnstructuredGrid* grid, const std::string& filename)
     // Write nodes
     outFile << "*NODE\n";
     vtkPoints* points = grid->GetPoints();
-    for (vtkIdType i = 0; i < points->GetNumberOfPoints(); ++i)
+    WriteFormattedChunks(outFile, points->GetNumberOfPoints(), buffers, [&](std::string& text, vtkIdType i)
     {
         double p[3];
         points->GetPoint(i, p);
-        outFile << i + 1 << ", " << p[0] << ", " << p[1] << ", " << p[2] << "\n";
-    }
-
-    // Write elements
-    outFile << "*ELEMENT, TYPE=C3D4\n"; // Assuming tetrahedral elements
-    for (vtkIdType i = 0; i < grid->GetNumberOfCells(); ++i)
-    {
-        vtkCell* cell = grid->GetCell(i);
-        outFile << i + 1;
-        for (vtkIdType j = 0; j < cell->GetNumberOfPoints(); ++j)
+        AppendId(text, i + 1);
+        for (int k = 0; k < 3; ++k)
         {
-            outFile << ", " << cell->GetPointId(j) + 1;
+            text += ", ";
+            AppendReal(text, p[k]);
         }
-        outFile << "\n";
+        text += '\n';
+    });
+
+    // Write elements, one block per element type
+    vtkCellArray* cells = grid->GetCells();
+    if (cells->IsStorage64Bit())
+    {
+        WriteElementBlocks(outFile, grid->GetCellTypesArray(), cells->GetOffsetsArray64(),
+                           cells->GetConnectivityArray64(), buffers);
+    }
+    else
+    {
+        WriteElementBlocks(outFile, grid->GetCellTypesArray(), cells->GetOffsetsArray32(),
+                           cells->GetConnectivityArray32(), buffers);
     }
 
-    // Write point data
+    // Write point data, every component of every numeric array
     vtkPointData* pointData = grid->GetPointData();
     if (pointData)
     {
@@ -56,61 +1001,435 @@ void WriteAbaqusINP(vtkUnstructuredGrid* grid, const std::string& filename)
             vtkDataArray* dataArray = pointData->GetArray(i);
             if (dataArray)
             {
-                std::string dataName = dataArray->GetName();
-                outFile << "*NODAL DATA, NAME=" << dataName << "\n";
-
-                for (vtkIdType j = 0; j < dataArray->GetNumberOfTuples(); ++j)
-                {
-                    double value;
-                    dataArray->GetTuple(j, &value);
-                    outFile << j + 1 << ", " << value << "\n";
-                }
+                outFile << "*NODAL DATA, NAME=" << dataArray->GetName() << "\n";
+                WriteArrayTuples(outFile, dataArray, buffers);
             }
         }
     }
 
-    // Write cell data
+    // Write cell data: integer labels as element sets, other arrays as element data
     vtkCellData* cellData = grid->GetCellData();
     if (cellData)
     {
         for (int i = 0; i < cellData->GetNumberOfArrays(); ++i)
         {
             vtkDataArray* dataArray = cellData->GetArray(i);
+            if (dataArray && IsIntegerArray(dataArray) && WriteElementSets(outFile, dataArray, buffers))
+            {
+                continue;
+            }
             if (dataArray)
             {
-                std::string dataName = dataArray->GetName();
-                outFile << "*ELSET, ELSET=" << dataName << "\n";
+                outFile << "*ELEMENT DATA, NAME=" << dataArray->GetName() << "\n";
+                WriteArrayTuples(outFile, dataArray, buffers);
+            }
+        }
+    }
+
+    outFile.close();
+}
+
+// Input files of a batch: a glob pattern, or a text file listing one path per line
+bool ExpandBatchInputs(const std::string& pattern, std::vector<std::string>& files)
+{
+    if (pattern.find_first_of("*?[") == std::string::npos && std::filesystem::path(pattern).extension() != ".vtu")
+    {
+        std::ifstream listFile(pattern);
+        if (!listFile.is_open())
+        {
+            std::cerr << "Failed to open file list " << pattern << std::endl;
+            return false;
+        }
+        std::string line;
+        while (std::getline(listFile, line))
+        {
+            line.erase(line.find_last_not_of(" \t\r") + 1);
+            if (!line.empty())
+            {
+                files.push_back(line);
+            }
+        }
+        return true;
+    }
+
+    glob_t matches;
+    if (glob(pattern.c_str(), 0, nullptr, &matches) == 0)
+    {
+        files.assign(matches.gl_pathv, matches.gl_pathv + matches.gl_pathc);
+    }
+    globfree(&matches);
+    return true;
+}
+
+// Optional processing between reading and export
+struct ConversionOptions
+{
+    size_t memoryLimit = 0;
+    double weldTolerance = 0.0;
+    RenumberMethod renumber = RenumberNone;
+};
+
+// tree/14 marks its meshes with this field array: its *EQUATION constraints label the nodes
+// by point id + 1, so the points must reach the .inp unwelded and in their original order
+const char* const HangingNodeEquationsName = "HangingNodeEquations";
 
-                for (vtkIdType j = 0; j < dataArray->GetNumberOfTuples(); ++j)
+// Whether the options keep the node labels of the grid, which they must when it has equations
+bool KeepsNodeLabels(vtkUnstructuredGrid* grid, const ConversionOptions& options)
+{
+    bool changesLabels = options.weldTolerance > 0.0 || options.renumber != RenumberNone;
+    return !changesLabels || !grid->GetFieldData()->GetAbstractArray(HangingNodeEquationsName);
+}
+
+// Read the options that follow the file arguments; returns false on an unknown option or
+// on a batch-only option outside batch mode
+bool ParseConversionOptions(int argc, char* argv[], int first, bool batch, ConversionOptions& options, int& numJobs)
+{
+    for (int i = first; i < argc; i += 2)
+    {
+        std::string option = argv[i];
+        if (i + 1 == argc)
+        {
+            std::cerr << "Missing value for option " << option << std::endl;
+            return false;
+        }
+        if (!batch && (option == "--jobs" || option == "--memory-limit"))
+        {
+            std::cerr << "Option " << option << " is only valid with --batch" << std::endl;
+            return false;
+        }
+        if (option == "--jobs")
+        {
+            numJobs = std::max(1, std::atoi(argv[i + 1]));
+        }
+        else if (option == "--memory-limit")
+        {
+            options.memoryLimit = static_cast<size_t>(std::atoll(argv[i + 1])) << 20;
+        }
+        else if (option == "--weld")
+        {
+            options.weldTolerance = std::atof(argv[i + 1]);
+        }
+        else if (option == "--renumber" && std::string(argv[i + 1]) == "rcm")
+        {
+            options.renumber = RenumberRCM;
+        }
+        else if (option == "--renumber" && std::string(argv[i + 1]) == "hilbert")
+        {
+            options.renumber = RenumberHilbert;
+        }
+        else
+        {
+            std::cerr << "Unknown option " << option << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Value of attribute 'name' in an XML tag, or "" when absent
+std::string GetAttribute(const std::string& tag, const char* name)
+{
+    std::string pattern = std::string(" ") + name + "=\"";
+    size_t found = tag.find(pattern);
+    if (found == std::string::npos)
+    {
+        return std::string();
+    }
+    size_t valueBegin = found + pattern.size();
+    return tag.substr(valueBegin, tag.find('"', valueBegin) - valueBegin);
+}
+
+// Bytes the reader will allocate for a VTU file, estimated from its XML header before any
+// data is read: every DataArray at the tuple count of its piece. The header does not give
+// the connectivity length, so it is counted as 8 ids per cell. Only the tags are kept while
+// scanning, and the scan stops at the appended data. Returns false when no piece is found.
+bool EstimateGridMemory(const std::string& filename, size_t& estimate)
+{
+    std::ifstream inFile(filename, std::ios::binary);
+    if (!inFile.is_open())
+    {
+        return false;
+    }
+    estimate = 0;
+    bool foundPiece = false;
+    unsigned long long numPoints = 0;
+    unsigned long long numCells = 0;
+    std::string section;
+    std::string tag;
+    bool inTag = false;
+    char c;
+    while (inFile.get(c))
+    {
+        if (!inTag)
+        {
+            inTag = c == '<';
+            tag.clear();
+            continue;
+        }
+        if (c != '>')
+        {
+            tag += c == '\n' || c == '\t' || c == '\r' ? ' ' : c;
+            continue;
+        }
+        inTag = false;
+        std::string name = tag.substr(0, tag.find_first_of(" /", tag[0] == '/' ? 1 : 0));
+        if (name == "AppendedData")
+        {
+            break;
+        }
+        if (name == "Piece")
+        {
+            numPoints = std::strtoull(GetAttribute(tag, "NumberOfPoints").c_str(), nullptr, 10);
+            numCells = std::strtoull(GetAttribute(tag, "NumberOfCells").c_str(), nullptr, 10);
+            foundPiece = true;
+        }
+        else if (name == "Points" || name == "Cells" || name == "PointData" || name == "CellData")
+        {
+            section = tag.back() == '/' ? std::string() : name;
+        }
+        else if (name == "/Points" || name == "/Cells" || name == "/PointData" || name == "/CellData")
+        {
+            section.clear();
+        }
+        else if (name == "DataArray")
+        {
+            // Type names end in their bit count: Int8 ... Float64
+            std::string type = GetAttribute(tag, "type");
+            size_t typeSize = std::strtoul(type.c_str() + std::min(type.find_first_of("0123456789"), type.size()), nullptr, 10) / 8;
+            unsigned long long numComponents = std::strtoull(GetAttribute(tag, "NumberOfComponents").c_str(), nullptr, 10);
+            unsigned long long numTuples = section == "Points" || section == "PointData" ? numPoints : numCells;
+            if (section == "Cells" && GetAttribute(tag, "Name") == "connectivity")
+            {
+                numTuples = 8 * numCells;
+            }
+            estimate += std::max(typeSize, size_t(1)) * std::max(numComponents, 1ULL) * numTuples;
+        }
+    }
+    return foundPiece;
+}
+
+// Memory shared by the workers of a batch. A worker reserves the estimate of its file before
+// reading it and waits while the other workers' reservations leave too little room, so the
+// files in flight together stay under the limit. A limit of 0 disables the budget.
+struct MemoryBudget
+{
+    size_t limit = 0;
+    size_t reserved = 0;
+    std::mutex mutex;
+    std::condition_variable released;
+};
+
+// Reserve room for one file, waiting until the other workers have released enough. A file
+// is let through on its own when nothing else is reserved.
+void ReserveMemory(MemoryBudget& budget, size_t size)
+{
+    std::unique_lock<std::mutex> lock(budget.mutex);
+    budget.released.wait(lock, [&]() { return budget.reserved == 0 || budget.reserved + size <= budget.limit; });
+    budget.reserved += size;
+}
+
+void ReleaseMemory(MemoryBudget& budget, size_t size)
+{
+    {
+        std::lock_guard<std::mutex> lock(budget.mutex);
+        budget.reserved -= size;
+    }
+    budget.released.notify_all();
+}
+
+// Convert one file with the caller's buffers. With a memory limit, the grid size is
+// estimated from the XML header first: files over the limit on their own are skipped,
+// the others wait for room in the budget before they are read.
+bool ConvertFile(const std::string& inputFilename, const std::string& outputFilename, const ConversionOptions& options,
+                 INPFormatBuffers& buffers, MemoryBudget& budget, std::mutex& reportMutex)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    size_t reservation = 0;
+    if (budget.limit > 0)
+    {
+        if (!EstimateGridMemory(inputFilename, reservation))
+        {
+            std::lock_guard<std::mutex> lock(reportMutex);
+            std::cerr << "Failed to read the VTU header of " << inputFilename << std::endl;
+            return false;
+        }
+        if (reservation > budget.limit)
+        {
+            std::lock_guard<std::mutex> lock(reportMutex);
+            std::cerr << "Skipping " << inputFilename << ": grid needs about " << reservation / (1 << 20)
+                      << " MB, over the memory limit" << std::endl;
+            return false;
+        }
+    }
+    ReserveMemory(budget, reservation);
+
+    vtkSmartPointer<vtkXMLUnstructuredGridReader> reader = vtkSmartPointer<vtkXMLUnstructuredGridReader>::New();
+    reader->SetFileName(inputFilename.c_str());
+    reader->Update();
+    vtkUnstructuredGrid* grid = reader->GetOutput();
+    if (grid->GetNumberOfPoints() == 0)
+    {
+        std::lock_guard<std::mutex> lock(reportMutex);
+        std::cerr << "Skipping " << inputFilename << ": no points read" << std::endl;
+        ReleaseMemory(budget, reservation);
+        return false;
+    }
+    if (!KeepsNodeLabels(grid, options))
+    {
+        std::lock_guard<std::mutex> lock(reportMutex);
+        std::cerr << "Skipping " << inputFilename << ": its hanging-node equations refer to the point ids,"
+                  << " which --weld and --renumber change" << std::endl;
+        ReleaseMemory(budget, reservation);
+        return false;
+    }
+    vtkIdType numWelded = WeldPoints(grid, options.weldTolerance);
+    RenumberGrid(grid, options.renumber);
+    std::chrono::steady_clock::time_point loaded = std::chrono::steady_clock::now();
+
+    WriteAbaqusINP(grid, outputFilename, buffers);
+    std::chrono::steady_clock::time_point written = std::chrono::steady_clock::now();
+    vtkIdType numCells = grid->GetNumberOfCells();
+    reader = nullptr;
+    ReleaseMemory(budget, reservation);
+
+    // Per-file throughput: read and write times, output rate and element rate
+    double readSeconds = std::chrono::duration<double>(loaded - start).count();
+    double writeSeconds = std::chrono::duration<double>(written - loaded).count();
+    std::error_code error;
+    double outputMB = static_cast<double>(std::filesystem::file_size(outputFilename, error)) / (1 << 20);
+    std::lock_guard<std::mutex> lock(reportMutex);
+    std::cout << inputFilename << ": " << numCells << " cells, " << numWelded << " nodes welded, read " << readSeconds
+              << " s, write " << writeSeconds << " s, " << outputMB / std::max(writeSeconds, 1e-9) << " MB/s, "
+              << numCells / std::max(readSeconds + writeSeconds, 1e-9) << " cells/s" << std::endl;
+    return true;
+}
+
+// Convert many files on a bounded pool of worker threads. Each worker keeps its own format
+// buffers, so their capacity carries over from one file to the next.
+int RunBatch(const std::vector<std::string>& files, const std::string& outputDirectory, int numJobs,
+             const ConversionOptions& options)
+{
+    // Outputs are named after the input stem, so inputs sharing a stem would race on one file
+    std::vector<std::string> outputFiles;
+    std::map<std::string, std::string> outputInputs;
+    bool collision = false;
+    for (const std::string& file : files)
+    {
+        std::filesystem::path outputPath = std::filesystem::path(outputDirectory) / std::filesystem::path(file).stem();
+        outputPath += ".inp";
+        outputFiles.push_back(outputPath.lexically_normal().string());
+        auto inserted = outputInputs.emplace(outputFiles.back(), file);
+        if (!inserted.second)
+        {
+            std::cerr << file << " and " << inserted.first->second << " would both write " << outputFiles.back() << std::endl;
+            collision = true;
+        }
+    }
+    if (collision)
+    {
+        return EXIT_FAILURE;
+    }
+
+    std::filesystem::create_directories(outputDirectory);
+    std::atomic<size_t> nextFile(0);
+    std::atomic<int> numFailed(0);
+    std::mutex reportMutex;
+    MemoryBudget budget;
+    budget.limit = options.memoryLimit;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < numJobs; ++t)
+    {
+        workers.emplace_back([&]()
+        {
+            INPFormatBuffers buffers;
+            for (size_t f = nextFile++; f < files.size(); f = nextFile++)
+            {
+                if (!ConvertFile(files[f], outputFiles[f], options, buffers, budget, reportMutex))
                 {
-                    double value;
-                    dataArray->GetTuple(j, &value);
-                    outFile << j + 1 << ", " << value << "\n";
+                    ++numFailed;
                 }
             }
-        }
+        });
+    }
+    for (std::thread& worker : workers)
+    {
+        worker.join();
     }
 
-    outFile.close();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << files.size() - numFailed << " of " << files.size() << " files converted in " << seconds << " s" << std::endl;
+    return numFailed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
 int main(int argc, char* argv[])
 {
     if (argc < 3)
     {
-        std::cerr << "Usage: " << argv[0] << " input.vtu output.inp" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " input.vtu output.inp [--weld tolerance] [--renumber rcm|hilbert]" << std::endl;
+        std::cerr << "       " << argv[0] << " --batch <glob|list.txt> output_dir [--jobs N] [--memory-limit MB] [--weld tolerance]"
+                  << " [--renumber rcm|hilbert]" << std::endl;
+        std::cerr << "The memory limit bounds the files converted at once by their grid size, estimated from the"
+                  << " VTU header; weld and renumber scratch memory is not counted." << std::endl;
         return EXIT_FAILURE;
     }
 
+    if (std::string(argv[1]) == "--batch")
+    {
+        if (argc < 4)
+        {
+            std::cerr << "Batch mode needs an input pattern and an output directory" << std::endl;
+            return EXIT_FAILURE;
+        }
+        int numJobs = std::max(1u, std::thread::hardware_concurrency() / 4);
+        ConversionOptions options;
+        if (!ParseConversionOptions(argc, argv, 4, true, options, numJobs))
+        {
+            return EXIT_FAILURE;
+        }
+
+        std::vector<std::string> files;
+        if (!ExpandBatchInputs(argv[2], files))
+        {
+            return EXIT_FAILURE;
+        }
+        if (files.empty())
+        {
+            std::cerr << "No input files match " << argv[2] << std::endl;
+            return EXIT_FAILURE;
+        }
+        return RunBatch(files, argv[3], numJobs, options);
+    }
+
     std::string inputFilename = argv[1];
     std::string outputFilename = argv[2];
+    ConversionOptions options;
+    int numJobs = 1;
+    if (!ParseConversionOptions(argc, argv, 3, false, options, numJobs))
+    {
+        return EXIT_FAILURE;
+    }
 
     vtkSmartPointer<vtkXMLUnstructuredGridReader> reader = vtkSmartPointer<vtkXMLUnstructuredGridReader>::New();
     reader->SetFileName(inputFilename.c_str());
     reader->Update();
 
     vtkUnstructuredGrid* grid = reader->GetOutput();
-    WriteAbaqusINP(grid, outputFilename);
+    if (!KeepsNodeLabels(grid, options))
+    {
+        std::cerr << inputFilename << " has hanging-node equations that refer to its point ids;"
+                  << " it cannot be converted with --weld or --renumber" << std::endl;
+        return EXIT_FAILURE;
+    }
+    vtkIdType numWelded = WeldPoints(grid, options.weldTolerance);
+    if (numWelded > 0)
+    {
+        std::cout << "Welded " << numWelded << " coincident nodes" << std::endl;
+    }
+    RenumberGrid(grid, options.renumber);
+    INPFormatBuffers buffers;
+    WriteAbaqusINP(grid, outputFilename, buffers);
 
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,348 @@
+#include <vtkSmartPointer.h>
+#include <vtkRectilinearGrid.h>
+#include <vtkSphere.h>
+#include <vtkXMLRectilinearGridWriter.h>
+#include <vtkDoubleArray.h>
+#include <vtkUnsignedCharArray.h>
+#include <vtkPointData.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+// A run of identical labels along x, starting at voxel 'start'
+struct LabelRun
+{
+    int start;
+    int length;
+    unsigned char value;
+};
+
+// Label volume stored as one run list per (y, z) row. Rows are indexed
+// z * dims[1] + y and the runs of row r are runs[rowOffsets[r] .. rowOffsets[r + 1]).
+struct RunLengthVolume
+{
+    int dims[3];
+    std::vector<vtkIdType> rowOffsets;
+    std::vector<LabelRun> runs;
+
+    vtkIdType GetNumberOfRows() const { return static_cast<vtkIdType>(dims[1]) * dims[2]; }
+    vtkIdType GetRowIndex(int y, int z) const { return static_cast<vtkIdType>(z) * dims[1] + y; }
+};
+
+// Half-open voxel interval [first, second) along x
+typedef std::pair<int, int> Interval;
+
+void InitializeVolume(RunLengthVolume& volume, const int dims[3])
+{
+    volume.dims[0] = dims[0];
+    volume.dims[1] = dims[1];
+    volume.dims[2] = dims[2];
+    volume.rowOffsets.clear();
+    volume.rowOffsets.reserve(volume.GetNumberOfRows() + 1);
+    volume.rowOffsets.push_back(0);
+    volume.runs.clear();
+}
+
+// Append a row made of 'foreground' intervals on a background of 0
+void AppendRow(RunLengthVolume& volume, const std::vector<Interval>& intervals, unsigned char foreground)
+{
+    int x = 0;
+    for (const Interval& interval : intervals)
+    {
+        if (interval.first > x) volume.runs.push_back({x, interval.first - x, 0});
+        volume.runs.push_back({interval.first, interval.second - interval.first, foreground});
+        x = interval.second;
+    }
+    if (x < volume.dims[0]) volume.runs.push_back({x, volume.dims[0] - x, 0});
+    volume.rowOffsets.push_back(static_cast<vtkIdType>(volume.runs.size()));
+}
+
+// Collect the intervals of a row whose label is (or is not) 'value'
+void SelectIntervals(const RunLengthVolume& volume, vtkIdType row, unsigned char value, bool equal,
+                     std::vector<Interval>& intervals)
+{
+    intervals.clear();
+    for (vtkIdType r = volume.rowOffsets[row]; r < volume.rowOffsets[row + 1]; r++)
+    {
+        const LabelRun& run = volume.runs[r];
+        if ((run.value == value) != equal) continue;
+        if (!intervals.empty() && intervals.back().second == run.start)
+        {
+            intervals.back().second = run.start + run.length;
+        }
+        else
+        {
+            intervals.push_back(Interval(run.start, run.start + run.length));
+        }
+    }
+}
+
+// Sort and merge overlapping or touching intervals in place
+void MergeIntervals(std::vector<Interval>& intervals)
+{
+    if (intervals.empty()) return;
+    std::sort(intervals.begin(), intervals.end());
+    size_t last = 0;
+    for (size_t i = 1; i < intervals.size(); i++)
+    {
+        if (intervals[i].first <= intervals[last].second)
+        {
+            intervals[last].second = std::max(intervals[last].second, intervals[i].second);
+        }
+        else
+        {
+            intervals[++last] = intervals[i];
+        }
+    }
+    intervals.resize(last + 1);
+}
+
+// Grow sorted disjoint intervals by 'radius' voxels on each side, clipped to [0, n)
+void DilateIntervals(std::vector<Interval>& intervals, int radius, int n)
+{
+    for (Interval& interval : intervals)
+    {
+        interval.first = std::max(0, interval.first - radius);
+        interval.second = std::min(n, interval.second + radius);
+    }
+    MergeIntervals(intervals);
+}
+
+// Append the intersection of two sorted disjoint interval lists to 'result'
+void IntersectIntervals(const std::vector<Interval>& a, const std::vector<Interval>& b, std::vector<Interval>& result)
+{
+    size_t i = 0;
+    size_t j = 0;
+    while (i < a.size() && j < b.size())
+    {
+        int first = std::max(a[i].first, b[j].first);
+        int second = std::min(a[i].second, b[j].second);
+        if (first < second) result.push_back(Interval(first, second));
+        if (a[i].second < b[j].second) i++;
+        else j++;
+    }
+}
+
+// Voxelize a sphere row by row: each row crosses the sphere in at most one interval,
+// so the label volume is built in O(rows) without visiting individual voxels
+void BuildSphereVolume(RunLengthVolume& volume, const int dims[3], const double center[3], double radius)
+{
+    InitializeVolume(volume, dims);
+    std::vector<Interval> intervals;
+    for (int z = 0; z < dims[2]; z++)
+    {
+        for (int y = 0; y < dims[1]; y++)
+        {
+            intervals.clear();
+            double dy = y - center[1];
+            double dz = z - center[2];
+            double remaining = radius * radius - dy * dy - dz * dz;
+            if (remaining >= 0)
+            {
+                double halfWidth = std::sqrt(remaining);
+                int first = std::max(0, static_cast<int>(std::ceil(center[0] - halfWidth)));
+                int last = std::min(dims[0] - 1, static_cast<int>(std::floor(center[0] + halfWidth)));
+                if (first <= last) intervals.push_back(Interval(first, last + 1));
+            }
+            AppendRow(volume, intervals, 1);
+        }
+    }
+}
+
+// Tag labelled voxels that have a 26-neighbor of label 0. For each of the 9 neighbor
+// rows the background intervals are dilated by one voxel in x and intersected with
+// the foreground of the current row, so the cost is proportional to the number of runs.
+void TagInterface(const RunLengthVolume& labels, RunLengthVolume& tags)
+{
+    InitializeVolume(tags, labels.dims);
+    std::vector<Interval> foreground;
+    std::vector<Interval> background;
+    std::vector<Interval> interfaceIntervals;
+    for (int z = 0; z < labels.dims[2]; z++)
+    {
+        for (int y = 0; y < labels.dims[1]; y++)
+        {
+            interfaceIntervals.clear();
+            SelectIntervals(labels, labels.GetRowIndex(y, z), 1, true, foreground);
+            if (!foreground.empty())
+            {
+                for (int dz = -1; dz <= 1; dz++)
+                {
+                    for (int dy = -1; dy <= 1; dy++)
+                    {
+                        int ny = y + dy;
+                        int nz = z + dz;
+                        if (ny < 0 || ny >= labels.dims[1] || nz < 0 || nz >= labels.dims[2]) continue;
+                        SelectIntervals(labels, labels.GetRowIndex(ny, nz), 0, true, background);
+                        DilateIntervals(background, 1, labels.dims[0]);
+                        IntersectIntervals(foreground, background, interfaceIntervals);
+                    }
+                }
+                MergeIntervals(interfaceIntervals);
+            }
+            AppendRow(tags, interfaceIntervals, 1);
+        }
+    }
+}
+
+// Grow the non-zero voxels of a volume by its 26-neighborhood
+void DilateVolume(const RunLengthVolume& input, RunLengthVolume& output)
+{
+    InitializeVolume(output, input.dims);
+    std::vector<Interval> neighbor;
+    std::vector<Interval> dilated;
+    for (int z = 0; z < input.dims[2]; z++)
+    {
+        for (int y = 0; y < input.dims[1]; y++)
+        {
+            dilated.clear();
+            for (int dz = -1; dz <= 1; dz++)
+            {
+                for (int dy = -1; dy <= 1; dy++)
+                {
+                    int ny = y + dy;
+                    int nz = z + dz;
+                    if (ny < 0 || ny >= input.dims[1] || nz < 0 || nz >= input.dims[2]) continue;
+                    SelectIntervals(input, input.GetRowIndex(ny, nz), 0, false, neighbor);
+                    DilateIntervals(neighbor, 1, input.dims[0]);
+                    dilated.insert(dilated.end(), neighbor.begin(), neighbor.end());
+                }
+            }
+            MergeIntervals(dilated);
+            AppendRow(output, dilated, 1);
+        }
+    }
+}
+
+vtkIdType CountValue(const RunLengthVolume& volume, unsigned char value)
+{
+    vtkIdType count = 0;
+    for (const LabelRun& run : volume.runs)
+    {
+        if (run.value == value) count += run.length;
+    }
+    return count;
+}
+
+// Decode the runs into a dense x-fastest array
+void ExpandVolume(const RunLengthVolume& volume, vtkUnsignedCharArray* array)
+{
+    array->SetNumberOfComponents(1);
+    array->SetNumberOfTuples(static_cast<vtkIdType>(volume.dims[0]) * volume.GetNumberOfRows());
+    unsigned char* data = array->GetPointer(0);
+    for (vtkIdType row = 0; row < volume.GetNumberOfRows(); row++)
+    {
+        unsigned char* rowData = data + row * volume.dims[0];
+        for (vtkIdType r = volume.rowOffsets[row]; r < volume.rowOffsets[row + 1]; r++)
+        {
+            const LabelRun& run = volume.runs[r];
+            std::memset(rowData + run.start, run.value, run.length);
+        }
+    }
+}
+
+// Write the compressed volume as-is: magic, dims, run count, row offsets, then
+// (start, length, value) triplets
+bool WriteRunLengthVolume(const RunLengthVolume& volume, const std::string& filename)
+{
+    std::ofstream outFile(filename, std::ios::binary);
+    if (!outFile.is_open())
+    {
+        std::cerr << "Failed to open file " << filename << std::endl;
+        return false;
+    }
+
+    const char magic[4] = {'R', 'L', 'E', '1'};
+    outFile.write(magic, sizeof(magic));
+    int32_t dims[3] = {volume.dims[0], volume.dims[1], volume.dims[2]};
+    outFile.write(reinterpret_cast<const char*>(dims), sizeof(dims));
+    int64_t numRuns = static_cast<int64_t>(volume.runs.size());
+    outFile.write(reinterpret_cast<const char*>(&numRuns), sizeof(numRuns));
+
+    std::vector<int64_t> offsets(volume.rowOffsets.begin(), volume.rowOffsets.end());
+    outFile.write(reinterpret_cast<const char*>(offsets.data()), offsets.size() * sizeof(int64_t));
+
+    std::vector<char> buffer;
+    buffer.reserve(volume.runs.size() * 9);
+    for (const LabelRun& run : volume.runs)
+    {
+        int32_t fields[2] = {run.start, run.length};
+        const char* bytes = reinterpret_cast<const char*>(fields);
+        buffer.insert(buffer.end(), bytes, bytes + sizeof(fields));
+        buffer.push_back(static_cast<char>(run.value));
+    }
+    outFile.write(buffer.data(), buffer.size());
+    return outFile.good();
+}
+
+int main(int argc, char* argv[])
+{
+    // Define grid dimensions
+    int dims[3] = {100, 100, 100};
+
+    // Create a sphere
+    vtkSmartPointer<vtkSphere> sphere = vtkSmartPointer<vtkSphere>::New();
+    sphere->SetCenter(50, 50, 50);
+    sphere->SetRadius(30);
+
+    // Build the run-length encoded label volume directly from the sphere
+    RunLengthVolume labels;
+    BuildSphereVolume(labels, dims, sphere->GetCenter(), sphere->GetRadius());
+
+    // Tag the interface cells using 26 neighbors, then tag their neighbors as well
+    RunLengthVolume tags;
+    TagInterface(labels, tags);
+    RunLengthVolume band;
+    DilateVolume(tags, band);
+
+    std::cout << "Label runs: " << labels.runs.size() << ", inside voxels: " << CountValue(labels, 1) << std::endl;
+    std::cout << "Interface runs: " << tags.runs.size() << ", interface voxels: " << CountValue(tags, 1) << std::endl;
+    std::cout << "Band runs: " << band.runs.size() << ", band voxels: " << CountValue(band, 1) << std::endl;
+
+    // Save the compressed volumes
+    WriteRunLengthVolume(labels, "labels.rle");
+    WriteRunLengthVolume(tags, "interface.rle");
+
+    // Create a rectilinear grid
+    vtkSmartPointer<vtkRectilinearGrid> rectilinearGrid = vtkSmartPointer<vtkRectilinearGrid>::New();
+    rectilinearGrid->SetDimensions(dims);
+
+    vtkSmartPointer<vtkDoubleArray> xCoords = vtkSmartPointer<vtkDoubleArray>::New();
+    vtkSmartPointer<vtkDoubleArray> yCoords = vtkSmartPointer<vtkDoubleArray>::New();
+    vtkSmartPointer<vtkDoubleArray> zCoords = vtkSmartPointer<vtkDoubleArray>::New();
+    for (int i = 0; i < dims[0]; i++) xCoords->InsertNextValue(i);
+    for (int i = 0; i < dims[1]; i++) yCoords->InsertNextValue(i);
+    for (int i = 0; i < dims[2]; i++) zCoords->InsertNextValue(i);
+    rectilinearGrid->SetXCoordinates(xCoords);
+    rectilinearGrid->SetYCoordinates(yCoords);
+    rectilinearGrid->SetZCoordinates(zCoords);
+
+    // Decode the volumes into point data arrays
+    vtkSmartPointer<vtkUnsignedCharArray> scalars = vtkSmartPointer<vtkUnsignedCharArray>::New();
+    scalars->SetName("Scalars");
+    ExpandVolume(labels, scalars);
+    rectilinearGrid->GetPointData()->SetScalars(scalars);
+
+    vtkSmartPointer<vtkUnsignedCharArray> tagArray = vtkSmartPointer<vtkUnsignedCharArray>::New();
+    tagArray->SetName("Interface");
+    ExpandVolume(tags, tagArray);
+    rectilinearGrid->GetPointData()->AddArray(tagArray);
+
+    vtkSmartPointer<vtkUnsignedCharArray> bandArray = vtkSmartPointer<vtkUnsignedCharArray>::New();
+    bandArray->SetName("InterfaceBand");
+    ExpandVolume(band, bandArray);
+    rectilinearGrid->GetPointData()->AddArray(bandArray);
+
+    // Save the rectilinear grid data to file
+    vtkSmartPointer<vtkXMLRectilinearGridWriter> writer = vtkSmartPointer<vtkXMLRectilinearGridWriter>::New();
+    writer->SetFileName("output.vtr");
+    writer->SetInputData(rectilinearGrid);
+    writer->Write();
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,525 @@
+// Benchmarks of the interface tagging variants in data/1-8.
+//
+// Each benchmark fills the sphere labels and tags the interface the same way as the
+// corresponding program, on an n^3 volume with the sphere scaled to the volume.
+// Grid construction is done outside of the timed loop. Run with
+//     --benchmark_format=json (or --benchmark_out=results.json)
+// for machine-readable output. Every run reports voxels/s (items_per_second),
+// bytes_per_voxel of the datasets and peak_rss_mb, the high-water mark of the resident set
+// during the run. The mark is reset at the start of every run (Linux, /proc/self/clear_refs),
+// so a run does not report the peak of a larger run before it.
+#include <benchmark/benchmark.h>
+#include <vtkSmartPointer.h>
+#include <vtkImageData.h>
+#include <vtkRectilinearGrid.h>
+#include <vtkUnstructuredGrid.h>
+#include <vtkPoints.h>
+#include <vtkSphere.h>
+#include <vtkSphereSource.h>
+#include <vtkPolyDataToImageStencil.h>
+#include <vtkImageStencil.h>
+#include <vtkImageCast.h>
+#include <vtkCell.h>
+#include <vtkCellData.h>
+#include <vtkPointData.h>
+#include <vtkDoubleArray.h>
+#include <vtkUnsignedCharArray.h>
+#include <fstream>
+#include <string>
+
+vtkSmartPointer<vtkSphere> CreateSphere(int n)
+{
+    vtkSmartPointer<vtkSphere> sphere = vtkSmartPointer<vtkSphere>::New();
+    sphere->SetCenter(0.5 * n, 0.5 * n, 0.5 * n);
+    sphere->SetRadius(0.3 * n);
+    return sphere;
+}
+
+// Reset the high-water mark of the resident set to the current resident set size
+void ResetPeakResident()
+{
+    std::ofstream clearRefs("/proc/self/clear_refs");
+    clearRefs << "5";
+}
+
+// High-water mark of the resident set since the last reset in MiB (VmHWM), 0 if unavailable
+double GetPeakResidentMiB()
+{
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line))
+    {
+        if (line.compare(0, 6, "VmHWM:") == 0)
+        {
+            return std::stod(line.substr(6)) / 1024.0;
+        }
+    }
+    return 0.0;
+}
+
+void ReportCounters(benchmark::State& state, vtkIdType voxels, unsigned long memoryKiB)
+{
+    state.SetItemsProcessed(state.iterations() * voxels);
+    state.counters["bytes_per_voxel"] = 1024.0 * memoryKiB / voxels;
+    state.counters["peak_rss_mb"] = GetPeakResidentMiB();
+}
+
+// Stencil pipeline of data/1-3: the voxels are cleared to 0, the sphere surface is rasterized
+// with vtkPolyDataToImageStencil, the voxels outside it get the background value 1 and the
+// result is cast to unsigned char. data/1-3 hand the implicit vtkSphere to the stencil; here
+// the surface comes from a vtkSphereSource with the same center and radius, and the stencil
+// covers the whole image.
+struct StencilFill
+{
+    vtkSmartPointer<vtkPolyDataToImageStencil> polyDataToImageStencil;
+    vtkSmartPointer<vtkImageStencil> imageStencil;
+    vtkSmartPointer<vtkImageCast> imageCast;
+};
+
+StencilFill CreateStencilFill(vtkImageData* imageData, vtkSphere* sphere)
+{
+    vtkSmartPointer<vtkSphereSource> sphereSource = vtkSmartPointer<vtkSphereSource>::New();
+    sphereSource->SetCenter(sphere->GetCenter());
+    sphereSource->SetRadius(sphere->GetRadius());
+    sphereSource->SetThetaResolution(64);
+    sphereSource->SetPhiResolution(64);
+
+    StencilFill fill;
+    fill.polyDataToImageStencil = vtkSmartPointer<vtkPolyDataToImageStencil>::New();
+    fill.polyDataToImageStencil->SetInputConnection(sphereSource->GetOutputPort());
+    fill.polyDataToImageStencil->SetOutputOrigin(imageData->GetOrigin());
+    fill.polyDataToImageStencil->SetOutputSpacing(imageData->GetSpacing());
+    fill.polyDataToImageStencil->SetOutputWholeExtent(imageData->GetExtent());
+
+    fill.imageStencil = vtkSmartPointer<vtkImageStencil>::New();
+    fill.imageStencil->SetInputData(imageData);
+    fill.imageStencil->SetStencilConnection(fill.polyDataToImageStencil->GetOutputPort());
+    fill.imageStencil->ReverseStencilOff();
+    fill.imageStencil->SetBackgroundValue(1);
+
+    fill.imageCast = vtkSmartPointer<vtkImageCast>::New();
+    fill.imageCast->SetInputConnection(fill.imageStencil->GetOutputPort());
+    fill.imageCast->SetOutputScalarTypeToUnsignedChar();
+    return fill;
+}
+
+// Run the whole stencil pipeline again and return the labelled image
+vtkImageData* UpdateStencilFill(StencilFill& fill, vtkImageData* imageData)
+{
+    int* dims = imageData->GetDimensions();
+    for (int z = 0; z < dims[2]; z++)
+    {
+        for (int y = 0; y < dims[1]; y++)
+        {
+            for (int x = 0; x < dims[0]; x++)
+            {
+                unsigned char* pixel = static_cast<unsigned char*>(imageData->GetScalarPointer(x, y, z));
+                pixel[0] = 0;
+            }
+        }
+    }
+    imageData->Modified();
+    fill.polyDataToImageStencil->Modified();
+    fill.imageCast->Update();
+    return fill.imageCast->GetOutput();
+}
+
+// Fill an image with the sphere through GetScalarPointer, as in data/8
+void FillImage(vtkImageData* imageData, vtkSphere* sphere)
+{
+    int* dims = imageData->GetDimensions();
+    for (int z = 0; z < dims[2]; z++)
+    {
+        for (int y = 0; y < dims[1]; y++)
+        {
+            for (int x = 0; x < dims[0]; x++)
+            {
+                double p[3] = {static_cast<double>(x), static_cast<double>(y), static_cast<double>(z)};
+                unsigned char* pixel = static_cast<unsigned char*>(imageData->GetScalarPointer(x, y, z));
+                pixel[0] = sphere->EvaluateFunction(p) <= 0 ? 1 : 0;
+            }
+        }
+    }
+}
+
+// Image tagging with 26 neighbors, without (data/1) or with (data/3) early exit
+void TagImage26(vtkImageData* imageData, vtkImageData* tagImageData, bool earlyExit)
+{
+    int* dims = imageData->GetDimensions();
+    for (int z = 0; z < dims[2]; z++)
+    {
+        for (int y = 0; y < dims[1]; y++)
+        {
+            for (int x = 0; x < dims[0]; x++)
+            {
+                unsigned char* pixel = static_cast<unsigned char*>(imageData->GetScalarPointer(x, y, z));
+                unsigned char* tagPixel = static_cast<unsigned char*>(tagImageData->GetScalarPointer(x, y, z));
+                bool isInterface = false;
+                if (pixel[0] == 1)
+                {
+                    for (int dz = -1; dz <= 1 && !(earlyExit && isInterface); dz++)
+                    {
+                        for (int dy = -1; dy <= 1 && !(earlyExit && isInterface); dy++)
+                        {
+                            for (int dx = -1; dx <= 1 && !(earlyExit && isInterface); dx++)
+                            {
+                                if (dx == 0 && dy == 0 && dz == 0) continue;
+                                int nx = x + dx;
+                                int ny = y + dy;
+                                int nz = z + dz;
+                                if (nx >= 0 && nx < dims[0] && ny >= 0 && ny < dims[1] && nz >= 0 && nz < dims[2])
+                                {
+                                    unsigned char* neighborPixel = static_cast<unsigned char*>(imageData->GetScalarPointer(nx, ny, nz));
+                                    if (neighborPixel[0] == 0)
+                                    {
+                                        isInterface = true;
+                                    }
+                                }
+                            }
+                        }
+                    }
+                }
+                tagPixel[0] = isInterface ? 1 : 0;
+            }
+        }
+    }
+}
+
+// Image tagging with the 6 Cartesian neighbors (data/2)
+void TagImage6(vtkImageData* imageData, vtkImageData* tagImageData)
+{
+    int* dims = imageData->GetDimensions();
+    for (int z = 0; z < dims[2]; z++)
+    {
+        for (int y = 0; y < dims[1]; y++)
+        {
+            for (int x = 0; x < dims[0]; x++)
+            {
+                unsigned char* pixel = static_cast<unsigned char*>(imageData->GetScalarPointer(x, y, z));
+                unsigned char* tagPixel = static_cast<unsigned char*>(tagImageData->GetScalarPointer(x, y, z));
+                bool isInterface = false;
+                if (pixel[0] == 1)
+                {
+                    int neighborCoords[6][3] = {
+                        {x - 1, y, z}, {x + 1, y, z},
+                        {x, y - 1, z}, {x, y + 1, z},
+                        {x, y, z - 1}, {x, y, z + 1}
+                    };
+                    for (int i = 0; i < 6; i++)
+                    {
+                        int nx = neighborCoords[i][0];
+                        int ny = neighborCoords[i][1];
+                        int nz = neighborCoords[i][2];
+                        if (nx >= 0 && nx < dims[0] && ny >= 0 && ny < dims[1] && nz >= 0 && nz < dims[2])
+                        {
+                            unsigned char* neighborPixel = static_cast<unsigned char*>(imageData->GetScalarPointer(nx, ny, nz));
+                            if (neighborPixel[0] == 0)
+                            {
+                                isInterface = true;
+                                break;
+                            }
+                        }
+                    }
+                }
+                tagPixel[0] = isInterface ? 1 : 0;
+            }
+        }
+    }
+}
+
+// Fill a flat label array with the sphere through SetValue, as in data/4 and data/7
+void FillArray(vtkUnsignedCharArray* scalars, const int dims[3], vtkSphere* sphere)
+{
+    for (int z = 0; z < dims[2]; z++)
+    {
+        for (int y = 0; y < dims[1]; y++)
+        {
+            for (int x = 0; x < dims[0]; x++)
+            {
+                double p[3] = {static_cast<double>(x), static_cast<double>(y), static_cast<double>(z)};
+                int index = z * dims[1] * dims[0] + y * dims[0] + x;
+                scalars->SetValue(index, sphere->EvaluateFunction(p) <= 0 ? 1 : 0);
+            }
+        }
+    }
+}
+
+// Flat array tagging with 26 neighbors (data/4), optionally also tagging the
+// neighbors of interface voxels (data/7)
+void TagArray26(vtkUnsignedCharArray* scalars, vtkUnsignedCharArray* tagArray, const int dims[3], bool band)
+{
+    for (int i = 0; i < dims[0] * dims[1] * dims[2]; i++) tagArray->SetValue(i, 0);
+    for (int z = 0; z < dims[2]; z++)
+    {
+        for (int y = 0; y < dims[1]; y++)
+        {
+            for (int x = 0; x < dims[0]; x++)
+            {
+                int index = z * dims[1] * dims[0] + y * dims[0] + x;
+                if (scalars->GetValue(index) != 1) continue;
+                bool isInterface = false;
+                for (int dz = -1; dz <= 1 && !isInterface; dz++)
+                {
+                    for (int dy = -1; dy <= 1 && !isInterface; dy++)
+                    {
+                        for (int dx = -1; dx <= 1 && !isInterface; dx++)
+                        {
+                            if (dx == 0 && dy == 0 && dz == 0) continue;
+                            int nx = x + dx;
+                            int ny = y + dy;
+                            int nz = z + dz;
+                            if (nx >= 0 && nx < dims[0] && ny >= 0 && ny < dims[1] && nz >= 0 && nz < dims[2])
+                            {
+                                int neighborIndex = nz * dims[1] * dims[0] + ny * dims[0] + nx;
+                                if (scalars->GetValue(neighborIndex) == 0)
+                                {
+                                    isInterface = true;
+                                }
+                            }
+                        }
+                    }
+                }
+                if (!isInterface) continue;
+                tagArray->SetValue(index, 1);
+                if (!band) continue;
+                for (int dz = -1; dz <= 1; dz++)
+                {
+                    for (int dy = -1; dy <= 1; dy++)
+                    {
+                        for (int dx = -1; dx <= 1; dx++)
+                        {
+                            int nx = x + dx;
+                            int ny = y + dy;
+                            int nz = z + dz;
+                            if (nx >= 0 && nx < dims[0] && ny >= 0 && ny < dims[1] && nz >= 0 && nz < dims[2])
+                            {
+                                tagArray->SetValue(nz * dims[1] * dims[0] + ny * dims[0] + nx, 1);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Hexahedral grid with unit spacing, as in data/5, data/6 and data/8
+vtkSmartPointer<vtkUnstructuredGrid> CreateHexGrid(const int dims[3])
+{
+    vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
+    points->SetNumberOfPoints(static_cast<vtkIdType>(dims[0]) * dims[1] * dims[2]);
+    vtkIdType pointId = 0;
+    for (int z = 0; z < dims[2]; z++)
+    {
+        for (int y = 0; y < dims[1]; y++)
+        {
+            for (int x = 0; x < dims[0]; x++)
+            {
+                points->SetPoint(pointId++, x, y, z);
+            }
+        }
+    }
+
+    vtkSmartPointer<vtkUnstructuredGrid> unstructuredGrid = vtkSmartPointer<vtkUnstructuredGrid>::New();
+    unstructuredGrid->SetPoints(points);
+    vtkIdType numCells = static_cast<vtkIdType>(dims[0] - 1) * (dims[1] - 1) * (dims[2] - 1);
+    unstructuredGrid->AllocateExact(numCells, 8 * numCells);
+    for (int z = 0; z < dims[2] - 1; z++)
+    {
+        for (int y = 0; y < dims[1] - 1; y++)
+        {
+            for (int x = 0; x < dims[0] - 1; x++)
+            {
+                vtkIdType base = x + y * dims[0] + static_cast<vtkIdType>(z) * dims[0] * dims[1];
+                vtkIdType plane = static_cast<vtkIdType>(dims[0]) * dims[1];
+                vtkIdType ids[8] = {base, base + 1, base + 1 + dims[0], base + dims[0],
+                                    base + plane, base + 1 + plane, base + 1 + dims[0] + plane, base + dims[0] + plane};
+                unstructuredGrid->InsertNextCell(VTK_HEXAHEDRON, 8, ids);
+            }
+        }
+    }
+    return unstructuredGrid;
+}
+
+// Cell tagging by evaluating the sphere at the 26 neighbors of every cell point (data/5),
+// optionally also tagging the neighboring cells (data/6 and data/8)
+void TagUnstructured26(vtkUnstructuredGrid* unstructuredGrid, vtkUnsignedCharArray* tagArray, const int dims[3],
+                       vtkSphere* sphere, bool band)
+{
+    for (vtkIdType cellId = 0; cellId < unstructuredGrid->GetNumberOfCells(); cellId++)
+    {
+        vtkCell* cell = unstructuredGrid->GetCell(cellId);
+        bool isInterface = false;
+        for (int i = 0; i < 8 && !isInterface; i++)
+        {
+            double p[3];
+            unstructuredGrid->GetPoint(cell->GetPointId(i), p);
+            if (sphere->EvaluateFunction(p) > 0) continue;
+            for (int dz = -1; dz <= 1 && !isInterface; dz++)
+            {
+                for (int dy = -1; dy <= 1 && !isInterface; dy++)
+                {
+                    for (int dx = -1; dx <= 1 && !isInterface; dx++)
+                    {
+                        if (dx == 0 && dy == 0 && dz == 0) continue;
+                        double np[3] = {p[0] + dx, p[1] + dy, p[2] + dz};
+                        if (sphere->EvaluateFunction(np) > 0)
+                        {
+                            isInterface = true;
+                        }
+                    }
+                }
+            }
+        }
+        if (!band)
+        {
+            tagArray->SetValue(cellId, isInterface ? 1 : 0);
+            continue;
+        }
+        if (!isInterface)
+        {
+            tagArray->SetValue(cellId, 0);
+            continue;
+        }
+        tagArray->SetValue(cellId, 1);
+        double p[3];
+        unstructuredGrid->GetPoint(cell->GetPointId(0), p);
+        for (int dz = -1; dz <= 1; dz++)
+        {
+            for (int dy = -1; dy <= 1; dy++)
+            {
+                for (int dx = -1; dx <= 1; dx++)
+                {
+                    if (dx == 0 && dy == 0 && dz == 0) continue;
+                    int nx = static_cast<int>(p[0]) + dx;
+                    int ny = static_cast<int>(p[1]) + dy;
+                    int nz = static_cast<int>(p[2]) + dz;
+                    if (nx >= 0 && nx < dims[0] - 1 && ny >= 0 && ny < dims[1] - 1 && nz >= 0 && nz < dims[2] - 1)
+                    {
+                        vtkIdType neighborCellId = nx + ny * (dims[0] - 1) + static_cast<vtkIdType>(nz) * (dims[0] - 1) * (dims[1] - 1);
+                        tagArray->SetValue(neighborCellId, 1);
+                    }
+                }
+            }
+        }
+    }
+}
+
+void BenchmarkImage(benchmark::State& state, int neighbors, bool earlyExit)
+{
+    ResetPeakResident();
+    int n = static_cast<int>(state.range(0));
+    vtkSmartPointer<vtkSphere> sphere = CreateSphere(n);
+    vtkSmartPointer<vtkImageData> imageData = vtkSmartPointer<vtkImageData>::New();
+    imageData->SetDimensions(n, n, n);
+    imageData->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
+    vtkSmartPointer<vtkImageData> tagImageData = vtkSmartPointer<vtkImageData>::New();
+    tagImageData->SetDimensions(n, n, n);
+    tagImageData->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
+    StencilFill fill = CreateStencilFill(imageData, sphere);
+
+    for (auto _ : state)
+    {
+        vtkImageData* labelImageData = UpdateStencilFill(fill, imageData);
+        if (neighbors == 6) TagImage6(labelImageData, tagImageData);
+        else TagImage26(labelImageData, tagImageData, earlyExit);
+        benchmark::ClobberMemory();
+    }
+    ReportCounters(state, imageData->GetNumberOfPoints(),
+                   imageData->GetActualMemorySize() + fill.imageCast->GetOutput()->GetActualMemorySize() +
+                       tagImageData->GetActualMemorySize());
+}
+
+void BenchmarkRectilinear(benchmark::State& state, bool band)
+{
+    ResetPeakResident();
+    int n = static_cast<int>(state.range(0));
+    int dims[3] = {n, n, n};
+    vtkSmartPointer<vtkSphere> sphere = CreateSphere(n);
+    vtkSmartPointer<vtkRectilinearGrid> rectilinearGrid = vtkSmartPointer<vtkRectilinearGrid>::New();
+    rectilinearGrid->SetDimensions(dims);
+    vtkSmartPointer<vtkDoubleArray> coords = vtkSmartPointer<vtkDoubleArray>::New();
+    for (int i = 0; i < n; i++) coords->InsertNextValue(i);
+    rectilinearGrid->SetXCoordinates(coords);
+    rectilinearGrid->SetYCoordinates(coords);
+    rectilinearGrid->SetZCoordinates(coords);
+
+    vtkSmartPointer<vtkUnsignedCharArray> scalars = vtkSmartPointer<vtkUnsignedCharArray>::New();
+    scalars->SetNumberOfTuples(static_cast<vtkIdType>(n) * n * n);
+    rectilinearGrid->GetPointData()->SetScalars(scalars);
+    vtkSmartPointer<vtkUnsignedCharArray> tagArray = vtkSmartPointer<vtkUnsignedCharArray>::New();
+    tagArray->SetName("Interface");
+    tagArray->SetNumberOfTuples(static_cast<vtkIdType>(n) * n * n);
+    rectilinearGrid->GetPointData()->AddArray(tagArray);
+
+    for (auto _ : state)
+    {
+        FillArray(scalars, dims, sphere);
+        TagArray26(scalars, tagArray, dims, band);
+        benchmark::ClobberMemory();
+    }
+    ReportCounters(state, rectilinearGrid->GetNumberOfPoints(), rectilinearGrid->GetActualMemorySize());
+}
+
+void BenchmarkUnstructured(benchmark::State& state, bool band, bool fromImage)
+{
+    ResetPeakResident();
+    int n = static_cast<int>(state.range(0));
+    int dims[3] = {n, n, n};
+    vtkSmartPointer<vtkSphere> sphere = CreateSphere(n);
+    vtkSmartPointer<vtkUnstructuredGrid> unstructuredGrid = CreateHexGrid(dims);
+
+    vtkSmartPointer<vtkUnsignedCharArray> scalars = vtkSmartPointer<vtkUnsignedCharArray>::New();
+    scalars->SetNumberOfTuples(unstructuredGrid->GetNumberOfPoints());
+    unstructuredGrid->GetPointData()->SetScalars(scalars);
+    vtkSmartPointer<vtkImageData> imageData = vtkSmartPointer<vtkImageData>::New();
+    if (fromImage)
+    {
+        imageData->SetDimensions(dims);
+        imageData->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
+    }
+    vtkSmartPointer<vtkUnsignedCharArray> tagArray = vtkSmartPointer<vtkUnsignedCharArray>::New();
+    tagArray->SetName("Interface");
+    tagArray->SetNumberOfTuples(unstructuredGrid->GetNumberOfCells());
+    unstructuredGrid->GetCellData()->AddArray(tagArray);
+
+    for (auto _ : state)
+    {
+        if (fromImage) FillImage(imageData, sphere);
+        else FillArray(scalars, dims, sphere);
+        TagUnstructured26(unstructuredGrid, tagArray, dims, sphere, band);
+        benchmark::ClobberMemory();
+    }
+    ReportCounters(state, unstructuredGrid->GetNumberOfPoints(),
+                   unstructuredGrid->GetActualMemorySize() + (fromImage ? imageData->GetActualMemorySize() : 0));
+}
+
+// data/1: image data, 26 neighbors
+void BM_Image26(benchmark::State& state) { BenchmarkImage(state, 26, false); }
+// data/2: image data, 6 neighbors
+void BM_Image6(benchmark::State& state) { BenchmarkImage(state, 6, true); }
+// data/3: image data, 26 neighbors with early exit
+void BM_Image26EarlyExit(benchmark::State& state) { BenchmarkImage(state, 26, true); }
+// data/4: rectilinear grid, 26 neighbors
+void BM_Rectilinear26(benchmark::State& state) { BenchmarkRectilinear(state, false); }
+// data/5: unstructured hexahedra, 26 neighbors
+void BM_Unstructured26(benchmark::State& state) { BenchmarkUnstructured(state, false, false); }
+// data/6: unstructured hexahedra, interface cells and their neighbors
+void BM_UnstructuredBand(benchmark::State& state) { BenchmarkUnstructured(state, true, false); }
+// data/7: rectilinear grid, interface cells and their neighbors
+void BM_RectilinearBand(benchmark::State& state) { BenchmarkRectilinear(state, true); }
+// data/8: unstructured hexahedra filled from image data, interface cells and their neighbors
+void BM_UnstructuredBandFromImage(benchmark::State& state) { BenchmarkUnstructured(state, true, true); }
+
+// Volumes from 64^3 to 1024^3. The unstructured variants store 8 point ids per cell
+// plus explicit points, which needs tens of GB past 256^3, so they stop there.
+BENCHMARK(BM_Image26)->RangeMultiplier(2)->Range(64, 1024)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_Image6)->RangeMultiplier(2)->Range(64, 1024)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_Image26EarlyExit)->RangeMultiplier(2)->Range(64, 1024)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_Rectilinear26)->RangeMultiplier(2)->Range(64, 1024)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_Unstructured26)->RangeMultiplier(2)->Range(64, 256)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_UnstructuredBand)->RangeMultiplier(2)->Range(64, 256)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_RectilinearBand)->RangeMultiplier(2)->Range(64, 1024)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_UnstructuredBandFromImage)->RangeMultiplier(2)->Range(64, 256)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
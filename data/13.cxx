@@ -0,0 +1,803 @@
+#include <vtkType.h>
+#include <vtkCellType.h>
+#include <vtkSMPTools.h>
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Streaming VTU to Abaqus INP conversion. The VTU file is memory-mapped and its appended raw
+// blocks are decoded chunk by chunk while the INP sections are written, so memory use is
+// bounded by the formatting buffers and not by the mesh size. Only uncompressed, raw-encoded
+// appended data is supported (vtkXMLUnstructuredGridWriter with SetDataModeToAppended(),
+// EncodeAppendedDataOff() and SetCompressorTypeToNone()).
+
+// Read-only memory mapping of a whole file
+struct MappedFile
+{
+    const char* data = nullptr;
+    size_t size = 0;
+    int fd = -1;
+};
+
+bool MapFile(const std::string& filename, MappedFile& file)
+{
+    file.fd = open(filename.c_str(), O_RDONLY);
+    if (file.fd < 0)
+    {
+        return false;
+    }
+    struct stat fileStat;
+    if (fstat(file.fd, &fileStat) != 0 || fileStat.st_size == 0)
+    {
+        close(file.fd);
+        return false;
+    }
+    file.size = static_cast<size_t>(fileStat.st_size);
+    void* address = mmap(nullptr, file.size, PROT_READ, MAP_PRIVATE, file.fd, 0);
+    if (address == MAP_FAILED)
+    {
+        close(file.fd);
+        return false;
+    }
+    file.data = static_cast<const char*>(address);
+    madvise(address, file.size, MADV_SEQUENTIAL);
+    return true;
+}
+
+void UnmapFile(MappedFile& file)
+{
+    if (file.data)
+    {
+        munmap(const_cast<char*>(file.data), file.size);
+        close(file.fd);
+    }
+    file.data = nullptr;
+}
+
+// Let the kernel drop the pages of a block that has been fully consumed
+void ReleaseRange(const MappedFile& file, const char* begin, size_t length)
+{
+    size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t first = static_cast<size_t>(begin - file.data) / pageSize * pageSize;
+    size_t last = std::min(file.size, static_cast<size_t>(begin - file.data) + length);
+    if (last > first)
+    {
+        madvise(const_cast<char*>(file.data) + first, last - first, MADV_DONTNEED);
+    }
+}
+
+enum ValueType
+{
+    TypeInt8, TypeUInt8, TypeInt16, TypeUInt16, TypeInt32, TypeUInt32, TypeInt64, TypeUInt64,
+    TypeFloat32, TypeFloat64, TypeUnknown
+};
+
+ValueType GetValueType(const std::string& name, int& size)
+{
+    const char* names[] = {"Int8", "UInt8", "Int16", "UInt16", "Int32", "UInt32", "Int64", "UInt64", "Float32", "Float64"};
+    const int sizes[] = {1, 1, 2, 2, 4, 4, 8, 8, 4, 8};
+    for (int t = 0; t < TypeUnknown; ++t)
+    {
+        if (name == names[t])
+        {
+            size = sizes[t];
+            return static_cast<ValueType>(t);
+        }
+    }
+    size = 0;
+    return TypeUnknown;
+}
+
+// A DataArray stored in the appended section
+struct AppendedArray
+{
+    std::string name;
+    ValueType type = TypeUnknown;
+    int typeSize = 0;
+    int numComponents = 1;
+    uint64_t offset = 0;
+    bool present = false;
+};
+
+// Decoded view on the raw bytes of an appended block
+struct DataBlock
+{
+    const char* data = nullptr;
+    uint64_t numBytes = 0;
+    ValueType type = TypeUnknown;
+    int numComponents = 1;
+    vtkIdType numValues = 0;
+};
+
+template <typename T>
+T LoadValue(const char* data, vtkIdType i)
+{
+    T value;
+    std::memcpy(&value, data + i * sizeof(T), sizeof(T));
+    return value;
+}
+
+double ReadReal(const DataBlock& block, vtkIdType i)
+{
+    switch (block.type)
+    {
+        case TypeInt8: return LoadValue<int8_t>(block.data, i);
+        case TypeUInt8: return LoadValue<uint8_t>(block.data, i);
+        case TypeInt16: return LoadValue<int16_t>(block.data, i);
+        case TypeUInt16: return LoadValue<uint16_t>(block.data, i);
+        case TypeInt32: return LoadValue<int32_t>(block.data, i);
+        case TypeUInt32: return LoadValue<uint32_t>(block.data, i);
+        case TypeInt64: return static_cast<double>(LoadValue<int64_t>(block.data, i));
+        case TypeUInt64: return static_cast<double>(LoadValue<uint64_t>(block.data, i));
+        case TypeFloat32: return LoadValue<float>(block.data, i);
+        case TypeFloat64: return LoadValue<double>(block.data, i);
+        default: return 0.0;
+    }
+}
+
+vtkIdType ReadInteger(const DataBlock& block, vtkIdType i)
+{
+    switch (block.type)
+    {
+        case TypeInt8: return LoadValue<int8_t>(block.data, i);
+        case TypeUInt8: return LoadValue<uint8_t>(block.data, i);
+        case TypeInt16: return LoadValue<int16_t>(block.data, i);
+        case TypeUInt16: return LoadValue<uint16_t>(block.data, i);
+        case TypeInt32: return LoadValue<int32_t>(block.data, i);
+        case TypeUInt32: return LoadValue<uint32_t>(block.data, i);
+        case TypeInt64: return static_cast<vtkIdType>(LoadValue<int64_t>(block.data, i));
+        case TypeUInt64: return static_cast<vtkIdType>(LoadValue<uint64_t>(block.data, i));
+        case TypeFloat32: return static_cast<vtkIdType>(LoadValue<float>(block.data, i));
+        case TypeFloat64: return static_cast<vtkIdType>(LoadValue<double>(block.data, i));
+        default: return 0;
+    }
+}
+
+// Arrays and sizes found in the XML header of an appended VTU file
+struct VTUFileLayout
+{
+    bool headerUInt64 = false;
+    vtkIdType numPoints = 0;
+    vtkIdType numCells = 0;
+    AppendedArray points;
+    AppendedArray connectivity;
+    AppendedArray offsets;
+    AppendedArray types;
+    std::vector<AppendedArray> pointData;
+    std::vector<AppendedArray> cellData;
+    const char* appendedData = nullptr;
+};
+
+// Value of attribute 'name' in the tag text [tagBegin, tagEnd), or "" when absent
+std::string GetAttribute(const char* tagBegin, const char* tagEnd, const char* name)
+{
+    std::string pattern = std::string(" ") + name + "=\"";
+    const char* found = std::search(tagBegin, tagEnd, pattern.begin(), pattern.end());
+    if (found == tagEnd)
+    {
+        return std::string();
+    }
+    const char* valueBegin = found + pattern.size();
+    const char* valueEnd = std::find(valueBegin, tagEnd, '"');
+    return std::string(valueBegin, valueEnd);
+}
+
+// Integer value of a required attribute; reports the attribute when it is missing or malformed
+template <typename T>
+bool GetIntegerAttribute(const char* tagBegin, const char* tagEnd, const char* name, T& value)
+{
+    std::string text = GetAttribute(tagBegin, tagEnd, name);
+    std::from_chars_result result = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (text.empty() || result.ec != std::errc() || result.ptr != text.data() + text.size())
+    {
+        std::cerr << "Missing or invalid attribute " << name << " in " << std::string(tagBegin, tagEnd + 1) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool ParseLayout(const MappedFile& file, VTUFileLayout& layout)
+{
+    const char* end = file.data + file.size;
+    const char appendedTag[] = "<AppendedData";
+    const char* appended = std::search(file.data, end, appendedTag, appendedTag + sizeof(appendedTag) - 1);
+    if (appended == end)
+    {
+        std::cerr << "No appended data section; write the VTU in appended mode" << std::endl;
+        return false;
+    }
+
+    std::string section;
+    const char* p = file.data;
+    while (true)
+    {
+        const char* tagBegin = std::find(p, appended, '<');
+        if (tagBegin == appended)
+        {
+            break;
+        }
+        const char* tagEnd = std::find(tagBegin, appended, '>');
+        const char* nameEnd = tagBegin + 1;
+        if (*nameEnd == '/')
+        {
+            ++nameEnd;
+        }
+        while (nameEnd < tagEnd && *nameEnd != ' ' && *nameEnd != '/' && *nameEnd != '\n')
+        {
+            ++nameEnd;
+        }
+        std::string name(tagBegin + 1, nameEnd);
+        p = tagEnd;
+
+        if (name == "VTKFile")
+        {
+            if (!GetAttribute(tagBegin, tagEnd, "compressor").empty())
+            {
+                std::cerr << "Compressed VTU files are not supported" << std::endl;
+                return false;
+            }
+            if (GetAttribute(tagBegin, tagEnd, "byte_order") == "BigEndian")
+            {
+                std::cerr << "Big endian VTU files are not supported" << std::endl;
+                return false;
+            }
+            layout.headerUInt64 = GetAttribute(tagBegin, tagEnd, "header_type") == "UInt64";
+        }
+        else if (name == "Piece")
+        {
+            if (!GetIntegerAttribute(tagBegin, tagEnd, "NumberOfPoints", layout.numPoints) ||
+                !GetIntegerAttribute(tagBegin, tagEnd, "NumberOfCells", layout.numCells))
+            {
+                return false;
+            }
+        }
+        else if (name == "Points" || name == "Cells" || name == "CellData" || name == "PointData")
+        {
+            section = *(tagEnd - 1) == '/' ? std::string() : name;
+        }
+        else if (name == "/Points" || name == "/Cells" || name == "/CellData" || name == "/PointData")
+        {
+            section.clear();
+        }
+        else if (name == "DataArray")
+        {
+            AppendedArray array;
+            array.name = GetAttribute(tagBegin, tagEnd, "Name");
+            array.type = GetValueType(GetAttribute(tagBegin, tagEnd, "type"), array.typeSize);
+            if (!GetAttribute(tagBegin, tagEnd, "NumberOfComponents").empty() &&
+                !GetIntegerAttribute(tagBegin, tagEnd, "NumberOfComponents", array.numComponents))
+            {
+                return false;
+            }
+            if (GetAttribute(tagBegin, tagEnd, "format") != "appended" || array.type == TypeUnknown)
+            {
+                std::cerr << "DataArray " << array.name << " is not an appended numeric array" << std::endl;
+                return false;
+            }
+            if (!GetIntegerAttribute(tagBegin, tagEnd, "offset", array.offset))
+            {
+                return false;
+            }
+            array.present = true;
+
+            if (section == "Points") layout.points = array;
+            else if (section == "Cells" && array.name == "connectivity") layout.connectivity = array;
+            else if (section == "Cells" && array.name == "offsets") layout.offsets = array;
+            else if (section == "Cells" && array.name == "types") layout.types = array;
+            else if (section == "PointData") layout.pointData.push_back(array);
+            else if (section == "CellData") layout.cellData.push_back(array);
+        }
+    }
+
+    const char* appendedEnd = std::find(appended, end, '>');
+    if (GetAttribute(appended, appendedEnd, "encoding") != "raw")
+    {
+        std::cerr << "Only raw appended data is supported" << std::endl;
+        return false;
+    }
+    const char* marker = std::find(appendedEnd, end, '_');
+    if (marker == end)
+    {
+        std::cerr << "Missing appended data marker" << std::endl;
+        return false;
+    }
+    layout.appendedData = marker + 1;
+
+    if (!layout.points.present || !layout.connectivity.present || !layout.offsets.present || !layout.types.present)
+    {
+        std::cerr << "Missing points or cells in VTU file" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Locate the bytes of an appended array: a byte count header followed by the raw values
+bool GetDataBlock(const MappedFile& file, const VTUFileLayout& layout, const AppendedArray& array, DataBlock& block)
+{
+    const char* header = layout.appendedData + array.offset;
+    size_t headerSize = layout.headerUInt64 ? 8 : 4;
+    if (header + headerSize > file.data + file.size)
+    {
+        return false;
+    }
+    block.numBytes = layout.headerUInt64 ? LoadValue<uint64_t>(header, 0) : LoadValue<uint32_t>(header, 0);
+    block.data = header + headerSize;
+    if (block.data + block.numBytes > file.data + file.size)
+    {
+        return false;
+    }
+    block.type = array.type;
+    block.numComponents = array.numComponents;
+    block.numValues = static_cast<vtkIdType>(block.numBytes / array.typeSize);
+    return true;
+}
+
+// Per-chunk text buffers, kept between sections so their capacity is reused
+struct INPFormatBuffers
+{
+    std::vector<std::string> chunks;
+    std::vector<char> stream;
+};
+
+void AppendId(std::string& text, vtkIdType value)
+{
+    char digits[24];
+    std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), value);
+    text.append(digits, result.ptr);
+}
+
+// Shortest representation that reads back to the same double
+void AppendReal(std::string& text, double value)
+{
+    char digits[32];
+    std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), value);
+    text.append(digits, result.ptr);
+}
+
+// Format items [0, numItems) with 'format(text, i)'. Items are split into fixed-size chunks
+// that are formatted in parallel and written in order, a batch of chunks at a time so the
+// memory held by the buffers stays bounded.
+template <typename Formatter>
+void WriteFormattedChunks(std::ofstream& outFile, vtkIdType numItems, INPFormatBuffers& buffers, Formatter format)
+{
+    const vtkIdType chunkSize = 16384;
+    const vtkIdType chunksPerBatch = 32;
+    buffers.chunks.resize(chunksPerBatch);
+    for (vtkIdType batchBegin = 0; batchBegin < numItems; batchBegin += chunkSize * chunksPerBatch)
+    {
+        vtkIdType batchEnd = std::min(numItems, batchBegin + chunkSize * chunksPerBatch);
+        vtkIdType numChunks = (batchEnd - batchBegin + chunkSize - 1) / chunkSize;
+        vtkSMPTools::For(0, numChunks, 1, [&](vtkIdType firstChunk, vtkIdType lastChunk)
+        {
+            for (vtkIdType c = firstChunk; c < lastChunk; ++c)
+            {
+                std::string& text = buffers.chunks[c];
+                text.clear();
+                vtkIdType end = std::min(batchEnd, batchBegin + (c + 1) * chunkSize);
+                for (vtkIdType i = batchBegin + c * chunkSize; i < end; ++i)
+                {
+                    format(text, i);
+                }
+            }
+        });
+        for (vtkIdType c = 0; c < numChunks; ++c)
+        {
+            outFile.write(buffers.chunks[c].data(), buffers.chunks[c].size());
+        }
+    }
+}
+
+// Abaqus element matching a VTK cell type. 'order' maps Abaqus node positions to VTK point
+// positions; VTK wedges list the first triangle in the opposite direction.
+struct AbaqusElementType
+{
+    int vtkType;
+    const char* name;
+    int numPoints;
+    int order[10];
+};
+
+const AbaqusElementType AbaqusElementTypes[] = {
+    {VTK_TETRA, "C3D4", 4, {0, 1, 2, 3}},
+    {VTK_HEXAHEDRON, "C3D8", 8, {0, 1, 2, 3, 4, 5, 6, 7}},
+    {VTK_WEDGE, "C3D6", 6, {0, 2, 1, 3, 5, 4}},
+    {VTK_QUADRATIC_TETRA, "C3D10", 10, {0, 1, 2, 3, 4, 5, 6, 7, 8, 9}},
+};
+const int NumAbaqusElementTypes = sizeof(AbaqusElementTypes) / sizeof(AbaqusElementTypes[0]);
+
+// Set name for one value of a cell array, e.g. RegionId_3 (RegionId_m3 for -3)
+std::string GetElementSetName(const std::string& arrayName, long long value)
+{
+    std::string name = arrayName.empty() ? "CellData" : arrayName;
+    name += value < 0 ? "_m" : "_";
+    name += std::to_string(value < 0 ? -value : value);
+    return name;
+}
+
+// Split sorted cell ids into arithmetic progressions in one pass, as WriteElementSet() in
+// data/10.cxx does. 'emit(first, last, increment)' receives progressions of 3 or more ids,
+// and single ids with first == last.
+template <typename Emitter>
+void SplitProgressions(const vtkIdType* ids, vtkIdType numIds, Emitter emit)
+{
+    vtkIdType first = 0;
+    vtkIdType last = 0;
+    vtkIdType increment = 0;
+    vtkIdType count = 0;
+    for (vtkIdType k = 0; k < numIds; ++k)
+    {
+        vtkIdType i = ids[k];
+        if (count == 2 && i - last != increment)
+        {
+            // Only two ids in this progression: the first is a single id, the second starts over
+            emit(first, first, 1);
+            first = last;
+            count = 1;
+        }
+        if (count == 0)
+        {
+            first = i;
+            count = 1;
+        }
+        else if (count == 1)
+        {
+            increment = i - first;
+            count = 2;
+        }
+        else if (i - last == increment)
+        {
+            ++count;
+        }
+        else
+        {
+            emit(first, last, increment);
+            first = i;
+            count = 1;
+        }
+        last = i;
+    }
+    if (count >= 3)
+    {
+        emit(first, last, increment);
+    }
+    else if (count == 2)
+    {
+        emit(first, first, 1);
+        emit(last, last, 1);
+    }
+    else if (count == 1)
+    {
+        emit(first, first, 1);
+    }
+}
+
+// Index of a cell's value among the sorted distinct values, reusing the previous cell's
+// index while the value repeats
+size_t FindSetIndex(const std::vector<long long>& setValues, long long value, long long& lastValue, size_t& lastIndex)
+{
+    if (value != lastValue)
+    {
+        lastValue = value;
+        lastIndex = std::lower_bound(setValues.begin(), setValues.end(), value) - setValues.begin();
+    }
+    return lastIndex;
+}
+
+// Write an integer cell array as one element set per distinct value. The cell ids are
+// bucketed by value with a counting sort over the mapped values, so each set is written
+// from its own bucket: first its GENERATE ranges, then the ids listed 16 per line. Returns
+// false, writing nothing, when the array has too many distinct values to be a region
+// labelling.
+bool WriteElementSets(std::ofstream& outFile, const AppendedArray& array, const DataBlock& values, vtkIdType numCells)
+{
+    const size_t maxNumSets = 65536;
+    const size_t flushSize = 1 << 20;
+    std::vector<long long> setValues;
+    long long lastValue = 0;
+    for (vtkIdType i = 0; i < numCells; ++i)
+    {
+        long long value = ReadInteger(values, i);
+        if (i > 0 && value == lastValue)
+        {
+            continue;
+        }
+        lastValue = value;
+        std::vector<long long>::iterator position = std::lower_bound(setValues.begin(), setValues.end(), value);
+        if (position == setValues.end() || *position != value)
+        {
+            setValues.insert(position, value);
+            if (setValues.size() > maxNumSets)
+            {
+                return false;
+            }
+        }
+    }
+    if (setValues.empty())
+    {
+        return true;
+    }
+
+    // Counting sort of the cell ids by set: bucket s holds setOffsets[s] .. setOffsets[s + 1]
+    std::vector<vtkIdType> setOffsets(setValues.size() + 1, 0);
+    size_t setIndex = 0;
+    lastValue = setValues[0];
+    for (vtkIdType i = 0; i < numCells; ++i)
+    {
+        setOffsets[FindSetIndex(setValues, ReadInteger(values, i), lastValue, setIndex) + 1]++;
+    }
+    for (size_t s = 0; s < setValues.size(); ++s)
+    {
+        setOffsets[s + 1] += setOffsets[s];
+    }
+    std::vector<vtkIdType> setCells(numCells);
+    std::vector<vtkIdType> setEnds(setOffsets.begin(), setOffsets.end() - 1);
+    setIndex = 0;
+    lastValue = setValues[0];
+    for (vtkIdType i = 0; i < numCells; ++i)
+    {
+        setCells[setEnds[FindSetIndex(setValues, ReadInteger(values, i), lastValue, setIndex)]++] = i;
+    }
+
+    std::string text;
+    for (size_t s = 0; s < setValues.size(); ++s)
+    {
+        std::string name = GetElementSetName(array.name, setValues[s]);
+        const vtkIdType* ids = setCells.data() + setOffsets[s];
+        vtkIdType numIds = setOffsets[s + 1] - setOffsets[s];
+
+        bool started = false;
+        SplitProgressions(ids, numIds, [&](vtkIdType first, vtkIdType last, vtkIdType increment)
+        {
+            if (first == last)
+            {
+                return;
+            }
+            if (!started)
+            {
+                text += "*ELSET, ELSET=" + name + ", GENERATE\n";
+                started = true;
+            }
+            AppendId(text, first + 1);
+            text += ", ";
+            AppendId(text, last + 1);
+            text += ", ";
+            AppendId(text, increment);
+            text += '\n';
+            if (text.size() > flushSize)
+            {
+                outFile.write(text.data(), text.size());
+                text.clear();
+            }
+        });
+
+        started = false;
+        int idsOnLine = 0;
+        SplitProgressions(ids, numIds, [&](vtkIdType first, vtkIdType last, vtkIdType)
+        {
+            if (first != last)
+            {
+                return;
+            }
+            if (!started)
+            {
+                text += "*ELSET, ELSET=" + name + "\n";
+                started = true;
+            }
+            if (idsOnLine == 16)
+            {
+                text += '\n';
+                idsOnLine = 0;
+            }
+            if (idsOnLine > 0)
+            {
+                text += ", ";
+            }
+            AppendId(text, first + 1);
+            ++idsOnLine;
+            if (text.size() > flushSize)
+            {
+                outFile.write(text.data(), text.size());
+                text.clear();
+            }
+        });
+        if (idsOnLine > 0)
+        {
+            text += '\n';
+        }
+    }
+    outFile.write(text.data(), text.size());
+    return true;
+}
+
+// Write "id, c0, c1, ..." lines for every tuple of a mapped array
+void WriteBlockTuples(std::ofstream& outFile, const DataBlock& values, vtkIdType numTuples, INPFormatBuffers& buffers)
+{
+    WriteFormattedChunks(outFile, numTuples, buffers, [&](std::string& text, vtkIdType j)
+    {
+        AppendId(text, j + 1);
+        for (int k = 0; k < values.numComponents; ++k)
+        {
+            text += ", ";
+            AppendReal(text, ReadReal(values, j * values.numComponents + k));
+        }
+        text += '\n';
+    });
+}
+
+bool ConvertVTUToINP(const std::string& inputFilename, const std::string& outputFilename)
+{
+    MappedFile file;
+    if (!MapFile(inputFilename, file))
+    {
+        std::cerr << "Failed to map file " << inputFilename << std::endl;
+        return false;
+    }
+
+    VTUFileLayout layout;
+    DataBlock points, connectivity, offsets, types;
+    if (!ParseLayout(file, layout) ||
+        !GetDataBlock(file, layout, layout.points, points) ||
+        !GetDataBlock(file, layout, layout.connectivity, connectivity) ||
+        !GetDataBlock(file, layout, layout.offsets, offsets) ||
+        !GetDataBlock(file, layout, layout.types, types) ||
+        points.numValues < 3 * layout.numPoints || offsets.numValues < layout.numCells || types.numValues < layout.numCells)
+    {
+        std::cerr << "Failed to read the appended blocks of " << inputFilename << std::endl;
+        UnmapFile(file);
+        return false;
+    }
+
+    // Count the cells of each element type, then write one block per type. Each block
+    // rescans the mapped cell types, which costs one byte per cell and no extra memory.
+    // The same pass checks that every cell's connectivity lies inside the mapped block and
+    // holds exactly the nodes of its element type, so the blocks can read it unchecked.
+    int typeToBlock[256];
+    std::fill(typeToBlock, typeToBlock + 256, NumAbaqusElementTypes);
+    for (int b = 0; b < NumAbaqusElementTypes; ++b)
+    {
+        typeToBlock[AbaqusElementTypes[b].vtkType] = b;
+    }
+    std::vector<vtkIdType> blockSizes(NumAbaqusElementTypes + 1, 0);
+    vtkIdType previousEnd = 0;
+    for (vtkIdType i = 0; i < layout.numCells; ++i)
+    {
+        vtkIdType cellEnd = ReadInteger(offsets, i);
+        int block = typeToBlock[ReadInteger(types, i) & 0xff];
+        if (cellEnd < previousEnd || cellEnd > connectivity.numValues ||
+            (block < NumAbaqusElementTypes && cellEnd - previousEnd != AbaqusElementTypes[block].numPoints))
+        {
+            std::cerr << "Invalid connectivity for cell " << i << " in " << inputFilename << std::endl;
+            UnmapFile(file);
+            return false;
+        }
+        blockSizes[block]++;
+        previousEnd = cellEnd;
+    }
+
+    INPFormatBuffers buffers;
+    buffers.stream.resize(1 << 22);
+    std::ofstream outFile;
+    outFile.rdbuf()->pubsetbuf(buffers.stream.data(), buffers.stream.size());
+    outFile.open(outputFilename, std::ios::binary);
+    if (!outFile.is_open())
+    {
+        std::cerr << "Failed to open file " << outputFilename << std::endl;
+        UnmapFile(file);
+        return false;
+    }
+
+    // Write header
+    outFile << "*HEADING\n";
+    outFile << "Converted from VTU to Abaqus INP\n";
+
+    // Write nodes
+    outFile << "*NODE\n";
+    WriteFormattedChunks(outFile, layout.numPoints, buffers, [&](std::string& text, vtkIdType i)
+    {
+        AppendId(text, i + 1);
+        for (int k = 0; k < 3; ++k)
+        {
+            text += ", ";
+            AppendReal(text, ReadReal(points, 3 * i + k));
+        }
+        text += '\n';
+    });
+    ReleaseRange(file, points.data, points.numBytes);
+
+    if (blockSizes[NumAbaqusElementTypes] > 0)
+    {
+        std::cerr << "Skipping " << blockSizes[NumAbaqusElementTypes] << " cells without an Abaqus element type" << std::endl;
+    }
+
+    for (int b = 0; b < NumAbaqusElementTypes; ++b)
+    {
+        const AbaqusElementType& elementType = AbaqusElementTypes[b];
+        if (blockSizes[b] == 0)
+        {
+            continue;
+        }
+
+        outFile << "*ELEMENT, TYPE=" << elementType.name << "\n";
+        WriteFormattedChunks(outFile, layout.numCells, buffers, [&](std::string& text, vtkIdType i)
+        {
+            if (ReadInteger(types, i) != elementType.vtkType)
+            {
+                return;
+            }
+            // VTU offsets hold the end of each cell in the connectivity
+            vtkIdType cellBegin = i == 0 ? 0 : ReadInteger(offsets, i - 1);
+            AppendId(text, i + 1);
+            for (int j = 0; j < elementType.numPoints; ++j)
+            {
+                text += ", ";
+                AppendId(text, ReadInteger(connectivity, cellBegin + elementType.order[j]) + 1);
+            }
+            text += '\n';
+        });
+    }
+    ReleaseRange(file, connectivity.data, connectivity.numBytes);
+    ReleaseRange(file, offsets.data, offsets.numBytes);
+    ReleaseRange(file, types.data, types.numBytes);
+
+    // Write point data, every component of every array, as data/10.cxx does
+    for (const AppendedArray& array : layout.pointData)
+    {
+        DataBlock values;
+        if (!GetDataBlock(file, layout, array, values) || values.numValues < layout.numPoints * array.numComponents)
+        {
+            std::cerr << "Skipping unreadable point data array " << array.name << std::endl;
+            continue;
+        }
+        outFile << "*NODAL DATA, NAME=" << array.name << "\n";
+        WriteBlockTuples(outFile, values, layout.numPoints, buffers);
+        ReleaseRange(file, values.data, values.numBytes);
+    }
+
+    // Write cell data
+    for (const AppendedArray& array : layout.cellData)
+    {
+        DataBlock values;
+        if (!GetDataBlock(file, layout, array, values) || values.numValues < layout.numCells * array.numComponents)
+        {
+            std::cerr << "Skipping unreadable cell data array " << array.name << std::endl;
+            continue;
+        }
+        bool isInteger = array.type != TypeFloat32 && array.type != TypeFloat64 && array.numComponents == 1;
+        if (isInteger && WriteElementSets(outFile, array, values, layout.numCells))
+        {
+            ReleaseRange(file, values.data, values.numBytes);
+            continue;
+        }
+
+        outFile << "*ELEMENT DATA, NAME=" << array.name << "\n";
+        WriteBlockTuples(outFile, values, layout.numCells, buffers);
+        ReleaseRange(file, values.data, values.numBytes);
+    }
+
+    outFile.close();
+    UnmapFile(file);
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " input.vtu output.inp" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::string inputFilename = argv[1];
+    std::string outputFilename = argv[2];
+
+    return ConvertVTUToINP(inputFilename, outputFilename) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
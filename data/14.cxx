@@ -0,0 +1,737 @@
+#include <vtkSmartPointer.h>
+#include <vtkUnstructuredGrid.h>
+#include <vtkPoints.h>
+#include <vtkCellArray.h>
+#include <vtkCellType.h>
+#include <vtkCellData.h>
+#include <vtkPointData.h>
+#include <vtkDoubleArray.h>
+#include <vtkIntArray.h>
+#include <vtkUnsignedCharArray.h>
+#include <vtkTypeInt64Array.h>
+#include <vtkSMPTools.h>
+#include <vtkXMLUnstructuredGridWriter.h>
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Abaqus INP reader. The deck is memory-mapped, keyword lines are located in parallel, and
+// each *NODE / *ELEMENT block is split at record boundaries into chunks that are counted and
+// then parsed in parallel with std::from_chars straight into the point and cell array storage.
+// Element sets written by WriteAbaqusINP() as <array>_<value> are turned back into integer
+// cell arrays, and *NODAL DATA / *ELEMENT DATA blocks into point and cell arrays.
+
+// Read-only memory mapping of a whole file
+struct MappedFile
+{
+    const char* data = nullptr;
+    size_t size = 0;
+    int fd = -1;
+};
+
+bool MapFile(const std::string& filename, MappedFile& file)
+{
+    file.fd = open(filename.c_str(), O_RDONLY);
+    if (file.fd < 0)
+    {
+        return false;
+    }
+    struct stat fileStat;
+    if (fstat(file.fd, &fileStat) != 0 || fileStat.st_size == 0)
+    {
+        close(file.fd);
+        return false;
+    }
+    file.size = static_cast<size_t>(fileStat.st_size);
+    void* address = mmap(nullptr, file.size, PROT_READ, MAP_PRIVATE, file.fd, 0);
+    if (address == MAP_FAILED)
+    {
+        close(file.fd);
+        return false;
+    }
+    file.data = static_cast<const char*>(address);
+    return true;
+}
+
+void UnmapFile(MappedFile& file)
+{
+    if (file.data)
+    {
+        munmap(const_cast<char*>(file.data), file.size);
+        close(file.fd);
+    }
+    file.data = nullptr;
+}
+
+// Abaqus element matching a VTK cell type. 'order' maps Abaqus node positions to VTK point
+// positions; VTK wedges list the first triangle in the opposite direction.
+struct AbaqusElementType
+{
+    int vtkType;
+    const char* name;
+    int numPoints;
+    int order[10];
+};
+
+const AbaqusElementType AbaqusElementTypes[] = {
+    {VTK_TETRA, "C3D4", 4, {0, 1, 2, 3}},
+    {VTK_HEXAHEDRON, "C3D8", 8, {0, 1, 2, 3, 4, 5, 6, 7}},
+    {VTK_WEDGE, "C3D6", 6, {0, 2, 1, 3, 5, 4}},
+    {VTK_QUADRATIC_TETRA, "C3D10", 10, {0, 1, 2, 3, 4, 5, 6, 7, 8, 9}},
+};
+const int NumAbaqusElementTypes = sizeof(AbaqusElementTypes) / sizeof(AbaqusElementTypes[0]);
+
+// Element type for a TYPE= value; variants such as C3D8R or C3D10M share the node layout
+const AbaqusElementType* FindElementType(const std::string& name)
+{
+    const AbaqusElementType* found = nullptr;
+    for (const AbaqusElementType& elementType : AbaqusElementTypes)
+    {
+        size_t length = std::strlen(elementType.name);
+        if (name.compare(0, length, elementType.name) == 0 && (name.size() == length || !std::isdigit(name[length])))
+        {
+            found = &elementType;
+        }
+    }
+    return found;
+}
+
+// A keyword line and the data lines that follow it
+struct INPSection
+{
+    std::string keyword;
+    std::map<std::string, std::string> parameters;
+    const char* begin;
+    const char* end;
+};
+
+std::string ToUpper(std::string text)
+{
+    std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return std::toupper(c); });
+    return text;
+}
+
+std::string Trim(const std::string& text)
+{
+    size_t first = text.find_first_not_of(" \t\r");
+    size_t last = text.find_last_not_of(" \t\r");
+    return first == std::string::npos ? std::string() : text.substr(first, last - first + 1);
+}
+
+// Split "*ELEMENT, TYPE=C3D8, ELSET=Part" into the keyword and its parameters. Keyword and
+// parameter names are upper-cased; parameter values keep their case.
+void ParseKeywordLine(const char* begin, const char* end, INPSection& section)
+{
+    std::string line(begin + 1, end);
+    size_t position = 0;
+    bool first = true;
+    while (position <= line.size())
+    {
+        size_t comma = line.find(',', position);
+        if (comma == std::string::npos)
+        {
+            comma = line.size();
+        }
+        std::string item = Trim(line.substr(position, comma - position));
+        if (first)
+        {
+            section.keyword = ToUpper(item);
+            first = false;
+        }
+        else if (!item.empty())
+        {
+            size_t equals = item.find('=');
+            if (equals == std::string::npos)
+            {
+                section.parameters[ToUpper(item)] = std::string();
+            }
+            else
+            {
+                section.parameters[ToUpper(Trim(item.substr(0, equals)))] = Trim(item.substr(equals + 1));
+            }
+        }
+        position = comma + 1;
+    }
+}
+
+// Find all keyword lines in parallel. Each chunk of the file reports the lines that start in
+// it with a single '*'; "**" comment lines are skipped by the data parsers instead.
+std::vector<INPSection> FindSections(const MappedFile& file)
+{
+    const char* end = file.data + file.size;
+    const vtkIdType numChunks = 256;
+    size_t chunkSize = file.size / numChunks + 1;
+    std::vector<std::vector<const char*>> chunkKeywords(numChunks);
+    vtkSMPTools::For(0, numChunks, 1, [&](vtkIdType firstChunk, vtkIdType lastChunk)
+    {
+        for (vtkIdType c = firstChunk; c < lastChunk; ++c)
+        {
+            const char* p = file.data + std::min(file.size, static_cast<size_t>(c) * chunkSize);
+            const char* chunkEnd = file.data + std::min(file.size, static_cast<size_t>(c + 1) * chunkSize);
+            while (p < chunkEnd)
+            {
+                bool lineStart = p == file.data || p[-1] == '\n';
+                if (lineStart && *p == '*' && (p + 1 == end || p[1] != '*'))
+                {
+                    chunkKeywords[c].push_back(p);
+                }
+                const char* newline = static_cast<const char*>(std::memchr(p, '\n', end - p));
+                p = newline ? newline + 1 : end;
+            }
+        }
+    });
+
+    std::vector<INPSection> sections;
+    for (const std::vector<const char*>& keywords : chunkKeywords)
+    {
+        for (const char* keyword : keywords)
+        {
+            const char* newline = static_cast<const char*>(std::memchr(keyword, '\n', end - keyword));
+            const char* lineEnd = newline ? newline : end;
+            INPSection section;
+            ParseKeywordLine(keyword, lineEnd, section);
+            section.begin = newline ? newline + 1 : end;
+            section.end = end;
+            if (!sections.empty())
+            {
+                sections.back().end = keyword;
+            }
+            sections.push_back(section);
+        }
+    }
+    return sections;
+}
+
+// End of the record starting at 'p': the end of its line, or of the following lines while a
+// line ends with a comma
+const char* FindRecordEnd(const char* p, const char* end)
+{
+    while (p < end)
+    {
+        const char* newline = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        const char* lineEnd = newline ? newline : end;
+        const char* last = lineEnd;
+        while (last > p && (last[-1] == ' ' || last[-1] == '\t' || last[-1] == '\r'))
+        {
+            --last;
+        }
+        if (last == p || last[-1] != ',' || lineEnd == end)
+        {
+            return lineEnd;
+        }
+        p = lineEnd + 1;
+    }
+    return end;
+}
+
+// Start of the first record at or after 'p' in a block starting at 'begin': a line start whose
+// previous line is blank or does not end with a comma
+const char* FindRecordStart(const char* begin, const char* p, const char* end)
+{
+    if (p <= begin)
+    {
+        return begin;
+    }
+    while (p < end)
+    {
+        if (p[-1] == '\n')
+        {
+            const char* last = p - 1;
+            while (last > begin && (last[-1] == ' ' || last[-1] == '\t' || last[-1] == '\r'))
+            {
+                --last;
+            }
+            if (last == begin || last[-1] != ',')
+            {
+                return p;
+            }
+        }
+        const char* newline = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        p = newline ? newline + 1 : end;
+    }
+    return end;
+}
+
+// Split a data block into about 'numChunks' ranges that start at record boundaries. Each bound
+// seeks to its byte target and scans forward only to the next record start, so the serial
+// work is a few lines per chunk rather than a pass over the block.
+std::vector<const char*> SplitRecords(const char* begin, const char* end, vtkIdType numChunks)
+{
+    std::vector<const char*> bounds(1, begin);
+    size_t chunkSize = (end - begin) / numChunks + 1;
+    for (vtkIdType c = 1; c < numChunks; ++c)
+    {
+        const char* target = begin + std::min(static_cast<size_t>(end - begin), static_cast<size_t>(c) * chunkSize);
+        const char* p = FindRecordStart(begin, std::max(target, bounds.back()), end);
+        if (p > bounds.back() && p < end)
+        {
+            bounds.push_back(p);
+        }
+    }
+    bounds.push_back(end);
+    return bounds;
+}
+
+// True when the record holds data, as opposed to a blank or "**" comment line
+bool IsDataRecord(const char* p, const char* recordEnd)
+{
+    while (p < recordEnd && (*p == ' ' || *p == '\t' || *p == '\r'))
+    {
+        ++p;
+    }
+    return p < recordEnd && *p != '*';
+}
+
+// Parse the next number of a record, skipping separators and line breaks
+template <typename T>
+bool ParseNumber(const char*& p, const char* recordEnd, T& value)
+{
+    while (p < recordEnd && (*p == ' ' || *p == ',' || *p == '\t' || *p == '\r' || *p == '\n' || *p == '+'))
+    {
+        ++p;
+    }
+    std::from_chars_result result = std::from_chars(p, recordEnd, value);
+    if (result.ec != std::errc())
+    {
+        return false;
+    }
+    p = result.ptr;
+    return true;
+}
+
+// Start of the record following the one that ends at 'recordEnd'
+const char* NextRecord(const char* recordEnd, const char* end)
+{
+    return recordEnd < end ? recordEnd + 1 : end;
+}
+
+// Data block split into chunks at record boundaries, with the number of data records that
+// precede each chunk
+struct RecordChunks
+{
+    std::vector<const char*> bounds;
+    std::vector<vtkIdType> offsets;
+};
+
+// Split a block and count its data records per chunk in parallel; returns the total
+vtkIdType CountRecords(const INPSection& section, RecordChunks& chunks)
+{
+    chunks.bounds = SplitRecords(section.begin, section.end, 1024);
+    vtkIdType numChunks = static_cast<vtkIdType>(chunks.bounds.size()) - 1;
+    chunks.offsets.assign(numChunks + 1, 0);
+    vtkSMPTools::For(0, numChunks, 1, [&](vtkIdType firstChunk, vtkIdType lastChunk)
+    {
+        for (vtkIdType c = firstChunk; c < lastChunk; ++c)
+        {
+            const char* chunkEnd = chunks.bounds[c + 1];
+            vtkIdType count = 0;
+            for (const char* p = chunks.bounds[c]; p < chunkEnd;)
+            {
+                const char* recordEnd = FindRecordEnd(p, chunkEnd);
+                count += IsDataRecord(p, recordEnd) ? 1 : 0;
+                p = NextRecord(recordEnd, chunkEnd);
+            }
+            chunks.offsets[c + 1] = count;
+        }
+    });
+    for (vtkIdType c = 0; c < numChunks; ++c)
+    {
+        chunks.offsets[c + 1] += chunks.offsets[c];
+    }
+    return chunks.offsets[numChunks];
+}
+
+// Call 'parse(recordBegin, recordEnd, index)' for every data record of a counted block, in
+// parallel over its chunks. Records are numbered from 'firstIndex' in file order.
+template <typename RecordParser>
+void ParseRecords(const RecordChunks& chunks, vtkIdType firstIndex, RecordParser parse)
+{
+    vtkIdType numChunks = static_cast<vtkIdType>(chunks.bounds.size()) - 1;
+    vtkSMPTools::For(0, numChunks, 1, [&](vtkIdType firstChunk, vtkIdType lastChunk)
+    {
+        for (vtkIdType c = firstChunk; c < lastChunk; ++c)
+        {
+            const char* chunkEnd = chunks.bounds[c + 1];
+            vtkIdType index = firstIndex + chunks.offsets[c];
+            for (const char* p = chunks.bounds[c]; p < chunkEnd;)
+            {
+                const char* recordEnd = FindRecordEnd(p, chunkEnd);
+                if (IsDataRecord(p, recordEnd))
+                {
+                    parse(p, recordEnd, index++);
+                }
+                p = NextRecord(recordEnd, chunkEnd);
+            }
+        }
+    });
+}
+
+// Map from Abaqus labels to zero-based indices. Compact label ranges use a direct table,
+// sparse ones a sorted list searched by bisection.
+struct LabelMap
+{
+    vtkIdType minLabel = 0;
+    std::vector<vtkIdType> table;
+    std::vector<std::pair<vtkIdType, vtkIdType>> sorted;
+
+    vtkIdType Find(vtkIdType label) const
+    {
+        if (!table.empty())
+        {
+            vtkIdType offset = label - minLabel;
+            return offset >= 0 && offset < static_cast<vtkIdType>(table.size()) ? table[offset] : -1;
+        }
+        std::vector<std::pair<vtkIdType, vtkIdType>>::const_iterator found =
+            std::lower_bound(sorted.begin(), sorted.end(), std::make_pair(label, vtkIdType(-1)));
+        return found != sorted.end() && found->first == label ? found->second : -1;
+    }
+};
+
+void BuildLabelMap(const std::vector<vtkIdType>& labels, LabelMap& map)
+{
+    if (labels.empty())
+    {
+        return;
+    }
+    std::pair<std::vector<vtkIdType>::const_iterator, std::vector<vtkIdType>::const_iterator> range =
+        std::minmax_element(labels.begin(), labels.end());
+    vtkIdType span = *range.second - *range.first + 1;
+    vtkIdType numLabels = static_cast<vtkIdType>(labels.size());
+    if (span <= 2 * numLabels + 1024)
+    {
+        map.minLabel = *range.first;
+        map.table.assign(span, -1);
+        vtkSMPTools::For(0, numLabels, [&](vtkIdType first, vtkIdType last)
+        {
+            for (vtkIdType i = first; i < last; ++i)
+            {
+                map.table[labels[i] - map.minLabel] = i;
+            }
+        });
+    }
+    else
+    {
+        map.sorted.resize(labels.size());
+        for (vtkIdType i = 0; i < numLabels; ++i)
+        {
+            map.sorted[i] = std::make_pair(labels[i], i);
+        }
+        std::sort(map.sorted.begin(), map.sorted.end());
+    }
+}
+
+// Cell array and value for an element set named <array>_<value> or <array>_m<value>
+bool SplitElementSetName(const std::string& name, std::string& arrayName, int& value)
+{
+    size_t separator = name.rfind('_');
+    if (separator == std::string::npos || separator == 0 || separator + 1 == name.size())
+    {
+        return false;
+    }
+    const char* digits = name.c_str() + separator + 1;
+    bool negative = *digits == 'm';
+    if (negative)
+    {
+        ++digits;
+    }
+    const char* end = name.c_str() + name.size();
+    std::from_chars_result result = std::from_chars(digits, end, value);
+    if (result.ec != std::errc() || result.ptr != end)
+    {
+        return false;
+    }
+    value = negative ? -value : value;
+    arrayName = name.substr(0, separator);
+    return true;
+}
+
+vtkSmartPointer<vtkUnstructuredGrid> ReadAbaqusINP(const std::string& filename)
+{
+    MappedFile file;
+    if (!MapFile(filename, file))
+    {
+        std::cerr << "Failed to map file " << filename << std::endl;
+        return nullptr;
+    }
+    std::vector<INPSection> sections = FindSections(file);
+
+    // Count the node and element records of every block
+    struct BlockLayout
+    {
+        const AbaqusElementType* elementType;
+        vtkIdType firstIndex;
+        RecordChunks chunks;
+    };
+    std::vector<BlockLayout> nodeBlocks, elementBlocks;
+    vtkIdType numPoints = 0;
+    vtkIdType numCells = 0;
+    vtkIdType connectivitySize = 0;
+    for (const INPSection& section : sections)
+    {
+        if (section.keyword == "NODE")
+        {
+            nodeBlocks.push_back({nullptr, numPoints, {}});
+            numPoints += CountRecords(section, nodeBlocks.back().chunks);
+        }
+        else if (section.keyword == "ELEMENT")
+        {
+            std::map<std::string, std::string>::const_iterator type = section.parameters.find("TYPE");
+            const AbaqusElementType* elementType = type == section.parameters.end() ? nullptr : FindElementType(ToUpper(type->second));
+            if (!elementType)
+            {
+                std::cerr << "Skipping unsupported element block "
+                          << (type == section.parameters.end() ? std::string("without TYPE") : type->second) << std::endl;
+                continue;
+            }
+            elementBlocks.push_back({elementType, numCells, {}});
+            vtkIdType count = CountRecords(section, elementBlocks.back().chunks);
+            numCells += count;
+            connectivitySize += count * elementType->numPoints;
+        }
+    }
+
+    // Parse the nodes straight into the point coordinates
+    vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
+    points->SetDataTypeToDouble();
+    points->SetNumberOfPoints(numPoints);
+    double* coordinates = vtkDoubleArray::SafeDownCast(points->GetData())->GetPointer(0);
+    std::vector<vtkIdType> nodeLabels(numPoints);
+    for (BlockLayout& block : nodeBlocks)
+    {
+        ParseRecords(block.chunks, block.firstIndex, [&](const char* p, const char* recordEnd, vtkIdType index)
+        {
+            double* point = coordinates + 3 * index;
+            point[0] = point[1] = point[2] = 0.0;
+            ParseNumber(p, recordEnd, nodeLabels[index]);
+            for (int k = 0; k < 3; ++k)
+            {
+                if (!ParseNumber(p, recordEnd, point[k]))
+                {
+                    break;
+                }
+            }
+        });
+    }
+    LabelMap nodeMap;
+    BuildLabelMap(nodeLabels, nodeMap);
+
+    // Parse the elements straight into the cell array offsets and connectivity
+    vtkSmartPointer<vtkTypeInt64Array> offsets = vtkSmartPointer<vtkTypeInt64Array>::New();
+    offsets->SetNumberOfValues(numCells + 1);
+    vtkSmartPointer<vtkTypeInt64Array> connectivity = vtkSmartPointer<vtkTypeInt64Array>::New();
+    connectivity->SetNumberOfValues(connectivitySize);
+    vtkSmartPointer<vtkUnsignedCharArray> cellTypes = vtkSmartPointer<vtkUnsignedCharArray>::New();
+    cellTypes->SetNumberOfValues(numCells);
+    vtkTypeInt64* offsetData = offsets->GetPointer(0);
+    vtkTypeInt64* connectivityData = connectivity->GetPointer(0);
+    unsigned char* cellTypeData = cellTypes->GetPointer(0);
+    std::vector<vtkIdType> elementLabels(numCells);
+    std::vector<char> missingNodes(elementBlocks.size(), 0);
+    vtkTypeInt64 blockConnectivity = 0;
+    for (size_t b = 0; b < elementBlocks.size(); ++b)
+    {
+        BlockLayout& block = elementBlocks[b];
+        const AbaqusElementType& elementType = *block.elementType;
+        vtkIdType blockSize = block.chunks.offsets.back();
+        vtkTypeInt64 connectivityBase = blockConnectivity - block.firstIndex * elementType.numPoints;
+        ParseRecords(block.chunks, block.firstIndex, [&](const char* p, const char* recordEnd, vtkIdType index)
+        {
+            vtkTypeInt64* cellPoints = connectivityData + connectivityBase + index * elementType.numPoints;
+            offsetData[index] = connectivityBase + index * elementType.numPoints;
+            cellTypeData[index] = static_cast<unsigned char>(elementType.vtkType);
+            ParseNumber(p, recordEnd, elementLabels[index]);
+            for (int j = 0; j < elementType.numPoints; ++j)
+            {
+                vtkIdType label = 0;
+                vtkIdType pointId = ParseNumber(p, recordEnd, label) ? nodeMap.Find(label) : -1;
+                if (pointId < 0)
+                {
+                    missingNodes[b] = 1;
+                    pointId = 0;
+                }
+                cellPoints[elementType.order[j]] = pointId;
+            }
+        });
+        blockConnectivity += blockSize * elementType.numPoints;
+        if (missingNodes[b])
+        {
+            std::cerr << "Elements of block " << elementType.name << " reference undefined nodes" << std::endl;
+        }
+    }
+    offsetData[numCells] = connectivitySize;
+    LabelMap elementMap;
+    BuildLabelMap(elementLabels, elementMap);
+
+    vtkSmartPointer<vtkCellArray> cells = vtkSmartPointer<vtkCellArray>::New();
+    cells->SetData(offsets, connectivity);
+    vtkSmartPointer<vtkUnstructuredGrid> grid = vtkSmartPointer<vtkUnstructuredGrid>::New();
+    grid->SetPoints(points);
+    grid->SetCells(cellTypes, cells);
+
+    // Element sets become integer cell arrays (<array>_<value>) or membership flags
+    std::map<std::string, vtkSmartPointer<vtkDataArray>> setArrays;
+    for (const INPSection& section : sections)
+    {
+        if (section.keyword != "ELSET" || section.parameters.count("ELSET") == 0)
+        {
+            continue;
+        }
+        std::string setName = section.parameters.at("ELSET");
+        std::string arrayName;
+        int value = 1;
+        if (!SplitElementSetName(setName, arrayName, value))
+        {
+            arrayName = setName;
+            value = 1;
+        }
+        vtkSmartPointer<vtkDataArray>& array = setArrays[arrayName];
+        if (!array)
+        {
+            array = arrayName == setName ? vtkSmartPointer<vtkDataArray>(vtkSmartPointer<vtkUnsignedCharArray>::New())
+                                         : vtkSmartPointer<vtkDataArray>(vtkSmartPointer<vtkIntArray>::New());
+            array->SetName(arrayName.c_str());
+            array->SetNumberOfTuples(numCells);
+            array->Fill(0);
+            grid->GetCellData()->AddArray(array);
+        }
+
+        bool generate = section.parameters.count("GENERATE") > 0;
+        for (const char* p = section.begin; p < section.end;)
+        {
+            const char* recordEnd = FindRecordEnd(p, section.end);
+            const char* q = p;
+            if (IsDataRecord(p, recordEnd))
+            {
+                vtkIdType numbers[3] = {0, 0, 1};
+                if (generate)
+                {
+                    int count = 0;
+                    while (count < 3 && ParseNumber(q, recordEnd, numbers[count]))
+                    {
+                        ++count;
+                    }
+                    for (vtkIdType label = numbers[0]; count >= 2 && numbers[2] > 0 && label <= numbers[1]; label += numbers[2])
+                    {
+                        vtkIdType cellId = elementMap.Find(label);
+                        if (cellId >= 0)
+                        {
+                            array->SetTuple1(cellId, value);
+                        }
+                    }
+                }
+                else
+                {
+                    while (ParseNumber(q, recordEnd, numbers[0]))
+                    {
+                        vtkIdType cellId = elementMap.Find(numbers[0]);
+                        if (cellId >= 0)
+                        {
+                            array->SetTuple1(cellId, value);
+                        }
+                    }
+                }
+            }
+            p = NextRecord(recordEnd, section.end);
+        }
+    }
+
+    // Nodal and element data written as "label, c0, c1, ..." lines. The first record gives
+    // the number of components; the rest are parsed in parallel and placed by label.
+    for (const INPSection& section : sections)
+    {
+        bool nodal = section.keyword == "NODAL DATA";
+        if ((!nodal && section.keyword != "ELEMENT DATA") || section.parameters.count("NAME") == 0)
+        {
+            continue;
+        }
+        const LabelMap& labelMap = nodal ? nodeMap : elementMap;
+        vtkIdType numTuples = nodal ? numPoints : numCells;
+
+        int numComponents = 0;
+        for (const char* p = section.begin; p < section.end && numComponents == 0;)
+        {
+            const char* recordEnd = FindRecordEnd(p, section.end);
+            vtkIdType label;
+            double value;
+            if (IsDataRecord(p, recordEnd) && ParseNumber(p, recordEnd, label))
+            {
+                while (ParseNumber(p, recordEnd, value))
+                {
+                    ++numComponents;
+                }
+            }
+            p = NextRecord(recordEnd, section.end);
+        }
+        if (numComponents == 0)
+        {
+            continue;
+        }
+
+        vtkSmartPointer<vtkDoubleArray> array = vtkSmartPointer<vtkDoubleArray>::New();
+        array->SetName(section.parameters.at("NAME").c_str());
+        array->SetNumberOfComponents(numComponents);
+        array->SetNumberOfTuples(numTuples);
+        array->Fill(0.0);
+        double* values = array->GetPointer(0);
+        RecordChunks chunks;
+        CountRecords(section, chunks);
+        ParseRecords(chunks, 0, [&](const char* p, const char* recordEnd, vtkIdType)
+        {
+            vtkIdType label;
+            vtkIdType id = ParseNumber(p, recordEnd, label) ? labelMap.Find(label) : -1;
+            for (int k = 0; id >= 0 && k < numComponents; ++k)
+            {
+                if (!ParseNumber(p, recordEnd, values[id * numComponents + k]))
+                {
+                    break;
+                }
+            }
+        });
+        if (nodal)
+        {
+            grid->GetPointData()->AddArray(array);
+        }
+        else
+        {
+            grid->GetCellData()->AddArray(array);
+        }
+    }
+
+    UnmapFile(file);
+    return grid;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " input.inp output.vtu" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::string inputFilename = argv[1];
+    std::string outputFilename = argv[2];
+
+    vtkSmartPointer<vtkUnstructuredGrid> grid = ReadAbaqusINP(inputFilename);
+    if (!grid)
+    {
+        return EXIT_FAILURE;
+    }
+
+    vtkSmartPointer<vtkXMLUnstructuredGridWriter> writer = vtkSmartPointer<vtkXMLUnstructuredGridWriter>::New();
+    writer->SetFileName(outputFilename.c_str());
+    writer->SetInputData(grid);
+    writer->Write();
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,536 @@
+#include <vtkSmartPointer.h>
+#include <vtkXMLUnstructuredGridReader.h>
+#include <vtkUnstructuredGrid.h>
+#include <vtkPoints.h>
+#include <vtkCellArray.h>
+#include <vtkCellType.h>
+#include <vtkCellData.h>
+#include <vtkDoubleArray.h>
+#include <vtkUnsignedCharArray.h>
+#include <vtkDataArray.h>
+#include <vtkArrayDispatch.h>
+#include <vtkDataArrayRange.h>
+#include <vtkSMPTools.h>
+#include <vtkSMPThreadLocal.h>
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Binary Gmsh MSH 4.1 export. Node coordinates and element connectivity are written as raw
+// 8-byte values from contiguous buffers, so no value is formatted as text. Every distinct
+// (RegionId, Interface) pair of the cells becomes a volume entity tagged with the physical
+// groups RegionId_<value> and Interface.
+
+// Gmsh element matching a VTK cell type. 'order' maps Gmsh node positions to VTK point
+// positions. Gmsh prisms number their base triangle the other way round from VTK wedges, and
+// the last two mid-edge nodes of quadratic tetrahedra are swapped.
+struct GmshElementType
+{
+    int vtkType;
+    int gmshType;
+    int numPoints;
+    int order[10];
+};
+
+const GmshElementType GmshElementTypes[] = {
+    {VTK_TETRA, 4, 4, {0, 1, 2, 3}},
+    {VTK_HEXAHEDRON, 5, 8, {0, 1, 2, 3, 4, 5, 6, 7}},
+    {VTK_WEDGE, 6, 6, {0, 2, 1, 3, 5, 4}},
+    {VTK_QUADRATIC_TETRA, 11, 10, {0, 1, 2, 3, 4, 5, 6, 7, 9, 8}},
+};
+const int NumGmshElementTypes = sizeof(GmshElementTypes) / sizeof(GmshElementTypes[0]);
+
+// Number of nodes or elements formatted per write call
+const vtkIdType MshChunkSize = 1 << 18;
+
+// Volume entity: cells sharing a region and interface flag
+struct MshEntity
+{
+    long long region;
+    long long interfaceFlag;
+    double bounds[6];
+    std::vector<int> physicalTags;
+};
+
+template <typename T>
+void WriteBinary(std::ofstream& outFile, T value)
+{
+    outFile.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+void WriteBinary(std::ofstream& outFile, const T* values, size_t count)
+{
+    outFile.write(reinterpret_cast<const char*>(values), count * sizeof(T));
+}
+
+std::string GetPhysicalName(const std::string& arrayName, long long value)
+{
+    return arrayName + (value < 0 ? "_m" + std::to_string(-value) : "_" + std::to_string(value));
+}
+
+// Copy a one-component cell array through its typed storage. GetTuple1 shares one buffer per
+// array, so it cannot be called from the parallel loops.
+struct ReadCellValuesWorker
+{
+    template <typename ArrayT>
+    void operator()(ArrayT* array, std::vector<double>& values)
+    {
+        const auto range = vtk::DataArrayValueRange<1>(array);
+        values.resize(array->GetNumberOfTuples());
+        vtkSMPTools::For(0, array->GetNumberOfTuples(), [&](vtkIdType first, vtkIdType last)
+        {
+            for (vtkIdType i = first; i < last; ++i)
+            {
+                values[i] = static_cast<double>(range[i]);
+            }
+        });
+    }
+};
+
+std::vector<double> ReadCellValues(vtkDataArray* array)
+{
+    std::vector<double> values;
+    if (array)
+    {
+        ReadCellValuesWorker worker;
+        if (!vtkArrayDispatch::Dispatch::Execute(array, worker, values))
+        {
+            worker(array, values);
+        }
+    }
+    return values;
+}
+
+// Entity index of every cell, with the entities sorted by (region, interface), and the names
+// of the physical groups they are tagged with
+std::vector<MshEntity> BuildEntities(vtkUnstructuredGrid* grid, std::vector<int>& cellEntities,
+                                     std::vector<std::string>& physicalNames)
+{
+    vtkIdType numCells = grid->GetNumberOfCells();
+    vtkDataArray* regionIds = grid->GetCellData()->GetArray("RegionId");
+    vtkDataArray* interfaces = grid->GetCellData()->GetArray("Interface");
+
+    const std::vector<double> regionValues = ReadCellValues(regionIds);
+    const std::vector<double> interfaceValues = ReadCellValues(interfaces);
+
+    std::vector<std::pair<long long, long long>> cellKeys(numCells);
+    vtkSMPTools::For(0, numCells, [&](vtkIdType first, vtkIdType last)
+    {
+        for (vtkIdType i = first; i < last; ++i)
+        {
+            cellKeys[i].first = regionIds ? static_cast<long long>(regionValues[i]) : 0;
+            cellKeys[i].second = interfaces && interfaceValues[i] != 0.0 ? 1 : 0;
+        }
+    });
+    std::vector<std::pair<long long, long long>> keys = cellKeys;
+    vtkSMPTools::Sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+    // Physical tags: one per region value, then one for the interface cells
+    std::vector<long long> regions;
+    for (const std::pair<long long, long long>& key : keys)
+    {
+        if (regions.empty() || regions.back() != key.first)
+        {
+            regions.push_back(key.first);
+        }
+    }
+    physicalNames.clear();
+    if (regionIds)
+    {
+        for (long long region : regions)
+        {
+            physicalNames.push_back(GetPhysicalName("RegionId", region));
+        }
+    }
+    int interfaceTag = static_cast<int>(physicalNames.size()) + 1;
+    if (interfaces)
+    {
+        physicalNames.push_back("Interface");
+    }
+
+    std::vector<MshEntity> entities(keys.size());
+    for (size_t e = 0; e < keys.size(); ++e)
+    {
+        MshEntity& entity = entities[e];
+        entity.region = keys[e].first;
+        entity.interfaceFlag = keys[e].second;
+        if (regionIds)
+        {
+            entity.physicalTags.push_back(
+                static_cast<int>(std::lower_bound(regions.begin(), regions.end(), entity.region) - regions.begin()) + 1);
+        }
+        if (entity.interfaceFlag)
+        {
+            entity.physicalTags.push_back(interfaceTag);
+        }
+    }
+
+    cellEntities.resize(numCells);
+    vtkSMPTools::For(0, numCells, [&](vtkIdType first, vtkIdType last)
+    {
+        for (vtkIdType i = first; i < last; ++i)
+        {
+            cellEntities[i] = static_cast<int>(std::lower_bound(keys.begin(), keys.end(), cellKeys[i]) - keys.begin());
+        }
+    });
+    return entities;
+}
+
+// Bounding box of every entity from the points of its cells
+template <typename CellArrayT>
+void ComputeEntityBounds(vtkPoints* points, CellArrayT* offsetsArray, CellArrayT* connectivityArray,
+                         const std::vector<int>& cellEntities, std::vector<MshEntity>& entities)
+{
+    const double maxValue = std::numeric_limits<double>::max();
+    std::vector<double> emptyBounds(6 * entities.size());
+    for (size_t e = 0; e < entities.size(); ++e)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            emptyBounds[6 * e + k] = maxValue;
+            emptyBounds[6 * e + k + 3] = -maxValue;
+        }
+    }
+
+    const auto* offsets = offsetsArray->GetPointer(0);
+    const auto* connectivity = connectivityArray->GetPointer(0);
+    vtkSMPThreadLocal<std::vector<double>> threadBounds(emptyBounds);
+    vtkSMPTools::For(0, static_cast<vtkIdType>(cellEntities.size()), [&](vtkIdType first, vtkIdType last)
+    {
+        std::vector<double>& bounds = threadBounds.Local();
+        for (vtkIdType i = first; i < last; ++i)
+        {
+            double* entityBounds = bounds.data() + 6 * cellEntities[i];
+            for (auto j = offsets[i]; j < offsets[i + 1]; ++j)
+            {
+                double p[3];
+                points->GetPoint(connectivity[j], p);
+                for (int k = 0; k < 3; ++k)
+                {
+                    entityBounds[k] = std::min(entityBounds[k], p[k]);
+                    entityBounds[k + 3] = std::max(entityBounds[k + 3], p[k]);
+                }
+            }
+        }
+    });
+
+    for (size_t e = 0; e < entities.size(); ++e)
+    {
+        std::copy_n(emptyBounds.begin() + 6 * e, 6, entities[e].bounds);
+    }
+    for (const std::vector<double>& bounds : threadBounds)
+    {
+        for (size_t e = 0; e < entities.size(); ++e)
+        {
+            for (int k = 0; k < 3; ++k)
+            {
+                entities[e].bounds[k] = std::min(entities[e].bounds[k], bounds[6 * e + k]);
+                entities[e].bounds[k + 3] = std::max(entities[e].bounds[k + 3], bounds[6 * e + k + 3]);
+            }
+        }
+    }
+}
+
+// Group the cells by (entity, element type) with a counting sort and write one element
+// block per group. Each chunk of elements is packed into 'buffer' in parallel and written
+// with a single call.
+template <typename CellArrayT>
+void WriteElementBlocks(std::ofstream& outFile, vtkUnsignedCharArray* cellTypes, CellArrayT* offsetsArray,
+                        CellArrayT* connectivityArray, const std::vector<int>& cellEntities, size_t numEntities,
+                        std::vector<uint64_t>& buffer)
+{
+    int typeToIndex[256];
+    std::fill(typeToIndex, typeToIndex + 256, -1);
+    for (int t = 0; t < NumGmshElementTypes; ++t)
+    {
+        typeToIndex[GmshElementTypes[t].vtkType] = t;
+    }
+
+    // Count the cells of each block; unsupported types go to the extra last block
+    const unsigned char* types = cellTypes->GetPointer(0);
+    vtkIdType numCells = cellTypes->GetNumberOfTuples();
+    vtkIdType numBlocks = static_cast<vtkIdType>(numEntities) * NumGmshElementTypes;
+    std::vector<vtkIdType> cellBlocks(numCells);
+    std::vector<vtkIdType> blockOffsets(numBlocks + 3, 0);
+    for (vtkIdType i = 0; i < numCells; ++i)
+    {
+        int typeIndex = typeToIndex[types[i]];
+        cellBlocks[i] = typeIndex < 0 ? numBlocks : cellEntities[i] * NumGmshElementTypes + typeIndex;
+        blockOffsets[cellBlocks[i] + 2]++;
+    }
+    for (vtkIdType b = 2; b < numBlocks + 3; ++b)
+    {
+        blockOffsets[b] += blockOffsets[b - 1];
+    }
+    std::vector<vtkIdType> sortedCells(numCells);
+    for (vtkIdType i = 0; i < numCells; ++i)
+    {
+        sortedCells[blockOffsets[cellBlocks[i] + 1]++] = i;
+    }
+
+    vtkIdType numElements = blockOffsets[numBlocks];
+    if (numElements < numCells)
+    {
+        std::cerr << "Skipping " << numCells - numElements << " cells without a Gmsh element type" << std::endl;
+    }
+    vtkIdType numUsedBlocks = 0;
+    vtkIdType minElementTag = numElements > 0 ? numCells : 0;
+    vtkIdType maxElementTag = 0;
+    for (vtkIdType b = 0; b < numBlocks; ++b)
+    {
+        numUsedBlocks += blockOffsets[b + 1] > blockOffsets[b] ? 1 : 0;
+    }
+    for (vtkIdType i = 0; i < numElements; ++i)
+    {
+        minElementTag = std::min(minElementTag, sortedCells[i] + 1);
+        maxElementTag = std::max(maxElementTag, sortedCells[i] + 1);
+    }
+
+    outFile << "$Elements\n";
+    WriteBinary<uint64_t>(outFile, numUsedBlocks);
+    WriteBinary<uint64_t>(outFile, numElements);
+    WriteBinary<uint64_t>(outFile, minElementTag);
+    WriteBinary<uint64_t>(outFile, maxElementTag);
+
+    const auto* offsets = offsetsArray->GetPointer(0);
+    const auto* connectivity = connectivityArray->GetPointer(0);
+    for (vtkIdType b = 0; b < numBlocks; ++b)
+    {
+        const GmshElementType& elementType = GmshElementTypes[b % NumGmshElementTypes];
+        const vtkIdType* blockCells = sortedCells.data() + blockOffsets[b];
+        vtkIdType blockSize = blockOffsets[b + 1] - blockOffsets[b];
+        if (blockSize == 0)
+        {
+            continue;
+        }
+
+        WriteBinary<int>(outFile, 3);
+        WriteBinary<int>(outFile, static_cast<int>(b / NumGmshElementTypes) + 1);
+        WriteBinary<int>(outFile, elementType.gmshType);
+        WriteBinary<uint64_t>(outFile, blockSize);
+
+        const int stride = elementType.numPoints + 1;
+        for (vtkIdType chunkBegin = 0; chunkBegin < blockSize; chunkBegin += MshChunkSize)
+        {
+            vtkIdType chunkEnd = std::min(blockSize, chunkBegin + MshChunkSize);
+            buffer.resize((chunkEnd - chunkBegin) * stride);
+            vtkSMPTools::For(chunkBegin, chunkEnd, [&](vtkIdType first, vtkIdType last)
+            {
+                for (vtkIdType i = first; i < last; ++i)
+                {
+                    vtkIdType cellId = blockCells[i];
+                    const auto* cellPoints = connectivity + offsets[cellId];
+                    uint64_t* element = buffer.data() + (i - chunkBegin) * stride;
+                    element[0] = cellId + 1;
+                    for (int j = 0; j < elementType.numPoints; ++j)
+                    {
+                        element[j + 1] = static_cast<uint64_t>(cellPoints[elementType.order[j]]) + 1;
+                    }
+                }
+            });
+            WriteBinary(outFile, buffer.data(), buffer.size());
+        }
+    }
+    outFile << "\n$EndElements\n";
+}
+
+bool WriteGmshMSH(vtkUnstructuredGrid* grid, const std::string& filename)
+{
+    // Give the stream a large buffer before opening; bulk writes bypass it
+    std::vector<char> streamBuffer(1 << 22);
+    std::ofstream outFile;
+    outFile.rdbuf()->pubsetbuf(streamBuffer.data(), streamBuffer.size());
+    outFile.open(filename, std::ios::binary);
+
+    if (!outFile.is_open())
+    {
+        std::cerr << "Failed to open file " << filename << std::endl;
+        return false;
+    }
+
+    vtkPoints* points = grid->GetPoints();
+    vtkCellArray* cells = grid->GetCells();
+    vtkIdType numPoints = points->GetNumberOfPoints();
+    std::vector<int> cellEntities;
+    std::vector<std::string> physicalNames;
+    std::vector<MshEntity> entities = BuildEntities(grid, cellEntities, physicalNames);
+    if (cells->IsStorage64Bit())
+    {
+        ComputeEntityBounds(points, cells->GetOffsetsArray64(), cells->GetConnectivityArray64(), cellEntities, entities);
+    }
+    else
+    {
+        ComputeEntityBounds(points, cells->GetOffsetsArray32(), cells->GetConnectivityArray32(), cellEntities, entities);
+    }
+
+    // Header; the integer 1 lets readers detect the byte order
+    outFile << "$MeshFormat\n4.1 1 8\n";
+    WriteBinary<int>(outFile, 1);
+    outFile << "\n$EndMeshFormat\n";
+
+    // Physical group names are always text
+    if (!physicalNames.empty())
+    {
+        outFile << "$PhysicalNames\n" << physicalNames.size() << "\n";
+        for (size_t t = 0; t < physicalNames.size(); ++t)
+        {
+            outFile << "3 " << t + 1 << " \"" << physicalNames[t] << "\"\n";
+        }
+        outFile << "$EndPhysicalNames\n";
+    }
+
+    // Volume entities only; the mesh carries no boundary topology
+    outFile << "$Entities\n";
+    WriteBinary<uint64_t>(outFile, 0);
+    WriteBinary<uint64_t>(outFile, 0);
+    WriteBinary<uint64_t>(outFile, 0);
+    WriteBinary<uint64_t>(outFile, entities.size());
+    for (size_t e = 0; e < entities.size(); ++e)
+    {
+        WriteBinary<int>(outFile, static_cast<int>(e) + 1);
+        WriteBinary(outFile, entities[e].bounds, 6);
+        WriteBinary<uint64_t>(outFile, entities[e].physicalTags.size());
+        WriteBinary(outFile, entities[e].physicalTags.data(), entities[e].physicalTags.size());
+        WriteBinary<uint64_t>(outFile, 0);
+    }
+    outFile << "\n$EndEntities\n";
+
+    // All nodes in one block on the first volume: tags, then coordinates
+    outFile << "$Nodes\n";
+    WriteBinary<uint64_t>(outFile, 1);
+    WriteBinary<uint64_t>(outFile, numPoints);
+    WriteBinary<uint64_t>(outFile, numPoints > 0 ? 1 : 0);
+    WriteBinary<uint64_t>(outFile, numPoints);
+    WriteBinary<int>(outFile, 3);
+    WriteBinary<int>(outFile, 1);
+    WriteBinary<int>(outFile, 0);
+    WriteBinary<uint64_t>(outFile, numPoints);
+
+    std::vector<uint64_t> buffer;
+    for (vtkIdType chunkBegin = 0; chunkBegin < numPoints; chunkBegin += MshChunkSize)
+    {
+        vtkIdType chunkEnd = std::min(numPoints, chunkBegin + MshChunkSize);
+        buffer.resize(chunkEnd - chunkBegin);
+        for (vtkIdType i = chunkBegin; i < chunkEnd; ++i)
+        {
+            buffer[i - chunkBegin] = i + 1;
+        }
+        WriteBinary(outFile, buffer.data(), buffer.size());
+    }
+
+    vtkDoubleArray* coordinates = vtkDoubleArray::SafeDownCast(points->GetData());
+    if (coordinates)
+    {
+        WriteBinary(outFile, coordinates->GetPointer(0), 3 * static_cast<size_t>(numPoints));
+    }
+    else
+    {
+        std::vector<double> chunkCoordinates;
+        for (vtkIdType chunkBegin = 0; chunkBegin < numPoints; chunkBegin += MshChunkSize)
+        {
+            vtkIdType chunkEnd = std::min(numPoints, chunkBegin + MshChunkSize);
+            chunkCoordinates.resize(3 * (chunkEnd - chunkBegin));
+            vtkSMPTools::For(chunkBegin, chunkEnd, [&](vtkIdType first, vtkIdType last)
+            {
+                for (vtkIdType i = first; i < last; ++i)
+                {
+                    points->GetPoint(i, chunkCoordinates.data() + 3 * (i - chunkBegin));
+                }
+            });
+            WriteBinary(outFile, chunkCoordinates.data(), chunkCoordinates.size());
+        }
+    }
+    outFile << "\n$EndNodes\n";
+
+    // Element blocks straight from the cell array storage
+    if (cells->IsStorage64Bit())
+    {
+        WriteElementBlocks(outFile, grid->GetCellTypesArray(), cells->GetOffsetsArray64(), cells->GetConnectivityArray64(),
+                           cellEntities, entities.size(), buffer);
+    }
+    else
+    {
+        WriteElementBlocks(outFile, grid->GetCellTypesArray(), cells->GetOffsetsArray32(), cells->GetConnectivityArray32(),
+                           cellEntities, entities.size(), buffer);
+    }
+
+    outFile.close();
+    return static_cast<bool>(outFile);
+}
+
+// Corner points of a positively oriented VTK cell of each type in GmshElementTypes, in VTK
+// point order: the base of a tetrahedron faces its apex, the base of a wedge faces away from the
+// opposite triangle. Mid-edge nodes do not affect the orientation and are left out.
+const double ReferenceCorners[][8][3] = {
+    {{0, 0, 0}, {1, 0, 0}, {0, 1, 0}, {0, 0, 1}},
+    {{0, 0, 0}, {1, 0, 0}, {1, 1, 0}, {0, 1, 0}, {0, 0, 1}, {1, 0, 1}, {1, 1, 1}, {0, 1, 1}},
+    {{0, 0, 0}, {0, 1, 0}, {1, 0, 0}, {0, 0, 1}, {0, 1, 1}, {1, 0, 1}},
+    {{0, 0, 0}, {1, 0, 0}, {0, 1, 0}, {0, 0, 1}},
+};
+
+// Put each reference cell into Gmsh node order and check that its volume at the first node stays
+// positive, taken along the edges to nodes 1, 2, 3 (tetrahedra, prisms) or 1, 3, 4 (hexahedra)
+bool CheckElementOrientations()
+{
+    for (int t = 0; t < NumGmshElementTypes; ++t)
+    {
+        const GmshElementType& elementType = GmshElementTypes[t];
+        const bool hexahedron = elementType.vtkType == VTK_HEXAHEDRON;
+        const int edgeNodes[3] = {1, hexahedron ? 3 : 2, hexahedron ? 4 : 3};
+        const double* origin = ReferenceCorners[t][elementType.order[0]];
+        double edges[3][3];
+        for (int e = 0; e < 3; ++e)
+        {
+            const double* node = ReferenceCorners[t][elementType.order[edgeNodes[e]]];
+            for (int c = 0; c < 3; ++c)
+            {
+                edges[e][c] = node[c] - origin[c];
+            }
+        }
+        double volume = edges[2][0] * (edges[0][1] * edges[1][2] - edges[0][2] * edges[1][1]) +
+                        edges[2][1] * (edges[0][2] * edges[1][0] - edges[0][0] * edges[1][2]) +
+                        edges[2][2] * (edges[0][0] * edges[1][1] - edges[0][1] * edges[1][0]);
+        if (volume <= 0.0)
+        {
+            std::cerr << "Gmsh node order for VTK cell type " << elementType.vtkType << " inverts the element" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " input.vtu output.msh" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::string inputFilename = argv[1];
+    std::string outputFilename = argv[2];
+
+    if (!CheckElementOrientations())
+    {
+        return EXIT_FAILURE;
+    }
+
+    vtkSmartPointer<vtkXMLUnstructuredGridReader> reader = vtkSmartPointer<vtkXMLUnstructuredGridReader>::New();
+    reader->SetFileName(inputFilename.c_str());
+    reader->Update();
+
+    vtkUnstructuredGrid* grid = reader->GetOutput();
+    if (!WriteGmshMSH(grid, outputFilename))
+    {
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
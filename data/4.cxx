@@ -7,6 +7,39 @@
 #include <vtkXMLRectilinearGridWriter.h>
 #include <vtkDoubleArray.h>
 #include <vtkUnsignedCharArray.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Fill 'coords' from 0 to 'length'. The spacing is 'minSpacing' at the 'focus' positions and
+// grows linearly to 'maxSpacing' at a distance of 'band' from the nearest focus, so cells are
+// fine near the interface and coarse elsewhere. (maxSpacing - minSpacing) must be below 'band'
+// so that a step never jumps over a focus.
+void FillGradedCoordinates(vtkDoubleArray* coords, double length, const std::vector<double>& focus,
+                           double minSpacing, double maxSpacing, double band)
+{
+    coords->Initialize();
+    double s = 0.0;
+    coords->InsertNextValue(s);
+    while (s < length)
+    {
+        double distance = band;
+        for (double f : focus) distance = std::min(distance, std::abs(s - f));
+        s = std::min(length, s + minSpacing + (maxSpacing - minSpacing) * distance / band);
+        coords->InsertNextValue(s);
+    }
+}
+
+// Cache the squared offsets of one coordinate axis from the sphere center
+void ComputeSquaredOffsets(vtkDoubleArray* coords, double center, std::vector<double>& offsets)
+{
+    offsets.resize(coords->GetNumberOfTuples());
+    for (vtkIdType i = 0; i < coords->GetNumberOfTuples(); i++)
+    {
+        double d = coords->GetValue(i) - center;
+        offsets[i] = d * d;
+    }
+}
 
 int main(int argc, char* argv[])
 {
@@ -15,17 +48,29 @@ int main(int argc, char* argv[])
     sphere->SetCenter(50, 50, 50);
     sphere->SetRadius(30);
 
-    // Create a rectilinear grid
-    vtkSmartPointer<vtkRectilinearGrid> rectilinearGrid = vtkSmartPointer<vtkRectilinearGrid>::New();
-    int dims[3] = {100, 100, 100};
-    rectilinearGrid->SetDimensions(dims);
+    // Define the grid extent and grading
+    double length = 99.0;
+    double minSpacing = 0.25;
+    double maxSpacing = 4.0;
+    double band = 20.0;
 
+    // Create graded coordinates, fine where the axes cross the sphere surface
     vtkSmartPointer<vtkDoubleArray> xCoords = vtkSmartPointer<vtkDoubleArray>::New();
     vtkSmartPointer<vtkDoubleArray> yCoords = vtkSmartPointer<vtkDoubleArray>::New();
     vtkSmartPointer<vtkDoubleArray> zCoords = vtkSmartPointer<vtkDoubleArray>::New();
-    for (int i = 0; i < dims[0]; i++) xCoords->InsertNextValue(i);
-    for (int i = 0; i < dims[1]; i++) yCoords->InsertNextValue(i);
-    for (int i = 0; i < dims[2]; i++) zCoords->InsertNextValue(i);
+    vtkDoubleArray* coords[3] = {xCoords, yCoords, zCoords};
+    int dims[3];
+    for (int axis = 0; axis < 3; axis++)
+    {
+        double center = sphere->GetCenter()[axis];
+        std::vector<double> focus = {center - sphere->GetRadius(), center + sphere->GetRadius()};
+        FillGradedCoordinates(coords[axis], length, focus, minSpacing, maxSpacing, band);
+        dims[axis] = static_cast<int>(coords[axis]->GetNumberOfTuples());
+    }
+
+    // Create a rectilinear grid
+    vtkSmartPointer<vtkRectilinearGrid> rectilinearGrid = vtkSmartPointer<vtkRectilinearGrid>::New();
+    rectilinearGrid->SetDimensions(dims);
     rectilinearGrid->SetXCoordinates(xCoords);
     rectilinearGrid->SetYCoordinates(yCoords);
     rectilinearGrid->SetZCoordinates(zCoords);
@@ -34,7 +79,6 @@ int main(int argc, char* argv[])
     vtkSmartPointer<vtkUnsignedCharArray> scalars = vtkSmartPointer<vtkUnsignedCharArray>::New();
     scalars->SetNumberOfComponents(1);
     scalars->SetNumberOfTuples(dims[0] * dims[1] * dims[2]);
-    for (int i = 0; i < dims[0] * dims[1] * dims[2]; i++) scalars->SetValue(i, 0);
     rectilinearGrid->GetPointData()->SetScalars(scalars);
 
     // Create and initialize tag array
@@ -43,20 +87,25 @@ int main(int argc, char* argv[])
     tagArray->SetNumberOfTuples(dims[0] * dims[1] * dims[2]);
     for (int i = 0; i < dims[0] * dims[1] * dims[2]; i++) tagArray->SetValue(i, 0);
 
-    // Fill the rectilinear grid with sphere data
+    // Fill the rectilinear grid with sphere data. The sphere function is separable, so the
+    // squared offsets are cached per axis and the x loop is a branch-free compare that the
+    // compiler vectorizes.
+    std::vector<double> dx2, dy2, dz2;
+    ComputeSquaredOffsets(xCoords, sphere->GetCenter()[0], dx2);
+    ComputeSquaredOffsets(yCoords, sphere->GetCenter()[1], dy2);
+    ComputeSquaredOffsets(zCoords, sphere->GetCenter()[2], dz2);
+    double radius2 = sphere->GetRadius() * sphere->GetRadius();
+    unsigned char* scalarData = scalars->GetPointer(0);
     for (int z = 0; z < dims[2]; z++)
     {
         for (int y = 0; y < dims[1]; y++)
         {
+            const double* x2 = dx2.data();
+            double yz2 = dy2[y] + dz2[z];
+            unsigned char* row = scalarData + z * dims[1] * dims[0] + y * dims[0];
             for (int x = 0; x < dims[0]; x++)
             {
-                double p[3] = {static_cast<double>(x), static_cast<double>(y), static_cast<double>(z)};
-                double dist2 = sphere->EvaluateFunction(p);
-                if (dist2 <= 0)
-                {
-                    int index = z * dims[1] * dims[0] + y * dims[0] + x;
-                    scalars->SetValue(index, 1);
-                }
+                row[x] = static_cast<unsigned char>(x2[x] + yz2 <= radius2);
             }
         }
     }
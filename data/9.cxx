@@ -2,15 +2,431 @@
 #include <vtkXMLUnstructuredGridReader.h>
 #include <vtkUnstructuredGrid.h>
 #include <vtkPoints.h>
-#include <vtkCell.h>
+#include <vtkCellArray.h>
+#include <vtkCellType.h>
 #include <vtkCellData.h>
-#include <vtkDoubleArray.h>
+#include <vtkPointData.h>
+#include <vtkDataArray.h>
+#include <vtkArrayDispatch.h>
+#include <vtkDataArrayRange.h>
+#include <vtkUnsignedCharArray.h>
+#include <vtkSMPTools.h>
+#include <algorithm>
+#include <charconv>
 #include <fstream>
 #include <iostream>
+#include <string>
+#include <vector>
 
-void WriteAbaqusINP(vtkUnstructuredGrid* grid, const std::string& filename)
+// Per-chunk text buffers, kept between sections so their capacity is reused
+struct INPFormatBuffers
 {
-    std::ofstream outFile(filename);
+    std::vector<std::string> chunks;
+    std::vector<char> stream;
+};
+
+void AppendId(std::string& text, vtkIdType value)
+{
+    char digits[24];
+    std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), value);
+    text.append(digits, result.ptr);
+}
+
+// Shortest representation that reads back to the same double
+void AppendReal(std::string& text, double value)
+{
+    char digits[32];
+    std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), value);
+    text.append(digits, result.ptr);
+}
+
+// Format items [0, numItems) with 'format(text, i)'. Items are split into fixed-size chunks
+// that are formatted in parallel and written in order, a batch of chunks at a time so the
+// memory held by the buffers stays bounded.
+template <typename Formatter>
+void WriteFormattedChunks(std::ofstream& outFile, vtkIdType numItems, INPFormatBuffers& buffers, Formatter format)
+{
+    const vtkIdType chunkSize = 16384;
+    const vtkIdType chunksPerBatch = 32;
+    buffers.chunks.resize(chunksPerBatch);
+    for (vtkIdType batchBegin = 0; batchBegin < numItems; batchBegin += chunkSize * chunksPerBatch)
+    {
+        vtkIdType batchEnd = std::min(numItems, batchBegin + chunkSize * chunksPerBatch);
+        vtkIdType numChunks = (batchEnd - batchBegin + chunkSize - 1) / chunkSize;
+        vtkSMPTools::For(0, numChunks, 1, [&](vtkIdType firstChunk, vtkIdType lastChunk)
+        {
+            for (vtkIdType c = firstChunk; c < lastChunk; ++c)
+            {
+                std::string& text = buffers.chunks[c];
+                text.clear();
+                vtkIdType end = std::min(batchEnd, batchBegin + (c + 1) * chunkSize);
+                for (vtkIdType i = batchBegin + c * chunkSize; i < end; ++i)
+                {
+                    format(text, i);
+                }
+            }
+        });
+        for (vtkIdType c = 0; c < numChunks; ++c)
+        {
+            outFile.write(buffers.chunks[c].data(), buffers.chunks[c].size());
+        }
+    }
+}
+
+// Write "id, c0, c1, ..." lines for every tuple of a numeric array. The array is dispatched
+// once to its concrete type, so the values are read from the typed storage directly.
+struct WriteTuplesWorker
+{
+    template <typename ArrayT>
+    void operator()(ArrayT* array, std::ofstream& outFile, INPFormatBuffers& buffers)
+    {
+        const auto values = vtk::DataArrayValueRange(array);
+        const int numComponents = array->GetNumberOfComponents();
+        WriteFormattedChunks(outFile, array->GetNumberOfTuples(), buffers, [&](std::string& text, vtkIdType j)
+        {
+            AppendId(text, j + 1);
+            for (int k = 0; k < numComponents; ++k)
+            {
+                text += ", ";
+                AppendReal(text, static_cast<double>(values[j * numComponents + k]));
+            }
+            text += '\n';
+        });
+    }
+};
+
+void WriteArrayTuples(std::ofstream& outFile, vtkDataArray* dataArray, INPFormatBuffers& buffers)
+{
+    WriteTuplesWorker worker;
+    if (!vtkArrayDispatch::Dispatch::Execute(dataArray, worker, outFile, buffers))
+    {
+        worker(dataArray, outFile, buffers);
+    }
+}
+
+// Abaqus element matching a VTK cell type. 'order' maps Abaqus node positions to VTK point
+// positions; VTK wedges list the first triangle in the opposite direction.
+struct AbaqusElementType
+{
+    int vtkType;
+    const char* name;
+    int numPoints;
+    int order[10];
+};
+
+const AbaqusElementType AbaqusElementTypes[] = {
+    {VTK_TETRA, "C3D4", 4, {0, 1, 2, 3}},
+    {VTK_HEXAHEDRON, "C3D8", 8, {0, 1, 2, 3, 4, 5, 6, 7}},
+    {VTK_WEDGE, "C3D6", 6, {0, 2, 1, 3, 5, 4}},
+    {VTK_QUADRATIC_TETRA, "C3D10", 10, {0, 1, 2, 3, 4, 5, 6, 7, 8, 9}},
+};
+const int NumAbaqusElementTypes = sizeof(AbaqusElementTypes) / sizeof(AbaqusElementTypes[0]);
+
+// Group the cells by element type with a counting sort over the cell types and write one
+// *ELEMENT block per type. Point ids come straight from the cell array storage.
+template <typename CellArrayT>
+void WriteElementBlocks(std::ofstream& outFile, vtkUnsignedCharArray* cellTypes, CellArrayT* offsetsArray,
+                        CellArrayT* connectivityArray, INPFormatBuffers& buffers)
+{
+    int typeToBlock[256];
+    std::fill(typeToBlock, typeToBlock + 256, NumAbaqusElementTypes);
+    for (int b = 0; b < NumAbaqusElementTypes; ++b)
+    {
+        typeToBlock[AbaqusElementTypes[b].vtkType] = b;
+    }
+
+    // Count the cells of each type; the last block collects unsupported types
+    const unsigned char* types = cellTypes->GetPointer(0);
+    vtkIdType numCells = cellTypes->GetNumberOfTuples();
+    std::vector<vtkIdType> blockOffsets(NumAbaqusElementTypes + 3, 0);
+    for (vtkIdType i = 0; i < numCells; ++i)
+    {
+        blockOffsets[typeToBlock[types[i]] + 2]++;
+    }
+    for (int b = 2; b < NumAbaqusElementTypes + 3; ++b)
+    {
+        blockOffsets[b] += blockOffsets[b - 1];
+    }
+
+    // Scatter the cell ids so each block is contiguous and keeps the input order
+    std::vector<vtkIdType> sortedCells(numCells);
+    for (vtkIdType i = 0; i < numCells; ++i)
+    {
+        sortedCells[blockOffsets[typeToBlock[types[i]] + 1]++] = i;
+    }
+
+    vtkIdType numSkipped = numCells - blockOffsets[NumAbaqusElementTypes];
+    if (numSkipped > 0)
+    {
+        std::cerr << "Skipping " << numSkipped << " cells without an Abaqus element type" << std::endl;
+    }
+
+    const auto* offsets = offsetsArray->GetPointer(0);
+    const auto* connectivity = connectivityArray->GetPointer(0);
+    for (int b = 0; b < NumAbaqusElementTypes; ++b)
+    {
+        const AbaqusElementType& elementType = AbaqusElementTypes[b];
+        const vtkIdType* blockCells = sortedCells.data() + blockOffsets[b];
+        vtkIdType blockSize = blockOffsets[b + 1] - blockOffsets[b];
+        if (blockSize == 0)
+        {
+            continue;
+        }
+
+        outFile << "*ELEMENT, TYPE=" << elementType.name << "\n";
+        WriteFormattedChunks(outFile, blockSize, buffers, [&](std::string& text, vtkIdType i)
+        {
+            vtkIdType cellId = blockCells[i];
+            const auto* cellPoints = connectivity + offsets[cellId];
+            AppendId(text, cellId + 1);
+            for (int j = 0; j < elementType.numPoints; ++j)
+            {
+                text += ", ";
+                AppendId(text, static_cast<vtkIdType>(cellPoints[elementType.order[j]]) + 1);
+            }
+            text += '\n';
+        });
+    }
+}
+
+// Cell arrays with one integer component, such as RegionId or Interface, are written as
+// element sets
+bool IsIntegerArray(vtkDataArray* dataArray)
+{
+    if (dataArray->GetNumberOfComponents() != 1)
+    {
+        return false;
+    }
+    switch (dataArray->GetDataType())
+    {
+        case VTK_CHAR:
+        case VTK_SIGNED_CHAR:
+        case VTK_UNSIGNED_CHAR:
+        case VTK_SHORT:
+        case VTK_UNSIGNED_SHORT:
+        case VTK_INT:
+        case VTK_UNSIGNED_INT:
+        case VTK_LONG:
+        case VTK_UNSIGNED_LONG:
+        case VTK_LONG_LONG:
+        case VTK_UNSIGNED_LONG_LONG:
+        case VTK_ID_TYPE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Set name for one value of a cell array, e.g. RegionId_3 (RegionId_m3 for -3)
+std::string GetElementSetName(const char* arrayName, long long value)
+{
+    std::string name = arrayName ? arrayName : "CellData";
+    name += value < 0 ? "_m" : "_";
+    name += std::to_string(value < 0 ? -value : value);
+    return name;
+}
+
+// Write the sorted element ids of one set. Arithmetic progressions of 3 or more ids become
+// GENERATE ranges, the remaining ids are listed 16 per line.
+void WriteElementSet(std::ofstream& outFile, const std::string& name, const vtkIdType* ids, vtkIdType numIds,
+                     INPFormatBuffers& buffers)
+{
+    struct GenerateRange
+    {
+        vtkIdType first;
+        vtkIdType last;
+        vtkIdType increment;
+    };
+    std::vector<GenerateRange> ranges;
+    std::vector<vtkIdType> singles;
+    vtkIdType runBegin = 0;
+    while (runBegin < numIds)
+    {
+        vtkIdType runEnd = runBegin + 1;
+        if (runEnd < numIds)
+        {
+            vtkIdType increment = ids[runEnd] - ids[runBegin];
+            while (runEnd + 1 < numIds && ids[runEnd + 1] - ids[runEnd] == increment)
+            {
+                ++runEnd;
+            }
+            if (runEnd - runBegin >= 2)
+            {
+                ranges.push_back({ids[runBegin], ids[runEnd], increment});
+                runBegin = runEnd + 1;
+                continue;
+            }
+        }
+        singles.push_back(ids[runBegin]);
+        ++runBegin;
+    }
+
+    if (!ranges.empty())
+    {
+        outFile << "*ELSET, ELSET=" << name << ", GENERATE\n";
+        WriteFormattedChunks(outFile, static_cast<vtkIdType>(ranges.size()), buffers, [&](std::string& text, vtkIdType r)
+        {
+            AppendId(text, ranges[r].first + 1);
+            text += ", ";
+            AppendId(text, ranges[r].last + 1);
+            text += ", ";
+            AppendId(text, ranges[r].increment);
+            text += '\n';
+        });
+    }
+    if (!singles.empty())
+    {
+        const vtkIdType idsPerLine = 16;
+        vtkIdType numSingles = static_cast<vtkIdType>(singles.size());
+        outFile << "*ELSET, ELSET=" << name << "\n";
+        WriteFormattedChunks(outFile, (numSingles + idsPerLine - 1) / idsPerLine, buffers, [&](std::string& text, vtkIdType line)
+        {
+            vtkIdType end = std::min(numSingles, (line + 1) * idsPerLine);
+            for (vtkIdType i = line * idsPerLine; i < end; ++i)
+            {
+                if (i > line * idsPerLine)
+                {
+                    text += ", ";
+                }
+                AppendId(text, singles[i] + 1);
+            }
+            text += '\n';
+        });
+    }
+}
+
+// Copy a one-component array to long longs. The array is dispatched to its concrete type so
+// the parallel read goes through the typed storage instead of the shared GetTuple buffer.
+struct ReadIntegerValuesWorker
+{
+    template <typename ArrayT>
+    void operator()(ArrayT* array, std::vector<long long>& values)
+    {
+        const auto range = vtk::DataArrayValueRange<1>(array);
+        vtkSMPTools::For(0, array->GetNumberOfTuples(), [&](vtkIdType begin, vtkIdType end)
+        {
+            for (vtkIdType i = begin; i < end; ++i)
+            {
+                values[i] = static_cast<long long>(range[i]);
+            }
+        });
+    }
+};
+
+// Write an integer cell array as one element set per distinct value. Cell ids are grouped
+// with a parallel counting sort: every block of cells builds a histogram of set indices, the
+// histograms are prefix-summed in (set, block) order and each block scatters its ids on its
+// own, so every set comes out in increasing id order. Returns false, writing nothing, when
+// the array has too many distinct values to be a region labelling.
+bool WriteElementSets(std::ofstream& outFile, vtkDataArray* dataArray, INPFormatBuffers& buffers)
+{
+    const vtkIdType numBlocks = 64;
+    const size_t maxNumSets = 65536;
+    vtkIdType numCells = dataArray->GetNumberOfTuples();
+    vtkIdType blockSize = (numCells + numBlocks - 1) / numBlocks;
+
+    // Read the values and collect the distinct values of each block
+    std::vector<long long> values(numCells);
+    ReadIntegerValuesWorker reader;
+    if (!vtkArrayDispatch::Dispatch::Execute(dataArray, reader, values))
+    {
+        reader(dataArray, values);
+    }
+    std::vector<std::vector<long long>> blockValues(numBlocks);
+    vtkSMPTools::For(0, numBlocks, 1, [&](vtkIdType firstBlock, vtkIdType lastBlock)
+    {
+        for (vtkIdType b = firstBlock; b < lastBlock; ++b)
+        {
+            std::vector<long long>& distinct = blockValues[b];
+            vtkIdType end = std::min(numCells, (b + 1) * blockSize);
+            for (vtkIdType i = b * blockSize; i < end; ++i)
+            {
+                if (distinct.empty() || distinct.back() != values[i])
+                {
+                    distinct.push_back(values[i]);
+                }
+            }
+            std::sort(distinct.begin(), distinct.end());
+            distinct.erase(std::unique(distinct.begin(), distinct.end()), distinct.end());
+        }
+    });
+
+    std::vector<long long> setValues;
+    for (const std::vector<long long>& distinct : blockValues)
+    {
+        setValues.insert(setValues.end(), distinct.begin(), distinct.end());
+    }
+    std::sort(setValues.begin(), setValues.end());
+    setValues.erase(std::unique(setValues.begin(), setValues.end()), setValues.end());
+    if (setValues.size() > maxNumSets)
+    {
+        return false;
+    }
+    vtkIdType numSets = static_cast<vtkIdType>(setValues.size());
+
+    // Histogram of set indices per block
+    std::vector<int> setIndices(numCells);
+    std::vector<vtkIdType> offsets(numBlocks * numSets, 0);
+    vtkSMPTools::For(0, numBlocks, 1, [&](vtkIdType firstBlock, vtkIdType lastBlock)
+    {
+        for (vtkIdType b = firstBlock; b < lastBlock; ++b)
+        {
+            vtkIdType* counts = offsets.data() + b * numSets;
+            vtkIdType end = std::min(numCells, (b + 1) * blockSize);
+            for (vtkIdType i = b * blockSize; i < end; ++i)
+            {
+                setIndices[i] = static_cast<int>(
+                    std::lower_bound(setValues.begin(), setValues.end(), values[i]) - setValues.begin());
+                counts[setIndices[i]]++;
+            }
+        }
+    });
+
+    // Exclusive prefix sum in (set, block) order
+    std::vector<vtkIdType> setOffsets(numSets + 1, 0);
+    vtkIdType total = 0;
+    for (vtkIdType s = 0; s < numSets; ++s)
+    {
+        setOffsets[s] = total;
+        for (vtkIdType b = 0; b < numBlocks; ++b)
+        {
+            vtkIdType count = offsets[b * numSets + s];
+            offsets[b * numSets + s] = total;
+            total += count;
+        }
+    }
+    setOffsets[numSets] = total;
+
+    // Scatter the cell ids
+    std::vector<vtkIdType> sortedCells(numCells);
+    vtkSMPTools::For(0, numBlocks, 1, [&](vtkIdType firstBlock, vtkIdType lastBlock)
+    {
+        for (vtkIdType b = firstBlock; b < lastBlock; ++b)
+        {
+            vtkIdType* next = offsets.data() + b * numSets;
+            vtkIdType end = std::min(numCells, (b + 1) * blockSize);
+            for (vtkIdType i = b * blockSize; i < end; ++i)
+            {
+                sortedCells[next[setIndices[i]]++] = i;
+            }
+        }
+    });
+
+    for (vtkIdType s = 0; s < numSets; ++s)
+    {
+        WriteElementSet(outFile, GetElementSetName(dataArray->GetName(), setValues[s]),
+                        sortedCells.data() + setOffsets[s], setOffsets[s + 1] - setOffsets[s], buffers);
+    }
+    return true;
+}
+
+void WriteAbaqusINP(vtkUnstructuredGrid* grid, const std::string& filename, INPFormatBuffers& buffers)
+{
+    // Give the stream a large buffer before opening so chunk writes go straight to the file
+    buffers.stream.resize(1 << 22);
+    std::ofstream outFile;
+    outFile.rdbuf()->pubsetbuf(buffers.stream.data(), buffers.stream.size());
+    outFile.open(filename, std::ios::binary);
 
     if (!outFile.is_open())
     {
@@ -25,44 +441,62 @@ void WriteAbaqusINP(vtkUnstructuredGrid* grid, const std::string& filename)
     // Write nodes
     outFile << "*NODE\n";
     vtkPoints* points = grid->GetPoints();
-    for (vtkIdType i = 0; i < points->GetNumberOfPoints(); ++i)
+    WriteFormattedChunks(outFile, points->GetNumberOfPoints(), buffers, [&](std::string& text, vtkIdType i)
     {
         double p[3];
         points->GetPoint(i, p);
-        outFile << i + 1 << ", " << p[0] << ", " << p[1] << ", " << p[2] << "\n";
+        AppendId(text, i + 1);
+        for (int k = 0; k < 3; ++k)
+        {
+            text += ", ";
+            AppendReal(text, p[k]);
+        }
+        text += '\n';
+    });
+
+    // Write elements, one block per element type
+    vtkCellArray* cells = grid->GetCells();
+    if (cells->IsStorage64Bit())
+    {
+        WriteElementBlocks(outFile, grid->GetCellTypesArray(), cells->GetOffsetsArray64(),
+                           cells->GetConnectivityArray64(), buffers);
+    }
+    else
+    {
+        WriteElementBlocks(outFile, grid->GetCellTypesArray(), cells->GetOffsetsArray32(),
+                           cells->GetConnectivityArray32(), buffers);
     }
 
-    // Write elements
-    outFile << "*ELEMENT, TYPE=C3D4\n"; // Assuming tetrahedral elements
-    for (vtkIdType i = 0; i < grid->GetNumberOfCells(); ++i)
+    // Write point data, every component of every numeric array
+    vtkPointData* pointData = grid->GetPointData();
+    if (pointData)
     {
-        vtkCell* cell = grid->GetCell(i);
-        outFile << i + 1;
-        for (vtkIdType j = 0; j < cell->GetNumberOfPoints(); ++j)
+        for (int i = 0; i < pointData->GetNumberOfArrays(); ++i)
         {
-            outFile << ", " << cell->GetPointId(j) + 1;
+            vtkDataArray* dataArray = pointData->GetArray(i);
+            if (dataArray)
+            {
+                outFile << "*NODAL DATA, NAME=" << dataArray->GetName() << "\n";
+                WriteArrayTuples(outFile, dataArray, buffers);
+            }
         }
-        outFile << "\n";
     }
 
-    // Write cell data
+    // Write cell data: integer labels as element sets, other arrays as element data
     vtkCellData* cellData = grid->GetCellData();
     if (cellData)
     {
         for (int i = 0; i < cellData->GetNumberOfArrays(); ++i)
         {
-            vtkDoubleArray* dataArray = vtkDoubleArray::SafeDownCast(cellData->GetArray(i));
+            vtkDataArray* dataArray = cellData->GetArray(i);
+            if (dataArray && IsIntegerArray(dataArray) && WriteElementSets(outFile, dataArray, buffers))
+            {
+                continue;
+            }
             if (dataArray)
             {
-                std::string dataName = dataArray->GetName();
-                outFile << "*ELSET, ELSET=" << dataName << "\n";
-
-                for (vtkIdType j = 0; j < dataArray->GetNumberOfTuples(); ++j)
-                {
-                    double value;
-                    dataArray->GetTuple(j, &value);
-                    outFile << j + 1 << ", " << value << "\n";
-                }
+                outFile << "*ELEMENT DATA, NAME=" << dataArray->GetName() << "\n";
+                WriteArrayTuples(outFile, dataArray, buffers);
             }
         }
     }
@@ -86,7 +520,8 @@ int main(int argc, char* argv[])
     reader->Update();
 
     vtkUnstructuredGrid* grid = reader->GetOutput();
-    WriteAbaqusINP(grid, outputFilename);
+    INPFormatBuffers buffers;
+    WriteAbaqusINP(grid, outputFilename, buffers);
 
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,423 @@
+#include <vtkSmartPointer.h>
+#include <vtkUniformHyperTreeGrid.h>
+#include <vtkHyperTree.h>
+#include <vtkHyperTreeGridNonOrientedGeometryCursor.h>
+#include <vtkBitArray.h>
+#include <vtkDoubleArray.h>
+#include <vtkCellData.h>
+#include <vtkSMPTools.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <vector>
+
+#include "HyperTreePruning.h"
+
+// Position of each child relative to its parent center along x, y and z
+static const double ChildSigns[8][3] = {
+    { -1, -1, -1 }, { 1, -1, -1 }, { -1, 1, -1 }, { 1, 1, -1 },
+    { -1, -1, 1 }, { 1, -1, 1 }, { -1, 1, 1 }, { 1, 1, 1 }
+};
+
+enum ProlongationOperator
+{
+    ProlongInject, ProlongLinear
+};
+
+enum RestrictionOperator
+{
+    RestrictMean, RestrictMax, RestrictVolumeWeighted
+};
+
+// One cell array of the store, addressed by global cell index
+struct CellField {
+    vtkSmartPointer<vtkDoubleArray> array;
+    std::vector<double> values;
+    int numComponents;
+    ProlongationOperator prolongation;
+    RestrictionOperator restriction;
+};
+
+// Cell data that grows with the hyper tree grid. Every family of eight children owns a contiguous
+// block of global indices, so prolongation and restriction work on eight adjacent tuples, and blocks
+// released by collapsed families are handed out again before the arrays grow.
+struct CellFieldStore {
+    vtkHyperTreeGrid* hyperTreeGrid;
+    std::vector<CellField> fields;
+    vtkIdType numIndices = 0;
+    vtkIdType capacity = 0;
+    vtkIdType chunkSize = 4096;
+    std::vector<vtkIdType> freeBlocks;
+    int weightField = -1; // Volume fraction used by RestrictVolumeWeighted, or -1 for plain volumes
+    std::map<vtkIdType, std::vector<unsigned char>> collapsed; // Per tree, vertices collapsed since the last compaction
+};
+
+// Point every field's VTK array at its current buffer
+void BindCellArrays(CellFieldStore& store) {
+    for (CellField& field : store.fields) {
+        field.array->SetArray(field.values.data(), store.capacity * field.numComponents, 1);
+    }
+}
+
+// Grow every field to hold at least 'count' tuples, at least doubling and in whole chunks
+void ReserveCells(CellFieldStore& store, vtkIdType count) {
+    if (count <= store.capacity) {
+        return;
+    }
+    vtkIdType capacity = std::max(count, 2 * store.capacity);
+    capacity = (capacity + store.chunkSize - 1) / store.chunkSize * store.chunkSize;
+    for (CellField& field : store.fields) {
+        field.values.resize(capacity * field.numComponents, 0.0);
+    }
+    store.capacity = capacity;
+    BindCellArrays(store);
+}
+
+// Trim the arrays to the indices handed out, e.g. before writing the grid
+void SqueezeCellFieldStore(CellFieldStore& store) {
+    for (CellField& field : store.fields) {
+        field.values.resize(store.numIndices * field.numComponents);
+        field.values.shrink_to_fit();
+    }
+    store.capacity = store.numIndices;
+    BindCellArrays(store);
+}
+
+int AddCellField(CellFieldStore& store, const char* name, int numComponents, ProlongationOperator prolongation,
+                 RestrictionOperator restriction) {
+    CellField field;
+    field.array = vtkSmartPointer<vtkDoubleArray>::New();
+    field.array->SetName(name);
+    field.array->SetNumberOfComponents(numComponents);
+    field.values.assign(store.capacity * numComponents, 0.0);
+    field.numComponents = numComponents;
+    field.prolongation = prolongation;
+    field.restriction = restriction;
+    store.fields.push_back(field);
+
+    // Bind the array to the stored copy: the local vector is about to go away
+    CellField& stored = store.fields.back();
+    stored.array->SetArray(stored.values.data(), store.capacity * numComponents, 1);
+    store.hyperTreeGrid->GetCellData()->AddArray(stored.array);
+    return static_cast<int>(store.fields.size()) - 1;
+}
+
+vtkIdType AllocateIndices(CellFieldStore& store, vtkIdType count) {
+    if (count == 8 && !store.freeBlocks.empty()) {
+        vtkIdType base = store.freeBlocks.back();
+        store.freeBlocks.pop_back();
+        return base;
+    }
+    vtkIdType base = store.numIndices;
+    store.numIndices += count;
+    ReserveCells(store, store.numIndices);
+    return base;
+}
+
+double* CellTuple(CellField& field, vtkIdType globalIndex) {
+    return field.values.data() + globalIndex * field.numComponents;
+}
+
+// Create a root tree whose single cell gets the next global index
+vtkHyperTree* CreateRootCell(CellFieldStore& store, vtkIdType treeIndex) {
+    vtkHyperTree* tree = store.hyperTreeGrid->GetTree(treeIndex, true);
+    tree->SetGlobalIndexFromLocal(0, AllocateIndices(store, 1));
+    return tree;
+}
+
+bool IsCollapsed(const CellFieldStore& store, vtkIdType treeIndex, vtkIdType vertexId) {
+    auto found = store.collapsed.find(treeIndex);
+    return found != store.collapsed.end() && vertexId < static_cast<vtkIdType>(found->second.size()) &&
+        found->second[vertexId];
+}
+
+// Leaf as far as the store is concerned: collapsed families count as leaves until compaction
+template <typename CursorT>
+bool IsLeafCell(const CellFieldStore& store, CursorT* cursor) {
+    return cursor->IsLeaf() || IsCollapsed(store, cursor->GetTree()->GetTreeIndex(), cursor->GetVertexId());
+}
+
+bool IsMaskedCell(const CellFieldStore& store, vtkIdType globalIndex) {
+    vtkBitArray* mask = store.hyperTreeGrid->GetMask();
+    return mask && globalIndex < mask->GetNumberOfTuples() && mask->GetValue(globalIndex);
+}
+
+// Copy the parent tuple into the eight children
+void ProlongateInject(const double* parent, int numComponents, double* children) {
+    for (int child = 0; child < 8; ++child) {
+        for (int component = 0; component < numComponents; ++component) {
+            children[child * numComponents + component] = parent[component];
+        }
+    }
+}
+
+// Offset each child from the parent along the per-axis slopes measured across the parent's siblings,
+// where the parent is sibling 'childIndex'; the children average back to the parent. Each component's
+// slopes stay in registers while the eight children are written.
+void ProlongateLinear(const double* parent, const double* siblings, int childIndex, int numComponents,
+                      double* children) {
+    for (int component = 0; component < numComponents; ++component) {
+        double slopes[3];
+        for (int axis = 0; axis < 3; ++axis) {
+            int across = childIndex ^ (1 << axis);
+            slopes[axis] = ChildSigns[childIndex][axis] *
+                (siblings[childIndex * numComponents + component] - siblings[across * numComponents + component]);
+        }
+        for (int child = 0; child < 8; ++child) {
+            children[child * numComponents + component] = parent[component] +
+                0.25 * (ChildSigns[child][0] * slopes[0] + ChildSigns[child][1] * slopes[1] + ChildSigns[child][2] * slopes[2]);
+        }
+    }
+}
+
+// Combine the eight children into the parent, skipping masked children unless all of them are
+void RestrictChildren(CellFieldStore& store, vtkIdType childBase, vtkIdType parentIndex) {
+    double weights[8];
+    double weightSum = 0.0;
+    bool anyUnmasked = false;
+    for (int child = 0; child < 8; ++child) {
+        anyUnmasked |= !IsMaskedCell(store, childBase + child);
+    }
+    for (int child = 0; child < 8; ++child) {
+        weights[child] = anyUnmasked && IsMaskedCell(store, childBase + child) ? 0.0 : 1.0;
+        weightSum += weights[child];
+    }
+
+    // Volume fractions are read before any field, including the fraction itself, is restricted
+    double volumeWeights[8];
+    double volumeSum = 0.0;
+    for (int child = 0; child < 8; ++child) {
+        double fraction = store.weightField >= 0 ? CellTuple(store.fields[store.weightField], childBase + child)[0] : 1.0;
+        volumeWeights[child] = weights[child] * fraction;
+        volumeSum += volumeWeights[child];
+    }
+    if (volumeSum <= 0.0) {
+        std::copy(weights, weights + 8, volumeWeights);
+        volumeSum = weightSum;
+    }
+
+    for (CellField& field : store.fields) {
+        int numComponents = field.numComponents;
+        const double* children = CellTuple(field, childBase);
+        double* parent = CellTuple(field, parentIndex);
+        const double* childWeights = field.restriction == RestrictVolumeWeighted ? volumeWeights : weights;
+        double childWeightSum = field.restriction == RestrictVolumeWeighted ? volumeSum : weightSum;
+        for (int component = 0; component < numComponents; ++component) {
+            if (field.restriction == RestrictMax) {
+                double maximum = -std::numeric_limits<double>::infinity();
+                for (int child = 0; child < 8; ++child) {
+                    if (weights[child] > 0.0) {
+                        maximum = std::max(maximum, children[child * numComponents + component]);
+                    }
+                }
+                parent[component] = maximum;
+            } else {
+                double sum = 0.0;
+                for (int child = 0; child < 8; ++child) {
+                    sum += childWeights[child] * children[child * numComponents + component];
+                }
+                parent[component] = sum / childWeightSum;
+            }
+        }
+    }
+}
+
+// Subdivide the cell under the cursor, give its children a contiguous block of global indices and
+// prolongate every field into them. A family collapsed since the last compaction is revived instead.
+template <typename CursorT>
+void SubdivideCell(CellFieldStore& store, CursorT* cursor) {
+    vtkHyperTree* tree = cursor->GetTree();
+    vtkIdType treeIndex = tree->GetTreeIndex();
+    vtkIdType vertexId = cursor->GetVertexId();
+    vtkIdType parentIndex = cursor->GetGlobalNodeIndex();
+
+    // The parent's siblings give the slopes for linear prolongation
+    vtkIdType siblingBase = -1;
+    int childIndex = 0;
+    if (!cursor->IsRoot()) {
+        cursor->ToParent();
+        vtkIdType elder = tree->GetElderChildIndex(static_cast<unsigned int>(cursor->GetVertexId()));
+        childIndex = static_cast<int>(vertexId - elder);
+        cursor->ToChild(static_cast<unsigned char>(childIndex));
+        siblingBase = tree->GetGlobalIndexFromLocal(elder);
+    }
+
+    vtkIdType childBase = AllocateIndices(store, 8);
+    if (cursor->IsLeaf()) {
+        cursor->SubdivideLeaf();
+    } else {
+        store.collapsed[treeIndex][vertexId] = 0;
+    }
+    vtkIdType elder = tree->GetElderChildIndex(static_cast<unsigned int>(vertexId));
+    for (int child = 0; child < 8; ++child) {
+        tree->SetGlobalIndexFromLocal(elder + child, childBase + child);
+    }
+
+    for (CellField& field : store.fields) {
+        int numComponents = field.numComponents;
+        const double* parent = CellTuple(field, parentIndex);
+        double* children = CellTuple(field, childBase);
+        if (field.prolongation == ProlongLinear && siblingBase >= 0) {
+            ProlongateLinear(parent, CellTuple(field, siblingBase), childIndex, numComponents, children);
+        } else {
+            ProlongateInject(parent, numComponents, children);
+        }
+    }
+}
+
+// Restrict the children of the cell under the cursor into it and release their index block. The
+// children must be leaves; the tree itself keeps them until CompactTrees().
+template <typename CursorT>
+bool CollapseCell(CellFieldStore& store, CursorT* cursor) {
+    if (IsLeafCell(store, cursor)) {
+        return false;
+    }
+    vtkHyperTree* tree = cursor->GetTree();
+    vtkIdType treeIndex = tree->GetTreeIndex();
+    vtkIdType vertexId = cursor->GetVertexId();
+    vtkIdType elder = tree->GetElderChildIndex(static_cast<unsigned int>(vertexId));
+    for (int child = 0; child < 8; ++child) {
+        if (!tree->IsLeaf(elder + child) && !IsCollapsed(store, treeIndex, elder + child)) {
+            return false;
+        }
+    }
+
+    vtkIdType childBase = tree->GetGlobalIndexFromLocal(elder);
+    RestrictChildren(store, childBase, cursor->GetGlobalNodeIndex());
+    store.freeBlocks.push_back(childBase);
+    std::vector<unsigned char>& flags = store.collapsed[treeIndex];
+    if (static_cast<vtkIdType>(flags.size()) < tree->GetNumberOfVertices()) {
+        flags.resize(tree->GetNumberOfVertices(), 0);
+    }
+    flags[vertexId] = 1;
+    return true;
+}
+
+// Rebuild every tree with collapsed families from a pruned breadth-first descriptor, keeping the
+// global index of each surviving cell so that no field data moves
+void CompactTrees(CellFieldStore& store) {
+    std::vector<vtkIdType> treeIndices;
+    for (auto& entry : store.collapsed) {
+        treeIndices.push_back(entry.first);
+    }
+    vtkSMPTools::For(0, static_cast<vtkIdType>(treeIndices.size()), 1, [&](vtkIdType first, vtkIdType last) {
+        std::vector<vtkIdType> globalIndices;
+        for (vtkIdType entry = first; entry < last; ++entry) {
+            vtkIdType treeIndex = treeIndices[entry];
+            vtkHyperTree* tree = store.hyperTreeGrid->GetTree(treeIndex);
+            globalIndices.clear();
+            vtkSmartPointer<vtkBitArray> descriptor = PruneBreadthFirst(tree, [&](const PrunedVertex& vertex) {
+                globalIndices.push_back(tree->GetGlobalIndexFromLocal(vertex.vertexId));
+                return !IsCollapsed(store, treeIndex, vertex.vertexId);
+            });
+
+            RebuildTree(store.hyperTreeGrid, tree, treeIndex, descriptor);
+            for (vtkIdType vertexId = 0; vertexId < static_cast<vtkIdType>(globalIndices.size()); ++vertexId) {
+                tree->SetGlobalIndexFromLocal(vertexId, globalIndices[vertexId]);
+            }
+        }
+    });
+    store.collapsed.clear();
+}
+
+// Analytic fields sampled on the finest cells: a density bump around a moving center
+void SampleCell(CellFieldStore& store, vtkHyperTreeGridNonOrientedGeometryCursor* cursor, const double center[3]) {
+    double point[3];
+    cursor->GetPoint(point);
+    double distance2 = 0.0;
+    for (int axis = 0; axis < 3; ++axis) {
+        distance2 += (point[axis] - center[axis]) * (point[axis] - center[axis]);
+    }
+    vtkIdType globalIndex = cursor->GetGlobalNodeIndex();
+    CellTuple(store.fields[0], globalIndex)[0] = std::exp(-distance2);
+    double* velocity = CellTuple(store.fields[1], globalIndex);
+    velocity[0] = point[1] - center[1];
+    velocity[1] = center[0] - point[0];
+    velocity[2] = 0.0;
+    CellTuple(store.fields[2], globalIndex)[0] = std::exp(-distance2);
+    CellTuple(store.fields[3], globalIndex)[0] = distance2 < 1.0 ? 1.0 : 0.5;
+}
+
+// Refine where the density bump is steep, sample the leaves and restrict back up on the way out
+void AdaptToCenter(CellFieldStore& store, vtkHyperTreeGridNonOrientedGeometryCursor* cursor, const double center[3],
+                   unsigned int maxLevel) {
+    double point[3];
+    cursor->GetPoint(point);
+    double size = cursor->GetSize()[0];
+    double distance2 = 0.0;
+    for (int axis = 0; axis < 3; ++axis) {
+        distance2 += (point[axis] - center[axis]) * (point[axis] - center[axis]);
+    }
+    bool wanted = cursor->GetLevel() < maxLevel && std::sqrt(distance2) < 1.5 + size;
+
+    if (wanted && IsLeafCell(store, cursor)) {
+        SubdivideCell(store, cursor);
+    }
+    if (IsLeafCell(store, cursor)) {
+        SampleCell(store, cursor, center);
+        return;
+    }
+    for (unsigned char child = 0; child < cursor->GetNumberOfChildren(); ++child) {
+        cursor->ToChild(child);
+        AdaptToCenter(store, cursor, center, maxLevel);
+        cursor->ToParent();
+    }
+    if (!wanted) {
+        CollapseCell(store, cursor);
+    } else {
+        vtkHyperTree* tree = cursor->GetTree();
+        RestrictChildren(store, tree->GetGlobalIndexFromLocal(tree->GetElderChildIndex(static_cast<unsigned int>(cursor->GetVertexId()))),
+                         cursor->GetGlobalNodeIndex());
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned int maxLevel = argc > 1 ? static_cast<unsigned int>(std::atoi(argv[1])) : 5;
+
+    // Create a uniform hyper tree grid
+    vtkSmartPointer<vtkUniformHyperTreeGrid> hyperTreeGrid = vtkSmartPointer<vtkUniformHyperTreeGrid>::New();
+    hyperTreeGrid->SetDimensions(5, 5, 5); // 3D grid with 4x4x4 root trees
+    hyperTreeGrid->SetBranchFactor(2); // Each cell can be divided into 2x2x2 subcells
+    hyperTreeGrid->SetOrigin(0.0, 0.0, 0.0);
+    hyperTreeGrid->SetGridScale(1.0, 1.0, 1.0);
+
+    // Attach the growable cell data
+    CellFieldStore store;
+    store.hyperTreeGrid = hyperTreeGrid;
+    AddCellField(store, "Density", 1, ProlongLinear, RestrictVolumeWeighted);
+    AddCellField(store, "Velocity", 3, ProlongInject, RestrictMean);
+    AddCellField(store, "PeakDensity", 1, ProlongInject, RestrictMax);
+    store.weightField = AddCellField(store, "VolumeFraction", 1, ProlongInject, RestrictMean);
+    vtkIdType numTrees = hyperTreeGrid->GetMaxNumberOfTrees();
+    for (vtkIdType treeIndex = 0; treeIndex < numTrees; ++treeIndex) {
+        CreateRootCell(store, treeIndex);
+    }
+
+    // Adapt to the bump, move it and adapt again: the second pass collapses cells it left behind
+    // and reuses their index blocks for the cells it refines
+    vtkSmartPointer<vtkHyperTreeGridNonOrientedGeometryCursor> cursor =
+        vtkSmartPointer<vtkHyperTreeGridNonOrientedGeometryCursor>::New();
+    const double centers[2][3] = { { 1.5, 1.5, 2.0 }, { 2.5, 2.2, 2.0 } };
+    for (const double* center : centers) {
+        for (vtkIdType treeIndex = 0; treeIndex < numTrees; ++treeIndex) {
+            hyperTreeGrid->InitializeNonOrientedGeometryCursor(cursor, treeIndex);
+            AdaptToCenter(store, cursor, center, maxLevel);
+        }
+        size_t numFreeBlocks = store.freeBlocks.size();
+        CompactTrees(store);
+        std::cout << hyperTreeGrid->GetNumberOfCells() << " cells, " << store.numIndices << " indices, "
+                  << numFreeBlocks << " free blocks, capacity " << store.capacity << std::endl;
+    }
+
+    // Drop the spare capacity before handing the grid on
+    SqueezeCellFieldStore(store);
+
+    // The grid's cell data now follows every refinement and coarsening. Any further processing can be done here.
+
+    return EXIT_SUCCESS;
+}
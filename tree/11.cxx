@@ -0,0 +1,374 @@
+#include <vtkSmartPointer.h>
+#include <vtkUniformHyperTreeGrid.h>
+#include <vtkHyperTree.h>
+#include <vtkHyperTreeGridNonOrientedGeometryCursor.h>
+#include <vtkHyperTreeGridNonOrientedMooreSuperCursor.h>
+#include <vtkBitArray.h>
+#include <vtkDoubleArray.h>
+#include <vtkCellData.h>
+#include <vtkSMPTools.h>
+#include <vtkSMPThreadLocal.h>
+#include <vtkSMPThreadLocalObject.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "HyperTreePruning.h"
+
+// Moore super cursor entries are ordered x fastest, so the face neighbors along an axis sit at
+// central -/+ stride
+static const unsigned int MooreAxisStride[3] = { 1, 3, 9 };
+
+enum RefinementCriterion
+{
+    CriterionThreshold, CriterionErrorIndicator
+};
+
+// Trees of the grid with their cell values indexed by local vertex id between adaptation passes
+struct AdaptiveGrid {
+    vtkSmartPointer<vtkUniformHyperTreeGrid> hyperTreeGrid;
+    std::vector<vtkHyperTree*> trees;
+    std::vector<std::vector<double>> values;
+    vtkSmartPointer<vtkDoubleArray> cellData;
+};
+
+// Smooth, high-valued ramp crossed by a thin low-valued dip on a sphere
+double SampleField(const double point[3]) {
+    double dx = point[0] - 1.2;
+    double dy = point[1] - 2.0;
+    double dz = point[2] - 2.0;
+    double shell = (std::sqrt(dx * dx + dy * dy + dz * dz) - 1.0) / 0.1;
+    return 20.0 + 0.2 * point[0] - std::exp(-shell * shell);
+}
+
+// Start both criteria from the same uniform level, fine enough to see the dip at all
+void RefineUniformly(AdaptiveGrid& adaptive, vtkHyperTreeGridNonOrientedGeometryCursor* cursor, unsigned int baseLevel) {
+    if (cursor->GetLevel() >= baseLevel) {
+        return;
+    }
+    vtkHyperTree* tree = cursor->GetTree();
+    std::vector<double>& values = adaptive.values[tree->GetTreeIndex()];
+    cursor->SubdivideLeaf();
+    values.resize(tree->GetNumberOfVertices());
+    for (unsigned char child = 0; child < cursor->GetNumberOfChildren(); ++child) {
+        cursor->ToChild(child);
+        double point[3];
+        cursor->GetPoint(point);
+        values[cursor->GetVertexId()] = SampleField(point);
+        RefineUniformly(adaptive, cursor, baseLevel);
+        cursor->ToParent();
+    }
+}
+
+void InitializeAdaptiveGrid(AdaptiveGrid& adaptive, unsigned int baseLevel) {
+    vtkIdType numTrees = adaptive.hyperTreeGrid->GetMaxNumberOfTrees();
+    adaptive.trees.resize(numTrees);
+    adaptive.values.resize(numTrees);
+    vtkSmartPointer<vtkHyperTreeGridNonOrientedGeometryCursor> cursor =
+        vtkSmartPointer<vtkHyperTreeGridNonOrientedGeometryCursor>::New();
+    for (vtkIdType treeIndex = 0; treeIndex < numTrees; ++treeIndex) {
+        adaptive.trees[treeIndex] = adaptive.hyperTreeGrid->GetTree(treeIndex, true);
+        adaptive.hyperTreeGrid->InitializeNonOrientedGeometryCursor(cursor, treeIndex);
+        double point[3];
+        cursor->GetPoint(point);
+        adaptive.values[treeIndex].assign(1, SampleField(point));
+        RefineUniformly(adaptive, cursor, baseLevel);
+    }
+    adaptive.cellData = vtkSmartPointer<vtkDoubleArray>::New();
+    adaptive.cellData->SetName("Value");
+    adaptive.cellData->SetNumberOfComponents(1);
+    adaptive.hyperTreeGrid->GetCellData()->SetScalars(adaptive.cellData);
+}
+
+// Internal nodes hold the mean of their children, the Haar scaling coefficient
+double RestrictTree(vtkHyperTree* tree, std::vector<double>& values, vtkIdType vertexId) {
+    if (tree->IsLeaf(vertexId)) {
+        return values[vertexId];
+    }
+    vtkIdType elder = tree->GetElderChildIndex(static_cast<unsigned int>(vertexId));
+    double sum = 0.0;
+    for (int child = 0; child < 8; ++child) {
+        sum += RestrictTree(tree, values, elder + child);
+    }
+    values[vertexId] = sum / 8.0;
+    return values[vertexId];
+}
+
+// Restrict every tree, then lay the trees out contiguously in the grid's cell array
+void SyncCellData(AdaptiveGrid& adaptive) {
+    vtkIdType numTrees = static_cast<vtkIdType>(adaptive.trees.size());
+    vtkSMPTools::For(0, numTrees, [&](vtkIdType first, vtkIdType last) {
+        for (vtkIdType treeIndex = first; treeIndex < last; ++treeIndex) {
+            RestrictTree(adaptive.trees[treeIndex], adaptive.values[treeIndex], 0);
+        }
+    });
+
+    std::vector<vtkIdType> globalStart(numTrees + 1, 0);
+    for (vtkIdType treeIndex = 0; treeIndex < numTrees; ++treeIndex) {
+        globalStart[treeIndex + 1] = globalStart[treeIndex] + static_cast<vtkIdType>(adaptive.values[treeIndex].size());
+    }
+    adaptive.cellData->SetNumberOfTuples(globalStart[numTrees]);
+    double* cellValues = adaptive.cellData->GetPointer(0);
+    vtkSMPTools::For(0, numTrees, [&](vtkIdType first, vtkIdType last) {
+        for (vtkIdType treeIndex = first; treeIndex < last; ++treeIndex) {
+            adaptive.trees[treeIndex]->SetGlobalIndexStart(globalStart[treeIndex]);
+            std::copy(adaptive.values[treeIndex].begin(), adaptive.values[treeIndex].end(),
+                      cellValues + globalStart[treeIndex]);
+        }
+    });
+}
+
+// Jump of the field across the cell under the cursor, |grad f| * h, from central or one-sided
+// differences with its face neighbors. Coarser neighbors sit further away and are weighted by it.
+double GradientIndicator(vtkHyperTreeGridNonOrientedMooreSuperCursor* cursor, const double* cellValues,
+                         const double* scale) {
+    unsigned int central = cursor->GetNumberOfCursors() / 2;
+    unsigned int level = cursor->GetLevel();
+    double value = cellValues[cursor->GetGlobalNodeIndex()];
+    double gradient2 = 0.0;
+    for (int axis = 0; axis < 3; ++axis) {
+        double size = scale[axis] * std::ldexp(1.0, -static_cast<int>(level));
+        double difference = 0.0;
+        double distance = 0.0;
+        for (int side = -1; side <= 1; side += 2) {
+            unsigned int neighbor = central + side * MooreAxisStride[axis];
+            if (!cursor->HasTree(neighbor)) {
+                continue;
+            }
+            double neighborSize = scale[axis] * std::ldexp(1.0, -static_cast<int>(cursor->GetLevel(neighbor)));
+            difference += side * (cellValues[cursor->GetGlobalNodeIndex(neighbor)] - value);
+            distance += 0.5 * (size + neighborSize);
+        }
+        if (distance > 0.0) {
+            double gradient = difference / distance;
+            gradient2 += gradient * gradient * size * size;
+        }
+    }
+    return std::sqrt(gradient2);
+}
+
+// Largest Haar detail coefficient of a node whose children are leaves: how far any child departs
+// from the parent mean
+double HaarDetail(vtkHyperTree* tree, vtkIdType vertexId, const double* cellValues) {
+    vtkIdType elder = tree->GetElderChildIndex(static_cast<unsigned int>(vertexId));
+    double parent = cellValues[tree->GetGlobalIndexFromLocal(vertexId)];
+    double detail = 0.0;
+    for (int child = 0; child < 8; ++child) {
+        detail = std::max(detail, std::abs(cellValues[tree->GetGlobalIndexFromLocal(elder + child)] - parent));
+    }
+    return detail;
+}
+
+// Decide, for every cell, whether a leaf is refined or a family of leaves is collapsed
+void MarkCells(vtkHyperTreeGridNonOrientedMooreSuperCursor* cursor, const double* cellValues, const double* scale,
+               RefinementCriterion criterion, double target, unsigned int maxLevel, std::vector<unsigned char>& refine,
+               std::vector<unsigned char>& coarsen) {
+    vtkIdType globalIndex = cursor->GetGlobalNodeIndex();
+    if (cursor->IsLeaf()) {
+        bool needed = criterion == CriterionThreshold
+            ? cellValues[globalIndex] > target
+            : GradientIndicator(cursor, cellValues, scale) > target;
+        refine[globalIndex] = needed && cursor->GetLevel() < maxLevel ? 1 : 0;
+        return;
+    }
+
+    bool terminal = true;
+    for (unsigned char child = 0; child < cursor->GetNumberOfChildren(); ++child) {
+        cursor->ToChild(child);
+        MarkCells(cursor, cellValues, scale, criterion, target, maxLevel, refine, coarsen);
+        terminal = terminal && cursor->IsLeaf() && !refine[cursor->GetGlobalNodeIndex()];
+        cursor->ToParent();
+    }
+
+    // Collapse well below the refinement target so that cells do not flip back and forth
+    if (terminal) {
+        vtkHyperTree* tree = cursor->GetTree();
+        bool unneeded = criterion == CriterionThreshold
+            ? cellValues[globalIndex] <= target
+            : HaarDetail(tree, cursor->GetVertexId(), cellValues) < 0.25 * target;
+        coarsen[globalIndex] = unneeded ? 1 : 0;
+    }
+}
+
+// Refine marked leaves, sampling their new children, then rebuild trees that lose collapsed families
+void ApplyMarks(AdaptiveGrid& adaptive, vtkHyperTreeGridNonOrientedGeometryCursor* cursor,
+                const std::vector<unsigned char>& refine, const std::vector<unsigned char>& coarsen,
+                std::vector<vtkIdType>& collapsedVertices) {
+    vtkHyperTree* tree = cursor->GetTree();
+    std::vector<double>& values = adaptive.values[tree->GetTreeIndex()];
+    vtkIdType globalIndex = cursor->GetGlobalNodeIndex();
+    if (cursor->IsLeaf()) {
+        if (refine[globalIndex]) {
+            cursor->SubdivideLeaf();
+            values.resize(tree->GetNumberOfVertices());
+            for (unsigned char child = 0; child < cursor->GetNumberOfChildren(); ++child) {
+                cursor->ToChild(child);
+                double point[3];
+                cursor->GetPoint(point);
+                values[cursor->GetVertexId()] = SampleField(point);
+                cursor->ToParent();
+            }
+        }
+        return;
+    }
+    if (coarsen[globalIndex]) {
+        collapsedVertices.push_back(cursor->GetVertexId());
+        return;
+    }
+    for (unsigned char child = 0; child < cursor->GetNumberOfChildren(); ++child) {
+        cursor->ToChild(child);
+        ApplyMarks(adaptive, cursor, refine, coarsen, collapsedVertices);
+        cursor->ToParent();
+    }
+}
+
+void PruneTree(AdaptiveGrid& adaptive, vtkIdType treeIndex, std::vector<vtkIdType>& collapsedVertices) {
+    vtkHyperTree* tree = adaptive.trees[treeIndex];
+    std::sort(collapsedVertices.begin(), collapsedVertices.end());
+    std::vector<double> values;
+    vtkSmartPointer<vtkBitArray> descriptor = PruneBreadthFirst(tree, [&](const PrunedVertex& vertex) {
+        values.push_back(adaptive.values[treeIndex][vertex.vertexId]);
+        return !std::binary_search(collapsedVertices.begin(), collapsedVertices.end(), vertex.vertexId);
+    });
+    RebuildTree(adaptive.hyperTreeGrid, tree, treeIndex, descriptor);
+    adaptive.values[treeIndex].swap(values);
+}
+
+// One adaptation pass: mark every cell in parallel with a Moore super cursor per thread, then refine
+// and collapse tree by tree in parallel. Returns the number of cells changed.
+vtkIdType AdaptPass(AdaptiveGrid& adaptive, RefinementCriterion criterion, double target, unsigned int maxLevel) {
+    SyncCellData(adaptive);
+    vtkIdType numTrees = static_cast<vtkIdType>(adaptive.trees.size());
+    const double* cellValues = adaptive.cellData->GetPointer(0);
+    const double* scale = adaptive.hyperTreeGrid->GetGridScale();
+    std::vector<unsigned char> refine(adaptive.cellData->GetNumberOfTuples(), 0);
+    std::vector<unsigned char> coarsen(adaptive.cellData->GetNumberOfTuples(), 0);
+
+    vtkSMPThreadLocalObject<vtkHyperTreeGridNonOrientedMooreSuperCursor> mooreCursors;
+    vtkSMPTools::For(0, numTrees, [&](vtkIdType first, vtkIdType last) {
+        vtkHyperTreeGridNonOrientedMooreSuperCursor* cursor = mooreCursors.Local();
+        for (vtkIdType treeIndex = first; treeIndex < last; ++treeIndex) {
+            adaptive.hyperTreeGrid->InitializeNonOrientedMooreSuperCursor(cursor, treeIndex);
+            MarkCells(cursor, cellValues, scale, criterion, target, maxLevel, refine, coarsen);
+        }
+    });
+
+    vtkSMPThreadLocalObject<vtkHyperTreeGridNonOrientedGeometryCursor> geometryCursors;
+    vtkSMPTools::For(0, numTrees, 1, [&](vtkIdType first, vtkIdType last) {
+        vtkHyperTreeGridNonOrientedGeometryCursor* cursor = geometryCursors.Local();
+        std::vector<vtkIdType> collapsedVertices;
+        for (vtkIdType treeIndex = first; treeIndex < last; ++treeIndex) {
+            collapsedVertices.clear();
+            adaptive.hyperTreeGrid->InitializeNonOrientedGeometryCursor(cursor, treeIndex);
+            ApplyMarks(adaptive, cursor, refine, coarsen, collapsedVertices);
+            if (!collapsedVertices.empty()) {
+                PruneTree(adaptive, treeIndex, collapsedVertices);
+            }
+        }
+    });
+
+    vtkIdType numChanged = 0;
+    for (size_t cellId = 0; cellId < refine.size(); ++cellId) {
+        numChanged += refine[cellId] + coarsen[cellId];
+    }
+    return numChanged;
+}
+
+// Largest and volume-weighted deviation between the field and the leaf values over a 3x3x3 lattice
+// in every leaf
+void MeasureError(vtkHyperTreeGridNonOrientedGeometryCursor* cursor, const std::vector<double>& values,
+                  double& maxError, double& sumError, double& sumVolume, vtkIdType& numLeaves) {
+    if (!cursor->IsLeaf()) {
+        for (unsigned char child = 0; child < cursor->GetNumberOfChildren(); ++child) {
+            cursor->ToChild(child);
+            MeasureError(cursor, values, maxError, sumError, sumVolume, numLeaves);
+            cursor->ToParent();
+        }
+        return;
+    }
+    double bounds[6];
+    cursor->GetBounds(bounds);
+    double value = values[cursor->GetVertexId()];
+    double cellError = 0.0;
+    for (int sample = 0; sample < 27; ++sample) {
+        double point[3] = {
+            bounds[0] + 0.5 * (sample % 3) * (bounds[1] - bounds[0]),
+            bounds[2] + 0.5 * ((sample / 3) % 3) * (bounds[3] - bounds[2]),
+            bounds[4] + 0.5 * (sample / 9) * (bounds[5] - bounds[4]) };
+        cellError = std::max(cellError, std::abs(SampleField(point) - value));
+    }
+    maxError = std::max(maxError, cellError);
+    double volume = (bounds[1] - bounds[0]) * (bounds[3] - bounds[2]) * (bounds[5] - bounds[4]);
+    sumError += cellError * volume;
+    sumVolume += volume;
+    ++numLeaves;
+}
+
+void ReportAccuracy(AdaptiveGrid& adaptive, const char* label) {
+    vtkIdType numTrees = static_cast<vtkIdType>(adaptive.trees.size());
+    struct ErrorSummary {
+        double maxError = 0.0;
+        double sumError = 0.0;
+        double sumVolume = 0.0;
+        vtkIdType numLeaves = 0;
+    };
+    vtkSMPThreadLocal<ErrorSummary> summaries;
+    vtkSMPThreadLocalObject<vtkHyperTreeGridNonOrientedGeometryCursor> cursors;
+    vtkSMPTools::For(0, numTrees, [&](vtkIdType first, vtkIdType last) {
+        ErrorSummary& summary = summaries.Local();
+        vtkHyperTreeGridNonOrientedGeometryCursor* cursor = cursors.Local();
+        for (vtkIdType treeIndex = first; treeIndex < last; ++treeIndex) {
+            adaptive.hyperTreeGrid->InitializeNonOrientedGeometryCursor(cursor, treeIndex);
+            MeasureError(cursor, adaptive.values[treeIndex], summary.maxError, summary.sumError, summary.sumVolume,
+                         summary.numLeaves);
+        }
+    });
+
+    ErrorSummary total;
+    for (ErrorSummary& summary : summaries) {
+        total.maxError = std::max(total.maxError, summary.maxError);
+        total.sumError += summary.sumError;
+        total.sumVolume += summary.sumVolume;
+        total.numLeaves += summary.numLeaves;
+    }
+    std::cout << label << ": " << total.numLeaves << " leaves, max error " << total.maxError
+              << ", mean error " << total.sumError / total.sumVolume << std::endl;
+}
+
+vtkSmartPointer<vtkUniformHyperTreeGrid> CreateGrid() {
+    vtkSmartPointer<vtkUniformHyperTreeGrid> hyperTreeGrid = vtkSmartPointer<vtkUniformHyperTreeGrid>::New();
+    hyperTreeGrid->SetDimensions(5, 5, 5); // 3D grid with 4x4x4 root trees
+    hyperTreeGrid->SetBranchFactor(2); // Each cell can be divided into 2x2x2 subcells
+    hyperTreeGrid->SetOrigin(0.0, 0.0, 0.0);
+    hyperTreeGrid->SetGridScale(1.0, 1.0, 1.0);
+    return hyperTreeGrid;
+}
+
+int main(int argc, char* argv[])
+{
+    double targetError = argc > 1 ? std::atof(argv[1]) : 0.1;
+    unsigned int maxLevel = argc > 2 ? static_cast<unsigned int>(std::atoi(argv[2])) : 5;
+    unsigned int baseLevel = 3;
+    double refinementThreshold = 20.6; // Value threshold used by tree/2-6
+
+    // Adapt once with the value threshold and once with the error indicator
+    const RefinementCriterion criteria[2] = { CriterionThreshold, CriterionErrorIndicator };
+    for (RefinementCriterion criterion : criteria) {
+        AdaptiveGrid adaptive;
+        adaptive.hyperTreeGrid = CreateGrid();
+        InitializeAdaptiveGrid(adaptive, baseLevel);
+        double target = criterion == CriterionThreshold ? refinementThreshold : targetError;
+        for (unsigned int pass = 0; pass < 2 * maxLevel + 2; ++pass) {
+            if (AdaptPass(adaptive, criterion, target, maxLevel) == 0) {
+                break;
+            }
+        }
+        SyncCellData(adaptive);
+        ReportAccuracy(adaptive, criterion == CriterionThreshold ? "Value threshold" : "Error indicator");
+    }
+
+    return EXIT_SUCCESS;
+}
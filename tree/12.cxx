@@ -0,0 +1,254 @@
+#include <vtkSmartPointer.h>
+#include <vtkUniformHyperTreeGrid.h>
+#include <vtkHyperTree.h>
+#include <vtkHyperTreeGridNonOrientedGeometryCursor.h>
+#include <vtkBitArray.h>
+#include <vtkDoubleArray.h>
+#include <vtkCellData.h>
+#include <vtkSMPTools.h>
+#include <vtkSMPThreadLocal.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "HyperTreePruning.h"
+
+// An internal node whose family is up for collapsing
+struct LevelNode {
+    vtkIdType treeIndex;
+    vtkIdType vertexId;
+};
+
+// Breadth-first descriptor and cell values of one tree after the sweep
+struct PrunedTree {
+    vtkSmartPointer<vtkBitArray> descriptor;
+    std::vector<double> values;
+    bool pruned = false;
+};
+
+// List the internal nodes of every tree by level, once, in parallel over trees
+std::vector<std::vector<LevelNode>> BuildLevelLists(vtkSmartPointer<vtkHyperTreeGrid> hyperTreeGrid) {
+    vtkIdType numTrees = hyperTreeGrid->GetMaxNumberOfTrees();
+    vtkSMPThreadLocal<std::vector<std::vector<LevelNode>>> localLevels;
+    vtkSMPTools::For(0, numTrees, [&](vtkIdType first, vtkIdType last) {
+        std::vector<std::vector<LevelNode>>& levels = localLevels.Local();
+        std::vector<vtkIdType> levelVertices;
+        std::vector<vtkIdType> nextVertices;
+        for (vtkIdType treeIndex = first; treeIndex < last; ++treeIndex) {
+            vtkHyperTree* tree = hyperTreeGrid->GetTree(treeIndex);
+            if (!tree) {
+                continue;
+            }
+            levelVertices.assign(1, 0);
+            for (size_t level = 0; !levelVertices.empty(); ++level) {
+                nextVertices.clear();
+                for (vtkIdType vertexId : levelVertices) {
+                    if (tree->IsLeaf(vertexId)) {
+                        continue;
+                    }
+                    if (levels.size() <= level) {
+                        levels.resize(level + 1);
+                    }
+                    levels[level].push_back(LevelNode{ treeIndex, vertexId });
+                    vtkIdType elder = tree->GetElderChildIndex(static_cast<unsigned int>(vertexId));
+                    for (int child = 0; child < 8; ++child) {
+                        nextVertices.push_back(elder + child);
+                    }
+                }
+                levelVertices.swap(nextVertices);
+            }
+        }
+    });
+
+    std::vector<std::vector<LevelNode>> levels;
+    for (std::vector<std::vector<LevelNode>>& local : localLevels) {
+        if (levels.size() < local.size()) {
+            levels.resize(local.size());
+        }
+        for (size_t level = 0; level < local.size(); ++level) {
+            levels[level].insert(levels[level].end(), local[level].begin(), local[level].end());
+        }
+    }
+    return levels;
+}
+
+// Collapse every family whose children are all leaves, or became leaves one level down in this same
+// sweep, and all lie below the threshold. Levels are swept from the deepest up; each level is
+// evaluated in parallel and written as one batch, since a level only reads the level below it.
+vtkIdType SweepCoarsening(vtkSmartPointer<vtkHyperTreeGrid> hyperTreeGrid, const std::vector<std::vector<LevelNode>>& levels,
+                          vtkDoubleArray* cellData, double coarseningThreshold, std::vector<unsigned char>& leaf) {
+    double* values = cellData->GetPointer(0);
+    leaf.assign(cellData->GetNumberOfTuples(), 1);
+    for (const std::vector<LevelNode>& nodes : levels) {
+        vtkSMPTools::For(0, static_cast<vtkIdType>(nodes.size()), [&](vtkIdType first, vtkIdType last) {
+            for (vtkIdType nodeId = first; nodeId < last; ++nodeId) {
+                vtkHyperTree* tree = hyperTreeGrid->GetTree(nodes[nodeId].treeIndex);
+                leaf[tree->GetGlobalIndexFromLocal(nodes[nodeId].vertexId)] = 0;
+            }
+        });
+    }
+
+    vtkSMPThreadLocal<vtkIdType> localCollapsed(0);
+    for (size_t level = levels.size(); level-- > 0;) {
+        const std::vector<LevelNode>& nodes = levels[level];
+        vtkSMPTools::For(0, static_cast<vtkIdType>(nodes.size()), [&](vtkIdType first, vtkIdType last) {
+            vtkIdType& collapsed = localCollapsed.Local();
+            for (vtkIdType nodeId = first; nodeId < last; ++nodeId) {
+                vtkHyperTree* tree = hyperTreeGrid->GetTree(nodes[nodeId].treeIndex);
+                vtkIdType elder = tree->GetElderChildIndex(static_cast<unsigned int>(nodes[nodeId].vertexId));
+                bool collapsible = true;
+                double sum = 0.0;
+                for (int child = 0; child < 8 && collapsible; ++child) {
+                    vtkIdType childIndex = tree->GetGlobalIndexFromLocal(elder + child);
+                    collapsible = leaf[childIndex] && values[childIndex] < coarseningThreshold;
+                    sum += values[childIndex];
+                }
+                if (collapsible) {
+                    vtkIdType globalIndex = tree->GetGlobalIndexFromLocal(nodes[nodeId].vertexId);
+                    leaf[globalIndex] = 1;
+                    values[globalIndex] = sum / 8.0;
+                    ++collapsed;
+                }
+            }
+        });
+    }
+
+    vtkIdType numCollapsed = 0;
+    for (vtkIdType collapsed : localCollapsed) {
+        numCollapsed += collapsed;
+    }
+    return numCollapsed;
+}
+
+// Rebuild each pruned tree once from its breadth-first descriptor and compact the cell data so
+// that every tree again owns a contiguous run of global indices
+vtkSmartPointer<vtkDoubleArray> CompactCoarsenedTrees(vtkSmartPointer<vtkHyperTreeGrid> hyperTreeGrid, vtkDoubleArray* cellData,
+                                                      const std::vector<unsigned char>& leaf) {
+    vtkIdType numTrees = hyperTreeGrid->GetMaxNumberOfTrees();
+    const double* values = cellData->GetPointer(0);
+    std::vector<PrunedTree> prunedTrees(numTrees);
+    vtkSMPTools::For(0, numTrees, [&](vtkIdType first, vtkIdType last) {
+        for (vtkIdType treeIndex = first; treeIndex < last; ++treeIndex) {
+            vtkHyperTree* tree = hyperTreeGrid->GetTree(treeIndex);
+            if (!tree) {
+                continue;
+            }
+            PrunedTree& pruned = prunedTrees[treeIndex];
+            pruned.descriptor = PruneBreadthFirst(tree, [&](const PrunedVertex& vertex) {
+                vtkIdType globalIndex = tree->GetGlobalIndexFromLocal(vertex.vertexId);
+                bool refined = !leaf[globalIndex];
+                pruned.pruned |= refined != !tree->IsLeaf(vertex.vertexId);
+                pruned.values.push_back(values[globalIndex]);
+                return refined;
+            });
+        }
+    });
+
+    std::vector<vtkIdType> globalStart(numTrees + 1, 0);
+    for (vtkIdType treeIndex = 0; treeIndex < numTrees; ++treeIndex) {
+        globalStart[treeIndex + 1] = globalStart[treeIndex] + static_cast<vtkIdType>(prunedTrees[treeIndex].values.size());
+    }
+    vtkSmartPointer<vtkDoubleArray> compacted = vtkSmartPointer<vtkDoubleArray>::New();
+    compacted->SetName(cellData->GetName());
+    compacted->SetNumberOfComponents(1);
+    compacted->SetNumberOfTuples(globalStart[numTrees]);
+    double* compactedValues = compacted->GetPointer(0);
+
+    vtkSMPTools::For(0, numTrees, [&](vtkIdType first, vtkIdType last) {
+        for (vtkIdType treeIndex = first; treeIndex < last; ++treeIndex) {
+            vtkHyperTree* tree = hyperTreeGrid->GetTree(treeIndex);
+            if (!tree) {
+                continue;
+            }
+            PrunedTree& pruned = prunedTrees[treeIndex];
+            if (pruned.pruned) {
+                RebuildTree(hyperTreeGrid, tree, treeIndex, pruned.descriptor);
+            }
+            tree->SetGlobalIndexStart(globalStart[treeIndex]);
+            std::copy(pruned.values.begin(), pruned.values.end(), compactedValues + globalStart[treeIndex]);
+            pruned = PrunedTree();
+        }
+    });
+    return compacted;
+}
+
+// Refine uniformly and sample the distance to the grid center on every cell
+void RefineUniformly(vtkHyperTreeGridNonOrientedGeometryCursor* cursor, unsigned int depth) {
+    if (cursor->GetLevel() >= depth) {
+        return;
+    }
+    cursor->SubdivideLeaf();
+    for (unsigned char child = 0; child < cursor->GetNumberOfChildren(); ++child) {
+        cursor->ToChild(child);
+        RefineUniformly(cursor, depth);
+        cursor->ToParent();
+    }
+}
+
+void SampleDistance(vtkHyperTreeGridNonOrientedGeometryCursor* cursor, vtkDoubleArray* cellData) {
+    double point[3];
+    cursor->GetPoint(point);
+    double dx = point[0] - 2.0;
+    double dy = point[1] - 2.0;
+    double dz = point[2] - 2.0;
+    cellData->SetValue(cursor->GetGlobalNodeIndex(), std::sqrt(dx * dx + dy * dy + dz * dz));
+    if (!cursor->IsLeaf()) {
+        for (unsigned char child = 0; child < cursor->GetNumberOfChildren(); ++child) {
+            cursor->ToChild(child);
+            SampleDistance(cursor, cellData);
+            cursor->ToParent();
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned int depth = argc > 1 ? static_cast<unsigned int>(std::atoi(argv[1])) : 5;
+    double coarseningThreshold = argc > 2 ? std::atof(argv[2]) : 1.5;
+
+    // Create a uniform hyper tree grid refined to the same depth everywhere
+    vtkSmartPointer<vtkUniformHyperTreeGrid> hyperTreeGrid = vtkSmartPointer<vtkUniformHyperTreeGrid>::New();
+    hyperTreeGrid->SetDimensions(5, 5, 5); // 3D grid with 4x4x4 root trees
+    hyperTreeGrid->SetBranchFactor(2); // Each cell can be divided into 2x2x2 subcells
+    hyperTreeGrid->SetOrigin(0.0, 0.0, 0.0);
+    hyperTreeGrid->SetGridScale(1.0, 1.0, 1.0);
+    vtkIdType numTrees = hyperTreeGrid->GetMaxNumberOfTrees();
+    vtkSmartPointer<vtkHyperTreeGridNonOrientedGeometryCursor> cursor =
+        vtkSmartPointer<vtkHyperTreeGridNonOrientedGeometryCursor>::New();
+    vtkIdType numCells = 0;
+    for (vtkIdType treeIndex = 0; treeIndex < numTrees; ++treeIndex) {
+        hyperTreeGrid->InitializeNonOrientedGeometryCursor(cursor, treeIndex, true);
+        RefineUniformly(cursor, depth);
+        cursor->GetTree()->SetGlobalIndexStart(numCells);
+        numCells += cursor->GetTree()->GetNumberOfVertices();
+    }
+
+    // Add cell data to the grid
+    vtkSmartPointer<vtkDoubleArray> cellData = vtkSmartPointer<vtkDoubleArray>::New();
+    cellData->SetName("CellData");
+    cellData->SetNumberOfComponents(1);
+    cellData->SetNumberOfTuples(numCells);
+    for (vtkIdType treeIndex = 0; treeIndex < numTrees; ++treeIndex) {
+        hyperTreeGrid->InitializeNonOrientedGeometryCursor(cursor, treeIndex);
+        SampleDistance(cursor, cellData);
+    }
+    hyperTreeGrid->GetCellData()->SetScalars(cellData);
+
+    // Coarsen every level in one sweep and rebuild each tree once
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::vector<LevelNode>> levels = BuildLevelLists(hyperTreeGrid);
+    std::vector<unsigned char> leaf;
+    vtkIdType numCollapsed = SweepCoarsening(hyperTreeGrid, levels, cellData, coarseningThreshold, leaf);
+    vtkSmartPointer<vtkDoubleArray> coarsened = CompactCoarsenedTrees(hyperTreeGrid, cellData, leaf);
+    hyperTreeGrid->GetCellData()->SetScalars(coarsened);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << numCollapsed << " families collapsed over " << levels.size() << " levels in " << seconds
+              << " s, " << numCells << " -> " << coarsened->GetNumberOfTuples() << " cells" << std::endl;
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,467 @@
+#include <vtkSmartPointer.h>
+#include <vtkUniformHyperTreeGrid.h>
+#include <vtkHyperTree.h>
+#include <vtkHyperTreeGridNonOrientedGeometryCursor.h>
+#include <vtkBitArray.h>
+#include <vtkDoubleArray.h>
+#include <vtkCellData.h>
+#include <vtkSMPTools.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+// Checkpoint layout, all sections 8-byte aligned:
+//   header | tree records | level offset table | descriptor bitstreams | cell values
+// The level offset table holds numLevels * numTrees + 1 entries; entry (level, tree) is the index
+// of the first value of that tree at that level. Values are stored level by level, trees in
+// record order within a level, so the cells of levels <= L form one prefix of the value section.
+const char CheckpointMagic[8] = { 'H', 'T', 'G', 'C', 'K', 'P', 'T', '\0' };
+const std::uint32_t CheckpointVersion = 1;
+
+struct CheckpointHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t branchFactor;
+    std::int32_t dimensions[3];
+    std::uint32_t numLevels;
+    double origin[3];
+    double gridScale[3];
+    std::uint64_t numTrees;
+    std::uint64_t numCells;
+    char arrayName[64];
+};
+
+struct CheckpointTree {
+    std::uint64_t treeIndex;
+    std::uint64_t descriptorOffset; // Byte offset of the breadth-first descriptor, one bit per cell
+    std::uint64_t descriptorBits;
+};
+
+// A checkpoint mapped into memory; pages are only read when a loader touches them
+struct CheckpointFile {
+    int fileDescriptor = -1;
+    size_t size = 0;
+    unsigned char* data = nullptr;
+    const CheckpointHeader* header = nullptr;
+    const CheckpointTree* trees = nullptr;
+    const std::uint64_t* levelOffsets = nullptr;
+    const double* values = nullptr;
+};
+
+// Breadth-first descriptor, cells per level and level-ordered values of one tree
+struct PackedTree {
+    std::vector<unsigned char> descriptor;
+    std::vector<vtkIdType> levelCounts;
+    std::vector<double> values;
+};
+
+size_t AlignTo8(size_t offset) {
+    return (offset + 7) & ~static_cast<size_t>(7);
+}
+
+// Walk one tree breadth first, packing the refinement bits most significant bit first as
+// vtkBitArray stores them, so the reader can hand the mapped bytes to a vtkBitArray directly
+void PackTree(vtkHyperTree* tree, vtkDoubleArray* cellData, PackedTree& packed) {
+    std::vector<vtkIdType> levelVertices(1, 0);
+    std::vector<vtkIdType> nextVertices;
+    vtkIdType numBits = 0;
+    while (!levelVertices.empty()) {
+        nextVertices.clear();
+        packed.levelCounts.push_back(static_cast<vtkIdType>(levelVertices.size()));
+        for (vtkIdType vertexId : levelVertices) {
+            if (numBits % 8 == 0) {
+                packed.descriptor.push_back(0);
+            }
+            packed.values.push_back(cellData->GetValue(tree->GetGlobalIndexFromLocal(vertexId)));
+            if (!tree->IsLeaf(vertexId)) {
+                packed.descriptor.back() |= static_cast<unsigned char>(0x80 >> (numBits % 8));
+                vtkIdType elder = tree->GetElderChildIndex(static_cast<unsigned int>(vertexId));
+                for (int child = 0; child < 8; ++child) {
+                    nextVertices.push_back(elder + child);
+                }
+            }
+            ++numBits;
+        }
+        levelVertices.swap(nextVertices);
+    }
+}
+
+// Write every tree of the grid with its cell values to a binary checkpoint
+bool WriteCheckpoint(vtkUniformHyperTreeGrid* hyperTreeGrid, vtkDoubleArray* cellData, const char* fileName) {
+    std::vector<vtkIdType> treeIndices;
+    for (vtkIdType treeIndex = 0; treeIndex < hyperTreeGrid->GetMaxNumberOfTrees(); ++treeIndex) {
+        if (hyperTreeGrid->GetTree(treeIndex)) {
+            treeIndices.push_back(treeIndex);
+        }
+    }
+    vtkIdType numTrees = static_cast<vtkIdType>(treeIndices.size());
+    std::vector<PackedTree> packedTrees(numTrees);
+    vtkSMPTools::For(0, numTrees, [&](vtkIdType first, vtkIdType last) {
+        for (vtkIdType rank = first; rank < last; ++rank) {
+            PackTree(hyperTreeGrid->GetTree(treeIndices[rank]), cellData, packedTrees[rank]);
+        }
+    });
+
+    size_t numLevels = 0;
+    for (const PackedTree& packed : packedTrees) {
+        numLevels = std::max(numLevels, packed.levelCounts.size());
+    }
+    std::vector<std::uint64_t> levelOffsets(numLevels * numTrees + 1, 0);
+    std::uint64_t numCells = 0;
+    for (size_t level = 0; level < numLevels; ++level) {
+        for (vtkIdType rank = 0; rank < numTrees; ++rank) {
+            levelOffsets[level * numTrees + rank] = numCells;
+            const std::vector<vtkIdType>& levelCounts = packedTrees[rank].levelCounts;
+            numCells += level < levelCounts.size() ? levelCounts[level] : 0;
+        }
+    }
+    levelOffsets.back() = numCells;
+
+    CheckpointHeader header = {};
+    std::memcpy(header.magic, CheckpointMagic, sizeof(header.magic));
+    header.version = CheckpointVersion;
+    header.branchFactor = hyperTreeGrid->GetBranchFactor();
+    hyperTreeGrid->GetDimensions(header.dimensions);
+    header.numLevels = static_cast<std::uint32_t>(numLevels);
+    std::copy(hyperTreeGrid->GetOrigin(), hyperTreeGrid->GetOrigin() + 3, header.origin);
+    std::copy(hyperTreeGrid->GetGridScale(), hyperTreeGrid->GetGridScale() + 3, header.gridScale);
+    header.numTrees = static_cast<std::uint64_t>(numTrees);
+    header.numCells = numCells;
+    std::strncpy(header.arrayName, cellData->GetName() ? cellData->GetName() : "", sizeof(header.arrayName) - 1);
+
+    size_t offset = sizeof(CheckpointHeader) + numTrees * sizeof(CheckpointTree) + levelOffsets.size() * sizeof(std::uint64_t);
+    std::vector<CheckpointTree> records(numTrees);
+    for (vtkIdType rank = 0; rank < numTrees; ++rank) {
+        offset = AlignTo8(offset);
+        records[rank].treeIndex = static_cast<std::uint64_t>(treeIndices[rank]);
+        records[rank].descriptorOffset = offset;
+        records[rank].descriptorBits = packedTrees[rank].values.size();
+        offset += packedTrees[rank].descriptor.size();
+    }
+    size_t valuesOffset = AlignTo8(offset);
+
+    std::ofstream file(fileName, std::ios::binary);
+    if (!file) {
+        std::cerr << "Cannot open " << fileName << " for writing" << std::endl;
+        return false;
+    }
+    const char padding[8] = {};
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(CheckpointTree));
+    file.write(reinterpret_cast<const char*>(levelOffsets.data()), levelOffsets.size() * sizeof(std::uint64_t));
+    for (vtkIdType rank = 0; rank < numTrees; ++rank) {
+        file.write(padding, records[rank].descriptorOffset - static_cast<size_t>(file.tellp()));
+        file.write(reinterpret_cast<const char*>(packedTrees[rank].descriptor.data()), packedTrees[rank].descriptor.size());
+    }
+    file.write(padding, valuesOffset - static_cast<size_t>(file.tellp()));
+
+    // Cell values level by level so that coarse previews read a single prefix of the section
+    for (size_t level = 0; level < numLevels; ++level) {
+        for (vtkIdType rank = 0; rank < numTrees; ++rank) {
+            const PackedTree& packed = packedTrees[rank];
+            if (level >= packed.levelCounts.size()) {
+                continue;
+            }
+            vtkIdType levelStart = 0;
+            for (size_t coarser = 0; coarser < level; ++coarser) {
+                levelStart += packed.levelCounts[coarser];
+            }
+            file.write(reinterpret_cast<const char*>(packed.values.data() + levelStart),
+                       packed.levelCounts[level] * sizeof(double));
+        }
+    }
+    return static_cast<bool>(file);
+}
+
+void CloseCheckpoint(CheckpointFile& checkpoint) {
+    if (checkpoint.data) {
+        munmap(checkpoint.data, checkpoint.size);
+        close(checkpoint.fileDescriptor);
+    }
+    checkpoint = CheckpointFile();
+}
+
+// Map a checkpoint read-only and check its header and section sizes
+bool OpenCheckpoint(const char* fileName, CheckpointFile& checkpoint) {
+    checkpoint.fileDescriptor = open(fileName, O_RDONLY);
+    if (checkpoint.fileDescriptor < 0) {
+        std::cerr << "Cannot open " << fileName << std::endl;
+        return false;
+    }
+    struct stat status;
+    if (fstat(checkpoint.fileDescriptor, &status) != 0 || static_cast<size_t>(status.st_size) < sizeof(CheckpointHeader)) {
+        std::cerr << fileName << " is not a hyper tree grid checkpoint" << std::endl;
+        close(checkpoint.fileDescriptor);
+        checkpoint.fileDescriptor = -1;
+        return false;
+    }
+    checkpoint.size = static_cast<size_t>(status.st_size);
+    void* data = mmap(nullptr, checkpoint.size, PROT_READ, MAP_PRIVATE, checkpoint.fileDescriptor, 0);
+    if (data == MAP_FAILED) {
+        std::cerr << "Cannot map " << fileName << std::endl;
+        close(checkpoint.fileDescriptor);
+        checkpoint.fileDescriptor = -1;
+        return false;
+    }
+    checkpoint.data = static_cast<unsigned char*>(data);
+    checkpoint.header = reinterpret_cast<const CheckpointHeader*>(checkpoint.data);
+
+    const CheckpointHeader* header = checkpoint.header;
+    size_t tablesSize = header->numTrees * sizeof(CheckpointTree) +
+                        (header->numLevels * header->numTrees + 1) * sizeof(std::uint64_t);
+    bool valid = std::memcmp(header->magic, CheckpointMagic, sizeof(header->magic)) == 0 &&
+                 header->version == CheckpointVersion && header->branchFactor == 2 &&
+                 sizeof(CheckpointHeader) + tablesSize <= checkpoint.size &&
+                 header->numCells * sizeof(double) <= checkpoint.size;
+    if (!valid) {
+        std::cerr << fileName << " is not a hyper tree grid checkpoint" << std::endl;
+        CloseCheckpoint(checkpoint);
+        return false;
+    }
+    checkpoint.trees = reinterpret_cast<const CheckpointTree*>(checkpoint.data + sizeof(CheckpointHeader));
+    checkpoint.levelOffsets = reinterpret_cast<const std::uint64_t*>(checkpoint.trees + header->numTrees);
+    checkpoint.values = reinterpret_cast<const double*>(checkpoint.data + checkpoint.size - header->numCells * sizeof(double));
+    return true;
+}
+
+// Cells of a tree at one level, read from the level offset table
+vtkIdType CheckpointLevelCount(const CheckpointFile& checkpoint, vtkIdType rank, unsigned int level) {
+    vtkIdType numTrees = static_cast<vtkIdType>(checkpoint.header->numTrees);
+    const std::uint64_t* entry = checkpoint.levelOffsets + level * numTrees + rank;
+    return static_cast<vtkIdType>(entry[1] - entry[0]);
+}
+
+// Build a grid holding the levels <= maxLevel of the selected root trees, or of all trees when
+// none are selected. Only the descriptor bits above maxLevel and the value blocks of the loaded
+// levels are touched, so the rest of the file is never paged in.
+vtkSmartPointer<vtkUniformHyperTreeGrid> LoadCheckpoint(const CheckpointFile& checkpoint, unsigned int maxLevel,
+                                                        const std::vector<vtkIdType>& selectedTrees) {
+    const CheckpointHeader* header = checkpoint.header;
+    vtkSmartPointer<vtkUniformHyperTreeGrid> hyperTreeGrid = vtkSmartPointer<vtkUniformHyperTreeGrid>::New();
+    hyperTreeGrid->SetDimensions(header->dimensions[0], header->dimensions[1], header->dimensions[2]);
+    hyperTreeGrid->SetBranchFactor(header->branchFactor);
+    hyperTreeGrid->SetOrigin(header->origin[0], header->origin[1], header->origin[2]);
+    hyperTreeGrid->SetGridScale(header->gridScale[0], header->gridScale[1], header->gridScale[2]);
+
+    // Resolve the selected tree indices to records, which are sorted by tree index
+    vtkIdType numRecords = static_cast<vtkIdType>(header->numTrees);
+    std::vector<vtkIdType> ranks;
+    if (selectedTrees.empty()) {
+        ranks.resize(numRecords);
+        for (vtkIdType rank = 0; rank < numRecords; ++rank) {
+            ranks[rank] = rank;
+        }
+    }
+    for (vtkIdType treeIndex : selectedTrees) {
+        const CheckpointTree* record = std::lower_bound(checkpoint.trees, checkpoint.trees + numRecords, treeIndex,
+            [](const CheckpointTree& tree, vtkIdType index) { return static_cast<vtkIdType>(tree.treeIndex) < index; });
+        if (record != checkpoint.trees + numRecords && static_cast<vtkIdType>(record->treeIndex) == treeIndex) {
+            ranks.push_back(record - checkpoint.trees);
+        }
+    }
+
+    unsigned int numLevels = std::min(maxLevel + 1, header->numLevels);
+    vtkIdType numTrees = static_cast<vtkIdType>(ranks.size());
+    std::vector<vtkIdType> globalStart(numTrees + 1, 0);
+    for (vtkIdType treeId = 0; treeId < numTrees; ++treeId) {
+        vtkIdType numCells = 0;
+        for (unsigned int level = 0; level < numLevels; ++level) {
+            numCells += CheckpointLevelCount(checkpoint, ranks[treeId], level);
+        }
+        globalStart[treeId + 1] = globalStart[treeId] + numCells;
+    }
+
+    // Tree creation touches the grid's tree map and stays serial
+    std::vector<vtkHyperTree*> trees(numTrees);
+    for (vtkIdType treeId = 0; treeId < numTrees; ++treeId) {
+        trees[treeId] = hyperTreeGrid->GetTree(static_cast<vtkIdType>(checkpoint.trees[ranks[treeId]].treeIndex), true);
+    }
+
+    vtkSmartPointer<vtkDoubleArray> cellData = vtkSmartPointer<vtkDoubleArray>::New();
+    cellData->SetName(header->arrayName);
+    cellData->SetNumberOfComponents(1);
+    cellData->SetNumberOfTuples(globalStart[numTrees]);
+    double* values = cellData->GetPointer(0);
+
+    vtkSMPTools::For(0, numTrees, [&](vtkIdType first, vtkIdType last) {
+        vtkSmartPointer<vtkBitArray> descriptor = vtkSmartPointer<vtkBitArray>::New();
+        for (vtkIdType treeId = first; treeId < last; ++treeId) {
+            const CheckpointTree& record = checkpoint.trees[ranks[treeId]];
+
+            // Cells on the deepest loaded level are described as leaves by leaving their bits out
+            vtkIdType numBits = 0;
+            for (unsigned int level = 0; level + 1 < numLevels; ++level) {
+                numBits += CheckpointLevelCount(checkpoint, ranks[treeId], level);
+            }
+            descriptor->SetArray(checkpoint.data + record.descriptorOffset, static_cast<vtkIdType>(record.descriptorBits), 1);
+            vtkHyperTree* tree = trees[treeId];
+            tree->BuildFromBreadthFirstOrderDescriptor(descriptor, numBits);
+            tree->SetGlobalIndexStart(globalStart[treeId]);
+
+            double* treeValues = values + globalStart[treeId];
+            for (unsigned int level = 0; level < numLevels; ++level) {
+                vtkIdType numCells = CheckpointLevelCount(checkpoint, ranks[treeId], level);
+                const double* levelValues = checkpoint.values + checkpoint.levelOffsets[level * numRecords + ranks[treeId]];
+                std::copy(levelValues, levelValues + numCells, treeValues);
+                treeValues += numCells;
+            }
+        }
+    });
+    hyperTreeGrid->GetCellData()->SetScalars(cellData);
+    return hyperTreeGrid;
+}
+
+// Gaussian concentration bump. Its value falls from 1 at the center to nearly 0 a few widths away,
+// so the refinement it drives is deep at the center and fades out gradually.
+struct GaussianBump {
+    double center[3];
+    double width;
+    double tolerance;
+
+    double Value(const double point[3]) const {
+        double dx = point[0] - center[0];
+        double dy = point[1] - center[1];
+        double dz = point[2] - center[2];
+        return std::exp(-(dx * dx + dy * dy + dz * dz) / (width * width));
+    }
+};
+
+// Refine the cells over which the bump varies by more than its tolerance, judged from its values
+// at the cell center and corners
+void RefineTowardBump(vtkHyperTreeGridNonOrientedGeometryCursor* cursor, unsigned int depth, const GaussianBump& bump) {
+    if (cursor->GetLevel() >= depth) {
+        return;
+    }
+    double bounds[6];
+    cursor->GetBounds(bounds);
+    double point[3];
+    cursor->GetPoint(point);
+    double low = bump.Value(point);
+    double high = low;
+    for (int corner = 0; corner < 8; ++corner) {
+        for (int axis = 0; axis < 3; ++axis) {
+            point[axis] = bounds[2 * axis + ((corner >> axis) & 1)];
+        }
+        double value = bump.Value(point);
+        low = std::min(low, value);
+        high = std::max(high, value);
+    }
+    if (high - low <= bump.tolerance) {
+        return;
+    }
+    cursor->SubdivideLeaf();
+    for (unsigned char child = 0; child < cursor->GetNumberOfChildren(); ++child) {
+        cursor->ToChild(child);
+        RefineTowardBump(cursor, depth, bump);
+        cursor->ToParent();
+    }
+}
+
+// Store the bump at the center of every leaf and the mean of its children on every coarse cell, so
+// a checkpoint loaded down to any level holds the field averaged at that resolution
+double RestrictBump(vtkHyperTreeGridNonOrientedGeometryCursor* cursor, const GaussianBump& bump, vtkDoubleArray* cellData) {
+    double value = 0.0;
+    if (cursor->IsLeaf()) {
+        double point[3];
+        cursor->GetPoint(point);
+        value = bump.Value(point);
+    } else {
+        for (unsigned char child = 0; child < cursor->GetNumberOfChildren(); ++child) {
+            cursor->ToChild(child);
+            value += RestrictBump(cursor, bump, cellData);
+            cursor->ToParent();
+        }
+        value /= cursor->GetNumberOfChildren();
+    }
+    cellData->SetValue(cursor->GetGlobalNodeIndex(), value);
+    return value;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " checkpoint.htgc [depth] [previewLevel]" << std::endl;
+        return EXIT_FAILURE;
+    }
+    unsigned int depth = argc > 2 ? static_cast<unsigned int>(std::atoi(argv[2])) : 7;
+    unsigned int previewLevel = argc > 3 ? static_cast<unsigned int>(std::atoi(argv[3])) : 2;
+
+    // Create a uniform hyper tree grid refined where a concentration bump varies
+    vtkSmartPointer<vtkUniformHyperTreeGrid> hyperTreeGrid = vtkSmartPointer<vtkUniformHyperTreeGrid>::New();
+    hyperTreeGrid->SetDimensions(5, 5, 5); // 3D grid with 4x4x4 root trees
+    hyperTreeGrid->SetBranchFactor(2); // Each cell can be divided into 2x2x2 subcells
+    hyperTreeGrid->SetOrigin(0.0, 0.0, 0.0);
+    hyperTreeGrid->SetGridScale(1.0, 1.0, 1.0);
+    GaussianBump bump = { { 1.7, 2.2, 1.3 }, 0.6, 0.05 };
+    vtkIdType numTrees = hyperTreeGrid->GetMaxNumberOfTrees();
+    vtkSmartPointer<vtkHyperTreeGridNonOrientedGeometryCursor> cursor =
+        vtkSmartPointer<vtkHyperTreeGridNonOrientedGeometryCursor>::New();
+    vtkIdType numCells = 0;
+    for (vtkIdType treeIndex = 0; treeIndex < numTrees; ++treeIndex) {
+        hyperTreeGrid->InitializeNonOrientedGeometryCursor(cursor, treeIndex, true);
+        RefineTowardBump(cursor, depth, bump);
+        cursor->GetTree()->SetGlobalIndexStart(numCells);
+        numCells += cursor->GetTree()->GetNumberOfVertices();
+    }
+
+    // Add cell data to the grid
+    vtkSmartPointer<vtkDoubleArray> cellData = vtkSmartPointer<vtkDoubleArray>::New();
+    cellData->SetName("Concentration");
+    cellData->SetNumberOfComponents(1);
+    cellData->SetNumberOfTuples(numCells);
+    for (vtkIdType treeIndex = 0; treeIndex < numTrees; ++treeIndex) {
+        hyperTreeGrid->InitializeNonOrientedGeometryCursor(cursor, treeIndex);
+        RestrictBump(cursor, bump, cellData);
+    }
+    hyperTreeGrid->GetCellData()->SetScalars(cellData);
+
+    // Save the checkpoint
+    auto start = std::chrono::steady_clock::now();
+    if (!WriteCheckpoint(hyperTreeGrid, cellData, argv[1])) {
+        return EXIT_FAILURE;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Wrote " << numCells << " cells in " << seconds << " s" << std::endl;
+
+    // Load a coarse preview, one slab of root trees, and the full grid for a restart
+    CheckpointFile checkpoint;
+    if (!OpenCheckpoint(argv[1], checkpoint)) {
+        return EXIT_FAILURE;
+    }
+    std::vector<vtkIdType> slab;
+    for (vtkIdType treeIndex = 0; treeIndex < 16; ++treeIndex) {
+        slab.push_back(treeIndex);
+    }
+    struct LoadRequest {
+        const char* name;
+        unsigned int maxLevel;
+        std::vector<vtkIdType> trees;
+    };
+    std::vector<LoadRequest> requests = {
+        { "Preview", previewLevel, {} },
+        { "Slab", depth, slab },
+        { "Restart", depth, {} },
+    };
+    for (const LoadRequest& request : requests) {
+        start = std::chrono::steady_clock::now();
+        vtkSmartPointer<vtkUniformHyperTreeGrid> loaded = LoadCheckpoint(checkpoint, request.maxLevel, request.trees);
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << request.name << ": " << loaded->GetCellData()->GetScalars()->GetNumberOfTuples() << " cells, "
+                  << loaded->GetNumberOfLevels() << " levels in " << seconds << " s" << std::endl;
+    }
+    CloseCheckpoint(checkpoint);
+
+    return EXIT_SUCCESS;
+}
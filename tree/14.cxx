@@ -0,0 +1,569 @@
+#include <vtkSmartPointer.h>
+#include <vtkUniformHyperTreeGrid.h>
+#include <vtkHyperTree.h>
+#include <vtkHyperTreeGridNonOrientedGeometryCursor.h>
+#include <vtkBitArray.h>
+#include <vtkDoubleArray.h>
+#include <vtkTypeInt64Array.h>
+#include <vtkCellData.h>
+#include <vtkFieldData.h>
+#include <vtkCellArray.h>
+#include <vtkCellType.h>
+#include <vtkPoints.h>
+#include <vtkUnstructuredGrid.h>
+#include <vtkXMLUnstructuredGridWriter.h>
+#include <vtkSMPTools.h>
+#include <vtkSMPThreadLocal.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+// Corner offsets of a leaf in VTK hexahedron order
+const int HexCorners[8][3] = {
+    { 0, 0, 0 }, { 1, 0, 0 }, { 1, 1, 0 }, { 0, 1, 0 },
+    { 0, 0, 1 }, { 1, 0, 1 }, { 1, 1, 1 }, { 0, 1, 1 }
+};
+
+// A leaf cell, located on the lattice of its own level across the whole grid
+struct LeafHex {
+    vtkIdType globalIndex;
+    unsigned int level;
+    std::uint32_t ijk[3];
+};
+
+struct NodeWeight {
+    vtkIdType nodeId;
+    double weight;
+};
+
+// A node lying inside a face or edge of a coarser leaf, tied to free nodes only
+struct HangingNode {
+    vtkIdType nodeId;
+    std::vector<NodeWeight> masters;
+};
+
+// Corner nodes keyed by their Morton code on the finest lattice. Slots are claimed with a
+// compare-and-swap, so every thread inserts the corners of its own leaves concurrently.
+struct NodeHash {
+    static const std::uint64_t EmptyKey = ~static_cast<std::uint64_t>(0);
+    std::vector<std::atomic<std::uint64_t>> keys;
+    std::vector<vtkIdType> ids;
+    std::uint64_t mask = 0;
+    int shift = 0;
+};
+
+std::uint64_t SpreadBits(std::uint64_t value) {
+    value &= 0x1fffff;
+    value = (value | value << 32) & 0x1f00000000ffffULL;
+    value = (value | value << 16) & 0x1f0000ff0000ffULL;
+    value = (value | value << 8) & 0x100f00f00f00f00fULL;
+    value = (value | value << 4) & 0x10c30c30c30c30c3ULL;
+    value = (value | value << 2) & 0x1249249249249249ULL;
+    return value;
+}
+
+std::uint64_t CompactBits(std::uint64_t value) {
+    value &= 0x1249249249249249ULL;
+    value = (value | value >> 2) & 0x10c30c30c30c30c3ULL;
+    value = (value | value >> 4) & 0x100f00f00f00f00fULL;
+    value = (value | value >> 8) & 0x1f0000ff0000ffULL;
+    value = (value | value >> 16) & 0x1f00000000ffffULL;
+    value = (value | value >> 32) & 0x1fffff;
+    return value;
+}
+
+std::uint64_t MortonKey(std::uint64_t i, std::uint64_t j, std::uint64_t k) {
+    return SpreadBits(i) | SpreadBits(j) << 1 | SpreadBits(k) << 2;
+}
+
+void AllocateNodeHash(NodeHash& hash, vtkIdType maxNumNodes) {
+    std::uint64_t capacity = 1;
+    hash.shift = 64;
+    while (capacity < 2 * static_cast<std::uint64_t>(maxNumNodes)) {
+        capacity <<= 1;
+        --hash.shift;
+    }
+    hash.keys = std::vector<std::atomic<std::uint64_t>>(capacity);
+    hash.ids.assign(capacity, -1);
+    hash.mask = capacity - 1;
+    vtkSMPTools::For(0, static_cast<vtkIdType>(capacity), [&](vtkIdType first, vtkIdType last) {
+        for (vtkIdType slot = first; slot < last; ++slot) {
+            hash.keys[slot].store(NodeHash::EmptyKey, std::memory_order_relaxed);
+        }
+    });
+}
+
+std::uint64_t HashSlot(const NodeHash& hash, std::uint64_t key) {
+    return hash.shift < 64 ? (key * 0x9e3779b97f4a7c15ULL) >> hash.shift : 0;
+}
+
+void InsertNode(NodeHash& hash, std::uint64_t key) {
+    for (std::uint64_t slot = HashSlot(hash, key);; slot = (slot + 1) & hash.mask) {
+        std::uint64_t found = NodeHash::EmptyKey;
+        if (hash.keys[slot].compare_exchange_strong(found, key, std::memory_order_relaxed) || found == key) {
+            return;
+        }
+    }
+}
+
+std::uint64_t FindNodeSlot(const NodeHash& hash, std::uint64_t key) {
+    for (std::uint64_t slot = HashSlot(hash, key);; slot = (slot + 1) & hash.mask) {
+        std::uint64_t found = hash.keys[slot].load(std::memory_order_relaxed);
+        if (found == key || found == NodeHash::EmptyKey) {
+            return slot;
+        }
+    }
+}
+
+vtkIdType FindNode(const NodeHash& hash, std::uint64_t key) {
+    return hash.ids[FindNodeSlot(hash, key)];
+}
+
+bool IsMaskedLeaf(vtkHyperTreeGrid* hyperTreeGrid, vtkIdType globalIndex) {
+    return hyperTreeGrid->HasMask() && hyperTreeGrid->GetMask()->GetValue(globalIndex) != 0;
+}
+
+// Collect the unmasked leaves of one tree depth first
+void CollectTreeLeaves(vtkHyperTreeGrid* hyperTreeGrid, vtkHyperTree* tree, vtkIdType vertexId, unsigned int level,
+                       const std::uint32_t ijk[3], std::vector<LeafHex>& leaves) {
+    if (tree->IsLeaf(vertexId)) {
+        vtkIdType globalIndex = tree->GetGlobalIndexFromLocal(vertexId);
+        if (!IsMaskedLeaf(hyperTreeGrid, globalIndex)) {
+            leaves.push_back(LeafHex{ globalIndex, level, { ijk[0], ijk[1], ijk[2] } });
+        }
+        return;
+    }
+    vtkIdType elder = tree->GetElderChildIndex(static_cast<unsigned int>(vertexId));
+    for (int child = 0; child < 8; ++child) {
+        std::uint32_t childIjk[3];
+        for (int axis = 0; axis < 3; ++axis) {
+            childIjk[axis] = 2 * ijk[axis] + ((child >> axis) & 1);
+        }
+        CollectTreeLeaves(hyperTreeGrid, tree, elder + child, level + 1, childIjk, leaves);
+    }
+}
+
+// Finest corner of a leaf on the finest lattice
+std::uint64_t LeafCornerKey(const LeafHex& leaf, const int corner[3], unsigned int maxLevel) {
+    unsigned int shift = maxLevel - leaf.level;
+    return MortonKey(static_cast<std::uint64_t>(leaf.ijk[0] + corner[0]) << shift,
+                     static_cast<std::uint64_t>(leaf.ijk[1] + corner[1]) << shift,
+                     static_cast<std::uint64_t>(leaf.ijk[2] + corner[2]) << shift);
+}
+
+// Descend to the leaf holding the finest lattice cell 'cell', or return false when the cell is
+// outside the grid or masked
+bool FindLeaf(vtkHyperTreeGrid* hyperTreeGrid, const std::int64_t cell[3], unsigned int maxLevel, const int cellDims[3],
+              LeafHex& leaf) {
+    for (int axis = 0; axis < 3; ++axis) {
+        if (cell[axis] < 0 || cell[axis] >= (static_cast<std::int64_t>(cellDims[axis]) << maxLevel)) {
+            return false;
+        }
+    }
+    vtkIdType treeIndex;
+    hyperTreeGrid->GetIndexFromLevelZeroCoordinates(treeIndex, static_cast<unsigned int>(cell[0] >> maxLevel),
+                                                    static_cast<unsigned int>(cell[1] >> maxLevel),
+                                                    static_cast<unsigned int>(cell[2] >> maxLevel));
+    vtkHyperTree* tree = hyperTreeGrid->GetTree(treeIndex);
+    if (!tree) {
+        return false;
+    }
+    vtkIdType vertexId = 0;
+    unsigned int level = 0;
+    while (!tree->IsLeaf(vertexId)) {
+        unsigned int bit = maxLevel - level - 1;
+        int child = static_cast<int>(((cell[0] >> bit) & 1) | ((cell[1] >> bit) & 1) << 1 | ((cell[2] >> bit) & 1) << 2);
+        vertexId = tree->GetElderChildIndex(static_cast<unsigned int>(vertexId)) + child;
+        ++level;
+    }
+    leaf.globalIndex = tree->GetGlobalIndexFromLocal(vertexId);
+    leaf.level = level;
+    for (int axis = 0; axis < 3; ++axis) {
+        leaf.ijk[axis] = static_cast<std::uint32_t>(cell[axis] >> (maxLevel - level));
+    }
+    return !IsMaskedLeaf(hyperTreeGrid, leaf.globalIndex);
+}
+
+// Find the coarsest leaf around a node that does not have it as a corner and, if there is one,
+// tie the node to the corners of that leaf with their trilinear weights. Only the corners of
+// the face or edge holding the node get a nonzero weight.
+bool FindHangingMasters(vtkHyperTreeGrid* hyperTreeGrid, const NodeHash& hash, const std::uint64_t node[3],
+                        unsigned int maxLevel, const int cellDims[3], std::vector<NodeWeight>& masters) {
+    LeafHex coarsest = {};
+    bool hanging = false;
+    for (int octant = 0; octant < 8; ++octant) {
+        std::int64_t cell[3];
+        for (int axis = 0; axis < 3; ++axis) {
+            cell[axis] = static_cast<std::int64_t>(node[axis]) - ((octant >> axis) & 1);
+        }
+        LeafHex leaf;
+        if (!FindLeaf(hyperTreeGrid, cell, maxLevel, cellDims, leaf) || (hanging && leaf.level >= coarsest.level)) {
+            continue;
+        }
+        std::uint64_t mask = (static_cast<std::uint64_t>(1) << (maxLevel - leaf.level)) - 1;
+        if ((node[0] & mask) || (node[1] & mask) || (node[2] & mask)) {
+            coarsest = leaf;
+            hanging = true;
+        }
+    }
+    if (!hanging) {
+        return false;
+    }
+
+    unsigned int shift = maxLevel - coarsest.level;
+    double size = std::ldexp(1.0, static_cast<int>(shift));
+    double local[3];
+    for (int axis = 0; axis < 3; ++axis) {
+        local[axis] = (static_cast<double>(node[axis]) - static_cast<double>(static_cast<std::uint64_t>(coarsest.ijk[axis]) << shift)) / size;
+    }
+    masters.clear();
+    for (const int* corner : HexCorners) {
+        double weight = 1.0;
+        for (int axis = 0; axis < 3; ++axis) {
+            weight *= corner[axis] ? local[axis] : 1.0 - local[axis];
+        }
+        if (weight > 0.0) {
+            masters.push_back(NodeWeight{ FindNode(hash, LeafCornerKey(coarsest, corner, maxLevel)), weight });
+        }
+    }
+    return true;
+}
+
+// Replace masters that hang themselves by their own masters, so that every constraint only
+// refers to free nodes. Chains end because each step moves to a strictly coarser leaf.
+void FlattenMasters(const std::vector<HangingNode>& hangingNodes, const std::vector<vtkIdType>& hangingIndex,
+                    const std::vector<NodeWeight>& masters, double scale, std::vector<NodeWeight>& flattened) {
+    for (const NodeWeight& master : masters) {
+        vtkIdType index = hangingIndex[master.nodeId];
+        if (index < 0) {
+            flattened.push_back(NodeWeight{ master.nodeId, scale * master.weight });
+        } else {
+            FlattenMasters(hangingNodes, hangingIndex, hangingNodes[index].masters, scale * master.weight, flattened);
+        }
+    }
+}
+
+// Convert the unmasked leaves of the grid to a hexahedral unstructured grid. Corner nodes are
+// deduplicated through a Morton-keyed hash and numbered in Morton order; nodes hanging on a
+// coarser neighbor are returned as linear constraints on free nodes.
+vtkSmartPointer<vtkUnstructuredGrid> ConvertToHexMesh(vtkUniformHyperTreeGrid* hyperTreeGrid, vtkDoubleArray* cellData,
+                                                       std::vector<HangingNode>& hangingNodes) {
+    vtkIdType numTrees = hyperTreeGrid->GetMaxNumberOfTrees();
+    unsigned int maxLevel = hyperTreeGrid->GetNumberOfLevels() - 1;
+    int cellDims[3];
+    hyperTreeGrid->GetCellDims(cellDims);
+    for (int axis = 0; axis < 3; ++axis) {
+        if ((static_cast<std::uint64_t>(cellDims[axis]) << maxLevel) >= (static_cast<std::uint64_t>(1) << 21)) {
+            std::cerr << "Grid is too deep for 21-bit Morton keys" << std::endl;
+            return nullptr;
+        }
+    }
+
+    // Leaves of every tree, then hex ids in tree order
+    std::vector<std::vector<LeafHex>> treeLeaves(numTrees);
+    vtkSMPTools::For(0, numTrees, [&](vtkIdType first, vtkIdType last) {
+        for (vtkIdType treeIndex = first; treeIndex < last; ++treeIndex) {
+            vtkHyperTree* tree = hyperTreeGrid->GetTree(treeIndex);
+            if (!tree) {
+                continue;
+            }
+            unsigned int i, j, k;
+            hyperTreeGrid->GetLevelZeroCoordinatesFromIndex(treeIndex, i, j, k);
+            std::uint32_t ijk[3] = { i, j, k };
+            CollectTreeLeaves(hyperTreeGrid, tree, 0, 0, ijk, treeLeaves[treeIndex]);
+        }
+    });
+    std::vector<vtkIdType> treeStart(numTrees + 1, 0);
+    for (vtkIdType treeIndex = 0; treeIndex < numTrees; ++treeIndex) {
+        treeStart[treeIndex + 1] = treeStart[treeIndex] + static_cast<vtkIdType>(treeLeaves[treeIndex].size());
+    }
+    vtkIdType numHexes = treeStart[numTrees];
+
+    // Every refinement of a cell adds at most 19 nodes and 7 leaves, so the corners of all leaves,
+    // masked ones included, are bounded by 3 per leaf plus 8 per tree. Masked leaves leave the
+    // unmasked ones isolated, with up to 8 corners each, so the smaller bound is used.
+    vtkIdType numAllLeaves = 0;
+    vtkIdType numRoots = 0;
+    for (vtkIdType treeIndex = 0; treeIndex < numTrees; ++treeIndex) {
+        if (vtkHyperTree* tree = hyperTreeGrid->GetTree(treeIndex)) {
+            numAllLeaves += tree->GetNumberOfLeaves();
+            ++numRoots;
+        }
+    }
+    NodeHash hash;
+    AllocateNodeHash(hash, std::min(8 * numHexes, 3 * numAllLeaves + 8 * numRoots));
+    vtkSMPTools::For(0, numTrees, [&](vtkIdType first, vtkIdType last) {
+        for (vtkIdType treeIndex = first; treeIndex < last; ++treeIndex) {
+            for (const LeafHex& leaf : treeLeaves[treeIndex]) {
+                for (const int* corner : HexCorners) {
+                    InsertNode(hash, LeafCornerKey(leaf, corner, maxLevel));
+                }
+            }
+        }
+    });
+
+    // Number the nodes in Morton order so neighboring nodes get nearby ids
+    std::vector<std::uint64_t> nodeKeys;
+    for (std::atomic<std::uint64_t>& key : hash.keys) {
+        std::uint64_t value = key.load(std::memory_order_relaxed);
+        if (value != NodeHash::EmptyKey) {
+            nodeKeys.push_back(value);
+        }
+    }
+    vtkSMPTools::Sort(nodeKeys.begin(), nodeKeys.end());
+    vtkIdType numNodes = static_cast<vtkIdType>(nodeKeys.size());
+
+    vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
+    points->SetDataTypeToDouble();
+    points->SetNumberOfPoints(numNodes);
+    double* coordinates = vtkDoubleArray::SafeDownCast(points->GetData())->GetPointer(0);
+    const double* origin = hyperTreeGrid->GetOrigin();
+    const double* gridScale = hyperTreeGrid->GetGridScale();
+    double cellSize = std::ldexp(1.0, -static_cast<int>(maxLevel));
+    vtkSMPTools::For(0, numNodes, [&](vtkIdType first, vtkIdType last) {
+        for (vtkIdType nodeId = first; nodeId < last; ++nodeId) {
+            hash.ids[FindNodeSlot(hash, nodeKeys[nodeId])] = nodeId;
+            for (int axis = 0; axis < 3; ++axis) {
+                double lattice = static_cast<double>(CompactBits(nodeKeys[nodeId] >> axis));
+                coordinates[3 * nodeId + axis] = origin[axis] + gridScale[axis] * lattice * cellSize;
+            }
+        }
+    });
+
+    // Hexahedra and their cell values, written straight into the cell array storage
+    vtkSmartPointer<vtkTypeInt64Array> offsets = vtkSmartPointer<vtkTypeInt64Array>::New();
+    offsets->SetNumberOfValues(numHexes + 1);
+    vtkSmartPointer<vtkTypeInt64Array> connectivity = vtkSmartPointer<vtkTypeInt64Array>::New();
+    connectivity->SetNumberOfValues(8 * numHexes);
+    vtkSmartPointer<vtkDoubleArray> hexData = vtkSmartPointer<vtkDoubleArray>::New();
+    hexData->SetName(cellData->GetName());
+    hexData->SetNumberOfComponents(1);
+    hexData->SetNumberOfTuples(numHexes);
+    vtkTypeInt64* offsetData = offsets->GetPointer(0);
+    vtkTypeInt64* connectivityData = connectivity->GetPointer(0);
+    double* hexValues = hexData->GetPointer(0);
+    vtkSMPTools::For(0, numTrees, [&](vtkIdType first, vtkIdType last) {
+        for (vtkIdType treeIndex = first; treeIndex < last; ++treeIndex) {
+            vtkIdType hexId = treeStart[treeIndex];
+            for (const LeafHex& leaf : treeLeaves[treeIndex]) {
+                offsetData[hexId] = 8 * hexId;
+                for (int corner = 0; corner < 8; ++corner) {
+                    connectivityData[8 * hexId + corner] = FindNode(hash, LeafCornerKey(leaf, HexCorners[corner], maxLevel));
+                }
+                hexValues[hexId] = cellData->GetValue(leaf.globalIndex);
+                ++hexId;
+            }
+        }
+    });
+    offsetData[numHexes] = 8 * numHexes;
+
+    // Hanging nodes against the coarsest leaf around them, then flattened to free masters
+    vtkSMPThreadLocal<std::vector<HangingNode>> localHanging;
+    vtkSMPTools::For(0, numNodes, [&](vtkIdType first, vtkIdType last) {
+        std::vector<HangingNode>& hanging = localHanging.Local();
+        std::vector<NodeWeight> masters;
+        for (vtkIdType nodeId = first; nodeId < last; ++nodeId) {
+            std::uint64_t node[3];
+            for (int axis = 0; axis < 3; ++axis) {
+                node[axis] = CompactBits(nodeKeys[nodeId] >> axis);
+            }
+            if (FindHangingMasters(hyperTreeGrid, hash, node, maxLevel, cellDims, masters)) {
+                hanging.push_back(HangingNode{ nodeId, masters });
+            }
+        }
+    });
+    std::vector<HangingNode> chained;
+    for (std::vector<HangingNode>& hanging : localHanging) {
+        chained.insert(chained.end(), hanging.begin(), hanging.end());
+    }
+    std::sort(chained.begin(), chained.end(), [](const HangingNode& a, const HangingNode& b) { return a.nodeId < b.nodeId; });
+    std::vector<vtkIdType> hangingIndex(numNodes, -1);
+    for (size_t index = 0; index < chained.size(); ++index) {
+        hangingIndex[chained[index].nodeId] = static_cast<vtkIdType>(index);
+    }
+    hangingNodes.resize(chained.size());
+    vtkSMPTools::For(0, static_cast<vtkIdType>(chained.size()), [&](vtkIdType first, vtkIdType last) {
+        std::vector<NodeWeight> flattened;
+        for (vtkIdType index = first; index < last; ++index) {
+            flattened.clear();
+            FlattenMasters(chained, hangingIndex, chained[index].masters, 1.0, flattened);
+            std::sort(flattened.begin(), flattened.end(), [](const NodeWeight& a, const NodeWeight& b) { return a.nodeId < b.nodeId; });
+            HangingNode& hangingNode = hangingNodes[index];
+            hangingNode.nodeId = chained[index].nodeId;
+            hangingNode.masters.clear();
+            for (const NodeWeight& master : flattened) {
+                if (!hangingNode.masters.empty() && hangingNode.masters.back().nodeId == master.nodeId) {
+                    hangingNode.masters.back().weight += master.weight;
+                } else {
+                    hangingNode.masters.push_back(master);
+                }
+            }
+        }
+    });
+
+    vtkSmartPointer<vtkCellArray> cells = vtkSmartPointer<vtkCellArray>::New();
+    cells->SetData(offsets, connectivity);
+    vtkSmartPointer<vtkUnstructuredGrid> grid = vtkSmartPointer<vtkUnstructuredGrid>::New();
+    grid->SetPoints(points);
+    grid->SetCells(VTK_HEXAHEDRON, cells);
+    grid->GetCellData()->SetScalars(hexData);
+    return grid;
+}
+
+// Write one Abaqus *EQUATION per hanging node and displacement degree of freedom. Node labels
+// are point ids + 1, as data/9 and data/10 number the nodes of the .vtu; they no longer hold once
+// the points are welded or renumbered, which data/10 refuses for meshes marked by main.
+bool WriteHangingNodeEquations(const std::vector<HangingNode>& hangingNodes, const char* fileName) {
+    std::ofstream file(fileName);
+    if (!file) {
+        std::cerr << "Cannot open " << fileName << " for writing" << std::endl;
+        return false;
+    }
+    file.precision(17);
+    file << "*EQUATION\n";
+    for (const HangingNode& hangingNode : hangingNodes) {
+        for (int dof = 1; dof <= 3; ++dof) {
+            file << hangingNode.masters.size() + 1 << "\n";
+            file << hangingNode.nodeId + 1 << ", " << dof << ", 1.";
+            for (size_t term = 0; term < hangingNode.masters.size(); ++term) {
+                // Abaqus reads at most four terms per line
+                file << ((term + 1) % 4 == 0 ? "\n" : ", ");
+                file << hangingNode.masters[term].nodeId + 1 << ", " << dof << ", " << -hangingNode.masters[term].weight;
+            }
+            file << "\n";
+        }
+    }
+    return static_cast<bool>(file);
+}
+
+// Inclined cut through the grid: points with normal . x <= offset are kept, the normal has unit length
+struct CutPlane {
+    double normal[3];
+    double offset;
+};
+
+// Lowest and highest value of normal . x over the box of a cell
+void PlaneRange(const CutPlane& plane, const double bounds[6], double& low, double& high) {
+    low = 0.0;
+    high = 0.0;
+    for (int axis = 0; axis < 3; ++axis) {
+        double a = plane.normal[axis] * bounds[2 * axis];
+        double b = plane.normal[axis] * bounds[2 * axis + 1];
+        low += std::min(a, b);
+        high += std::max(a, b);
+    }
+}
+
+// Refine the cells the cut crosses, so the kept part ends in a graded layer of fine cells
+void RefineTowardCut(vtkHyperTreeGridNonOrientedGeometryCursor* cursor, unsigned int depth, const CutPlane& plane) {
+    if (cursor->GetLevel() >= depth) {
+        return;
+    }
+    double bounds[6];
+    cursor->GetBounds(bounds);
+    double low, high;
+    PlaneRange(plane, bounds, low, high);
+    if (low > plane.offset || high < plane.offset) {
+        return;
+    }
+    cursor->SubdivideLeaf();
+    for (unsigned char child = 0; child < cursor->GetNumberOfChildren(); ++child) {
+        cursor->ToChild(child);
+        RefineTowardCut(cursor, depth, plane);
+        cursor->ToParent();
+    }
+}
+
+// Sample the signed distance to the cut on every cell and mask the leaves entirely beyond it. The
+// unmasked leaves next to the cut are then the only fine cells, and they hang on the coarse cells
+// behind them.
+void SampleCut(vtkHyperTreeGridNonOrientedGeometryCursor* cursor, const CutPlane& plane, vtkDoubleArray* cellData,
+               vtkBitArray* mask) {
+    double bounds[6];
+    cursor->GetBounds(bounds);
+    double low, high;
+    PlaneRange(plane, bounds, low, high);
+    vtkIdType globalIndex = cursor->GetGlobalNodeIndex();
+    cellData->SetValue(globalIndex, 0.5 * (low + high) - plane.offset);
+    mask->SetValue(globalIndex, cursor->IsLeaf() && low >= plane.offset ? 1 : 0);
+    if (!cursor->IsLeaf()) {
+        for (unsigned char child = 0; child < cursor->GetNumberOfChildren(); ++child) {
+            cursor->ToChild(child);
+            SampleCut(cursor, plane, cellData, mask);
+            cursor->ToParent();
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " output.vtu constraints.inp [depth]" << std::endl;
+        return EXIT_FAILURE;
+    }
+    unsigned int depth = argc > 3 ? static_cast<unsigned int>(std::atoi(argv[3])) : 5;
+
+    // Create a uniform hyper tree grid refined along an inclined cut
+    vtkSmartPointer<vtkUniformHyperTreeGrid> hyperTreeGrid = vtkSmartPointer<vtkUniformHyperTreeGrid>::New();
+    hyperTreeGrid->SetDimensions(5, 5, 5); // 3D grid with 4x4x4 root trees
+    hyperTreeGrid->SetBranchFactor(2); // Each cell can be divided into 2x2x2 subcells
+    hyperTreeGrid->SetOrigin(0.0, 0.0, 0.0);
+    hyperTreeGrid->SetGridScale(1.0, 1.0, 1.0);
+    const double length = std::sqrt(1.0 + 0.25 + 0.49);
+    CutPlane plane = { { 1.0 / length, 0.5 / length, 0.7 / length }, 2.6 / length };
+    vtkIdType numTrees = hyperTreeGrid->GetMaxNumberOfTrees();
+    vtkSmartPointer<vtkHyperTreeGridNonOrientedGeometryCursor> cursor =
+        vtkSmartPointer<vtkHyperTreeGridNonOrientedGeometryCursor>::New();
+    vtkIdType numCells = 0;
+    for (vtkIdType treeIndex = 0; treeIndex < numTrees; ++treeIndex) {
+        hyperTreeGrid->InitializeNonOrientedGeometryCursor(cursor, treeIndex, true);
+        RefineTowardCut(cursor, depth, plane);
+        cursor->GetTree()->SetGlobalIndexStart(numCells);
+        numCells += cursor->GetTree()->GetNumberOfVertices();
+    }
+
+    // Add cell data to the grid and mask the cells beyond the cut
+    vtkSmartPointer<vtkDoubleArray> cellData = vtkSmartPointer<vtkDoubleArray>::New();
+    cellData->SetName("Distance");
+    cellData->SetNumberOfComponents(1);
+    cellData->SetNumberOfTuples(numCells);
+    vtkSmartPointer<vtkBitArray> mask = vtkSmartPointer<vtkBitArray>::New();
+    mask->SetNumberOfTuples(numCells);
+    for (vtkIdType treeIndex = 0; treeIndex < numTrees; ++treeIndex) {
+        hyperTreeGrid->InitializeNonOrientedGeometryCursor(cursor, treeIndex);
+        SampleCut(cursor, plane, cellData, mask);
+    }
+    hyperTreeGrid->GetCellData()->SetScalars(cellData);
+    hyperTreeGrid->SetMask(mask);
+
+    // Convert the leaves to hexahedra and tie the hanging nodes
+    std::vector<HangingNode> hangingNodes;
+    vtkSmartPointer<vtkUnstructuredGrid> grid = ConvertToHexMesh(hyperTreeGrid, cellData, hangingNodes);
+    if (!grid) {
+        return EXIT_FAILURE;
+    }
+    vtkIdType numUniform = numTrees << (3 * depth);
+    std::cout << grid->GetNumberOfCells() << " hexahedra (" << numUniform << " when uniform), "
+              << grid->GetNumberOfPoints() << " nodes, " << hangingNodes.size() << " hanging" << std::endl;
+
+    // Save the mesh and the constraints, marking the mesh as one whose point ids the constraints use
+    vtkSmartPointer<vtkTypeInt64Array> equations = vtkSmartPointer<vtkTypeInt64Array>::New();
+    equations->SetName("HangingNodeEquations");
+    equations->InsertNextValue(static_cast<vtkTypeInt64>(hangingNodes.size()));
+    grid->GetFieldData()->AddArray(equations);
+    vtkSmartPointer<vtkXMLUnstructuredGridWriter> writer = vtkSmartPointer<vtkXMLUnstructuredGridWriter>::New();
+    writer->SetFileName(argv[1]);
+    writer->SetInputData(grid);
+    writer->Write();
+    if (!WriteHangingNodeEquations(hangingNodes, argv[2])) {
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,685 @@
+// Linear octree: the leaves of a hyper tree grid as a Morton-sorted array of keys and levels
+// with one flat array per cell field, and benchmarks of it against cursor traversal.
+//
+// Every leaf is addressed by the Morton key of its lower corner on the finest lattice of the
+// whole grid. Root trees are aligned power-of-two blocks of that lattice, so each tree is a
+// contiguous run of the sorted leaves and every operation is a pass over flat arrays. Grids
+// are refined around a sphere to the depth given as the benchmark argument. Run with
+//     --benchmark_format=json (or --benchmark_out=results.json)
+// for machine-readable output. Every run reports leaves/s (items_per_second).
+#include <benchmark/benchmark.h>
+#include <vtkSmartPointer.h>
+#include <vtkUniformHyperTreeGrid.h>
+#include <vtkHyperTree.h>
+#include <vtkHyperTreeGridNonOrientedGeometryCursor.h>
+#include <vtkHyperTreeGridNonOrientedVonNeumannSuperCursor.h>
+#include <vtkDataArray.h>
+#include <vtkArrayDispatch.h>
+#include <vtkDataArrayRange.h>
+#include <vtkDoubleArray.h>
+#include <vtkCellData.h>
+#include <vtkSMPTools.h>
+#include <vtkSMPThreadLocal.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Offsets of the six face neighbors: -x, +x, -y, +y, -z, +z
+static const int FaceOffsets[6][3] = {
+    { -1, 0, 0 }, { 1, 0, 0 }, { 0, -1, 0 }, { 0, 1, 0 }, { 0, 0, -1 }, { 0, 0, 1 }
+};
+
+// One cell field stored as a flat array indexed like the leaves
+struct LinearField {
+    std::string name;
+    std::vector<double> values;
+};
+
+struct LinearOctree {
+    int cellDims[3];
+    unsigned int maxLevel; // Depth of the lattice the keys live on
+    double origin[3];
+    double gridScale[3];
+    std::vector<std::uint64_t> keys; // Sorted Morton keys of the lower leaf corners
+    std::vector<unsigned char> levels;
+    std::vector<LinearField> fields;
+};
+
+std::uint64_t SpreadBits(std::uint64_t value) {
+    value &= 0x1fffff;
+    value = (value | value << 32) & 0x1f00000000ffffULL;
+    value = (value | value << 16) & 0x1f0000ff0000ffULL;
+    value = (value | value << 8) & 0x100f00f00f00f00fULL;
+    value = (value | value << 4) & 0x10c30c30c30c30c3ULL;
+    value = (value | value << 2) & 0x1249249249249249ULL;
+    return value;
+}
+
+std::uint64_t CompactBits(std::uint64_t value) {
+    value &= 0x1249249249249249ULL;
+    value = (value | value >> 2) & 0x10c30c30c30c30c3ULL;
+    value = (value | value >> 4) & 0x100f00f00f00f00fULL;
+    value = (value | value >> 8) & 0x1f0000ff0000ffULL;
+    value = (value | value >> 16) & 0x1f00000000ffffULL;
+    value = (value | value >> 32) & 0x1fffff;
+    return value;
+}
+
+std::uint64_t MortonKey(const std::uint64_t ijk[3]) {
+    return SpreadBits(ijk[0]) | SpreadBits(ijk[1]) << 1 | SpreadBits(ijk[2]) << 2;
+}
+
+void DecodeMortonKey(std::uint64_t key, std::uint64_t ijk[3]) {
+    for (int axis = 0; axis < 3; ++axis) {
+        ijk[axis] = CompactBits(key >> axis);
+    }
+}
+
+// Number of finest lattice cells covered by a leaf, which is also its span of keys
+std::uint64_t KeySpan(const LinearOctree& octree, unsigned int level) {
+    return static_cast<std::uint64_t>(1) << (3 * (octree.maxLevel - level));
+}
+
+// Give an octree the grid, lattice and fields of another with room for a number of leaves
+void AllocateLeaves(const LinearOctree& layout, vtkIdType numLeaves, LinearOctree& octree) {
+    std::copy(layout.cellDims, layout.cellDims + 3, octree.cellDims);
+    octree.maxLevel = layout.maxLevel;
+    std::copy(layout.origin, layout.origin + 3, octree.origin);
+    std::copy(layout.gridScale, layout.gridScale + 3, octree.gridScale);
+    octree.keys.resize(numLeaves);
+    octree.levels.resize(numLeaves);
+    octree.fields.resize(layout.fields.size());
+    for (size_t f = 0; f < layout.fields.size(); ++f) {
+        octree.fields[f].name = layout.fields[f].name;
+        octree.fields[f].values.resize(numLeaves);
+    }
+}
+
+// Leaf containing a finest lattice cell, by binary search on the sorted keys, or -1 when the cell
+// is outside the grid
+vtkIdType FindLeaf(const LinearOctree& octree, const std::int64_t cell[3]) {
+    std::uint64_t ijk[3];
+    for (int axis = 0; axis < 3; ++axis) {
+        if (cell[axis] < 0 || cell[axis] >= (static_cast<std::int64_t>(octree.cellDims[axis]) << octree.maxLevel)) {
+            return -1;
+        }
+        ijk[axis] = static_cast<std::uint64_t>(cell[axis]);
+    }
+    std::uint64_t key = MortonKey(ijk);
+    std::vector<std::uint64_t>::const_iterator next = std::upper_bound(octree.keys.begin(), octree.keys.end(), key);
+    if (next == octree.keys.begin()) {
+        return -1;
+    }
+    vtkIdType leaf = (next - octree.keys.begin()) - 1;
+    return key - octree.keys[leaf] < KeySpan(octree, octree.levels[leaf]) ? leaf : -1;
+}
+
+// Leaf across one face of a leaf, touching the face at the leaf's lower corner
+vtkIdType FindFaceNeighbor(const LinearOctree& octree, vtkIdType leaf, int face) {
+    std::uint64_t ijk[3];
+    DecodeMortonKey(octree.keys[leaf], ijk);
+    std::int64_t size = static_cast<std::int64_t>(1) << (octree.maxLevel - octree.levels[leaf]);
+    std::int64_t cell[3];
+    for (int axis = 0; axis < 3; ++axis) {
+        int offset = FaceOffsets[face][axis];
+        cell[axis] = static_cast<std::int64_t>(ijk[axis]) + (offset > 0 ? size : offset);
+    }
+    return FindLeaf(octree, cell);
+}
+
+// Split every marked leaf into its eight children, which take the parent's place in key order
+// and inherit its field values
+void RefineLeaves(LinearOctree& octree, const std::vector<unsigned char>& refine) {
+    vtkIdType numLeaves = static_cast<vtkIdType>(octree.keys.size());
+    std::vector<vtkIdType> offsets(numLeaves + 1, 0);
+    for (vtkIdType leaf = 0; leaf < numLeaves; ++leaf) {
+        bool split = refine[leaf] && octree.levels[leaf] < octree.maxLevel;
+        offsets[leaf + 1] = offsets[leaf] + (split ? 8 : 1);
+    }
+    if (offsets[numLeaves] == numLeaves) {
+        return;
+    }
+
+    LinearOctree refined;
+    AllocateLeaves(octree, offsets[numLeaves], refined);
+    vtkSMPTools::For(0, numLeaves, [&](vtkIdType first, vtkIdType last) {
+        for (vtkIdType leaf = first; leaf < last; ++leaf) {
+            vtkIdType numChildren = offsets[leaf + 1] - offsets[leaf];
+            unsigned char level = static_cast<unsigned char>(octree.levels[leaf] + (numChildren > 1 ? 1 : 0));
+            for (vtkIdType child = 0; child < numChildren; ++child) {
+                vtkIdType position = offsets[leaf] + child;
+                refined.keys[position] = octree.keys[leaf] + static_cast<std::uint64_t>(child) * KeySpan(octree, level);
+                refined.levels[position] = level;
+                for (size_t f = 0; f < octree.fields.size(); ++f) {
+                    refined.fields[f].values[position] = octree.fields[f].values[leaf];
+                }
+            }
+        }
+    });
+    octree = std::move(refined);
+}
+
+// Merge every family of eight sibling leaves that are all marked into their parent, which takes
+// the mean of their field values. Returns the number of merged families.
+vtkIdType CoarsenLeaves(LinearOctree& octree, const std::vector<unsigned char>& coarsen) {
+    vtkIdType numLeaves = static_cast<vtkIdType>(octree.keys.size());
+
+    // A family starts at a first child and its seven siblings follow it in key order
+    std::vector<unsigned char> familyStart(numLeaves, 0);
+    vtkSMPTools::For(0, numLeaves, [&](vtkIdType first, vtkIdType last) {
+        for (vtkIdType leaf = first; leaf < last; ++leaf) {
+            unsigned int level = octree.levels[leaf];
+            if (level == 0 || leaf + 7 >= numLeaves || (octree.keys[leaf] & (8 * KeySpan(octree, level) - 1)) != 0) {
+                continue;
+            }
+            bool merge = octree.levels[leaf + 7] == level &&
+                         octree.keys[leaf + 7] == octree.keys[leaf] + 7 * KeySpan(octree, level);
+            for (vtkIdType sibling = leaf; sibling < leaf + 8 && merge; ++sibling) {
+                merge = coarsen[sibling] && octree.levels[sibling] == level;
+            }
+            familyStart[leaf] = merge;
+        }
+    });
+
+    std::vector<vtkIdType> sources;
+    sources.reserve(numLeaves);
+    vtkIdType numFamilies = 0;
+    for (vtkIdType leaf = 0; leaf < numLeaves; leaf += familyStart[leaf] ? 8 : 1) {
+        sources.push_back(leaf);
+        numFamilies += familyStart[leaf];
+    }
+    if (numFamilies == 0) {
+        return 0;
+    }
+
+    vtkIdType numMerged = static_cast<vtkIdType>(sources.size());
+    LinearOctree coarsened;
+    AllocateLeaves(octree, numMerged, coarsened);
+    vtkSMPTools::For(0, numMerged, [&](vtkIdType first, vtkIdType last) {
+        for (vtkIdType position = first; position < last; ++position) {
+            vtkIdType leaf = sources[position];
+            bool merge = familyStart[leaf] != 0;
+            coarsened.keys[position] = octree.keys[leaf];
+            coarsened.levels[position] = static_cast<unsigned char>(octree.levels[leaf] - (merge ? 1 : 0));
+            for (size_t f = 0; f < octree.fields.size(); ++f) {
+                const double* values = octree.fields[f].values.data() + leaf;
+                double value = values[0];
+                if (merge) {
+                    value = 0.0;
+                    for (int child = 0; child < 8; ++child) {
+                        value += values[child];
+                    }
+                    value /= 8.0;
+                }
+                coarsened.fields[f].values[position] = value;
+            }
+        }
+    });
+    octree = std::move(coarsened);
+    return numFamilies;
+}
+
+// Refine until no two face neighbors differ by more than one level. Each sweep finds, in
+// parallel, the leaves that are too coarse for a neighbor and splits them all at once; a split
+// can make a leaf too coarse for its own neighbors, so sweeps repeat until none is found.
+// Returns the number of sweeps that refined something.
+int BalanceLinearOctree(LinearOctree& octree) {
+    int numSweeps = 0;
+    for (;;) {
+        vtkIdType numLeaves = static_cast<vtkIdType>(octree.keys.size());
+        vtkSMPThreadLocal<std::vector<vtkIdType>> localCoarse;
+        vtkSMPTools::For(0, numLeaves, [&](vtkIdType first, vtkIdType last) {
+            std::vector<vtkIdType>& coarse = localCoarse.Local();
+            for (vtkIdType leaf = first; leaf < last; ++leaf) {
+                for (int face = 0; face < 6; ++face) {
+                    vtkIdType neighbor = FindFaceNeighbor(octree, leaf, face);
+                    if (neighbor >= 0 && octree.levels[neighbor] + 1 < octree.levels[leaf]) {
+                        coarse.push_back(neighbor);
+                    }
+                }
+            }
+        });
+        std::vector<unsigned char> refine(numLeaves, 0);
+        bool refined = false;
+        for (std::vector<vtkIdType>& coarse : localCoarse) {
+            for (vtkIdType leaf : coarse) {
+                refine[leaf] = 1;
+                refined = true;
+            }
+        }
+        if (!refined) {
+            return numSweeps;
+        }
+        RefineLeaves(octree, refine);
+        ++numSweeps;
+    }
+}
+
+// Copy a one-component cell array to doubles through its typed storage, so the trees can be
+// gathered in parallel without going through the array's shared GetTuple buffer
+struct CopyFieldWorker {
+    template <typename ArrayT>
+    void operator()(ArrayT* array, std::vector<double>& values) {
+        const auto range = vtk::DataArrayValueRange<1>(array);
+        values.resize(array->GetNumberOfTuples());
+        vtkSMPTools::For(0, array->GetNumberOfTuples(), [&](vtkIdType first, vtkIdType last) {
+            for (vtkIdType i = first; i < last; ++i) {
+                values[i] = static_cast<double>(range[i]);
+            }
+        });
+    }
+};
+
+// Gather the leaves of one tree depth first, which is Morton order since the child index holds
+// the x, y and z bits in Morton order
+void CollectTreeLeaves(vtkHyperTree* tree, vtkIdType vertexId, unsigned int level, std::uint64_t key,
+                       const LinearOctree& octree, const std::vector<std::vector<double>>& fieldValues, LinearOctree& treeLeaves) {
+    if (tree->IsLeaf(vertexId)) {
+        vtkIdType globalIndex = tree->GetGlobalIndexFromLocal(vertexId);
+        treeLeaves.keys.push_back(key);
+        treeLeaves.levels.push_back(static_cast<unsigned char>(level));
+        for (size_t f = 0; f < fieldValues.size(); ++f) {
+            treeLeaves.fields[f].values.push_back(fieldValues[f][globalIndex]);
+        }
+        return;
+    }
+    vtkIdType elder = tree->GetElderChildIndex(static_cast<unsigned int>(vertexId));
+    for (int child = 0; child < 8; ++child) {
+        CollectTreeLeaves(tree, elder + child, level + 1, key + child * KeySpan(octree, level + 1), octree, fieldValues, treeLeaves);
+    }
+}
+
+// Flatten the leaves of a grid and its one-component cell arrays into a linear octree
+LinearOctree LinearOctreeFromHyperTreeGrid(vtkUniformHyperTreeGrid* hyperTreeGrid) {
+    LinearOctree octree;
+    hyperTreeGrid->GetCellDims(octree.cellDims);
+    int maxCellDim = std::max(octree.cellDims[0], std::max(octree.cellDims[1], octree.cellDims[2]));
+    octree.maxLevel = 21;
+    while ((static_cast<std::uint64_t>(maxCellDim) << octree.maxLevel) > (static_cast<std::uint64_t>(1) << 21)) {
+        --octree.maxLevel;
+    }
+    std::copy(hyperTreeGrid->GetOrigin(), hyperTreeGrid->GetOrigin() + 3, octree.origin);
+    std::copy(hyperTreeGrid->GetGridScale(), hyperTreeGrid->GetGridScale() + 3, octree.gridScale);
+    std::vector<std::vector<double>> fieldValues;
+    vtkCellData* cellData = hyperTreeGrid->GetCellData();
+    for (int a = 0; a < cellData->GetNumberOfArrays(); ++a) {
+        vtkDataArray* array = cellData->GetArray(a);
+        if (array && array->GetNumberOfComponents() == 1) {
+            fieldValues.emplace_back();
+            CopyFieldWorker worker;
+            if (!vtkArrayDispatch::Dispatch::Execute(array, worker, fieldValues.back())) {
+                worker(array, fieldValues.back());
+            }
+            octree.fields.push_back(LinearField{ array->GetName() ? array->GetName() : "", {} });
+        }
+    }
+
+    // Trees in key order of their roots, each collected on its own
+    struct RootKey {
+        std::uint64_t key;
+        vtkIdType treeIndex;
+    };
+    std::vector<RootKey> roots;
+    for (vtkIdType treeIndex = 0; treeIndex < hyperTreeGrid->GetMaxNumberOfTrees(); ++treeIndex) {
+        if (hyperTreeGrid->GetTree(treeIndex)) {
+            unsigned int i, j, k;
+            hyperTreeGrid->GetLevelZeroCoordinatesFromIndex(treeIndex, i, j, k);
+            std::uint64_t ijk[3] = { static_cast<std::uint64_t>(i) << octree.maxLevel, static_cast<std::uint64_t>(j) << octree.maxLevel,
+                                     static_cast<std::uint64_t>(k) << octree.maxLevel };
+            roots.push_back(RootKey{ MortonKey(ijk), treeIndex });
+        }
+    }
+    std::sort(roots.begin(), roots.end(), [](const RootKey& a, const RootKey& b) { return a.key < b.key; });
+    vtkIdType numRoots = static_cast<vtkIdType>(roots.size());
+    std::vector<LinearOctree> treeLeaves(numRoots);
+    vtkSMPTools::For(0, numRoots, [&](vtkIdType first, vtkIdType last) {
+        for (vtkIdType root = first; root < last; ++root) {
+            treeLeaves[root].fields.resize(fieldValues.size());
+            CollectTreeLeaves(hyperTreeGrid->GetTree(roots[root].treeIndex), 0, 0, roots[root].key, octree, fieldValues, treeLeaves[root]);
+        }
+    });
+
+    std::vector<vtkIdType> rootStart(numRoots + 1, 0);
+    for (vtkIdType root = 0; root < numRoots; ++root) {
+        rootStart[root + 1] = rootStart[root] + static_cast<vtkIdType>(treeLeaves[root].keys.size());
+    }
+    AllocateLeaves(octree, rootStart[numRoots], octree);
+    vtkSMPTools::For(0, numRoots, [&](vtkIdType first, vtkIdType last) {
+        for (vtkIdType root = first; root < last; ++root) {
+            const LinearOctree& leaves = treeLeaves[root];
+            std::copy(leaves.keys.begin(), leaves.keys.end(), octree.keys.begin() + rootStart[root]);
+            std::copy(leaves.levels.begin(), leaves.levels.end(), octree.levels.begin() + rootStart[root]);
+            for (size_t f = 0; f < octree.fields.size(); ++f) {
+                std::copy(leaves.fields[f].values.begin(), leaves.fields[f].values.end(), octree.fields[f].values.begin() + rootStart[root]);
+            }
+        }
+    });
+    return octree;
+}
+
+// Rebuild the subtree below a vertex from the leaves starting at 'leaf', in depth first order.
+// Internal nodes take the mean of their children, as the coarsening does.
+void BuildSubtree(const LinearOctree& octree, vtkHyperTree* tree, vtkIdType vertexId, unsigned int level, vtkIdType& leaf,
+                  std::vector<std::vector<double>>& values) {
+    if (octree.levels[leaf] == level) {
+        for (size_t f = 0; f < octree.fields.size(); ++f) {
+            values[f][vertexId] = octree.fields[f].values[leaf];
+        }
+        ++leaf;
+        return;
+    }
+    tree->SubdivideLeaf(vertexId, level);
+    for (std::vector<double>& fieldValues : values) {
+        fieldValues.resize(tree->GetNumberOfVertices());
+    }
+    vtkIdType elder = tree->GetElderChildIndex(static_cast<unsigned int>(vertexId));
+    for (int child = 0; child < 8; ++child) {
+        BuildSubtree(octree, tree, elder + child, level + 1, leaf, values);
+    }
+    for (std::vector<double>& fieldValues : values) {
+        double sum = 0.0;
+        for (int child = 0; child < 8; ++child) {
+            sum += fieldValues[elder + child];
+        }
+        fieldValues[vertexId] = sum / 8.0;
+    }
+}
+
+// Build a hyper tree grid from a linear octree, one tree per run of leaves under a root
+vtkSmartPointer<vtkUniformHyperTreeGrid> HyperTreeGridFromLinearOctree(const LinearOctree& octree) {
+    vtkSmartPointer<vtkUniformHyperTreeGrid> hyperTreeGrid = vtkSmartPointer<vtkUniformHyperTreeGrid>::New();
+    hyperTreeGrid->SetDimensions(octree.cellDims[0] + 1, octree.cellDims[1] + 1, octree.cellDims[2] + 1);
+    hyperTreeGrid->SetBranchFactor(2);
+    hyperTreeGrid->SetOrigin(octree.origin[0], octree.origin[1], octree.origin[2]);
+    hyperTreeGrid->SetGridScale(octree.gridScale[0], octree.gridScale[1], octree.gridScale[2]);
+
+    // Roots start where the leaf key is aligned to a whole tree; tree creation stays serial
+    std::vector<vtkIdType> rootStart;
+    std::vector<vtkHyperTree*> trees;
+    vtkIdType numLeaves = static_cast<vtkIdType>(octree.keys.size());
+    vtkIdType leaf = 0;
+    while (leaf < numLeaves) {
+        std::uint64_t ijk[3];
+        DecodeMortonKey(octree.keys[leaf], ijk);
+        vtkIdType treeIndex;
+        hyperTreeGrid->GetIndexFromLevelZeroCoordinates(treeIndex, static_cast<unsigned int>(ijk[0] >> octree.maxLevel),
+                                                        static_cast<unsigned int>(ijk[1] >> octree.maxLevel),
+                                                        static_cast<unsigned int>(ijk[2] >> octree.maxLevel));
+        rootStart.push_back(leaf);
+        trees.push_back(hyperTreeGrid->GetTree(treeIndex, true));
+        leaf = std::lower_bound(octree.keys.begin() + leaf, octree.keys.end(), octree.keys[leaf] + KeySpan(octree, 0)) -
+               octree.keys.begin();
+    }
+    vtkIdType numRoots = static_cast<vtkIdType>(trees.size());
+    rootStart.push_back(numLeaves);
+
+    std::vector<std::vector<std::vector<double>>> treeValues(numRoots);
+    vtkSMPTools::For(0, numRoots, [&](vtkIdType first, vtkIdType last) {
+        for (vtkIdType root = first; root < last; ++root) {
+            treeValues[root].assign(octree.fields.size(), std::vector<double>(1));
+            vtkIdType leaf = rootStart[root];
+            BuildSubtree(octree, trees[root], 0, 0, leaf, treeValues[root]);
+        }
+    });
+
+    std::vector<vtkIdType> globalStart(numRoots + 1, 0);
+    for (vtkIdType root = 0; root < numRoots; ++root) {
+        globalStart[root + 1] = globalStart[root] + trees[root]->GetNumberOfVertices();
+    }
+    std::vector<vtkDoubleArray*> arrays;
+    for (const LinearField& field : octree.fields) {
+        vtkSmartPointer<vtkDoubleArray> array = vtkSmartPointer<vtkDoubleArray>::New();
+        array->SetName(field.name.c_str());
+        array->SetNumberOfComponents(1);
+        array->SetNumberOfTuples(globalStart[numRoots]);
+        hyperTreeGrid->GetCellData()->AddArray(array);
+        arrays.push_back(array);
+    }
+    vtkSMPTools::For(0, numRoots, [&](vtkIdType first, vtkIdType last) {
+        for (vtkIdType root = first; root < last; ++root) {
+            trees[root]->SetGlobalIndexStart(globalStart[root]);
+            for (size_t f = 0; f < arrays.size(); ++f) {
+                std::copy(treeValues[root][f].begin(), treeValues[root][f].end(), arrays[f]->GetPointer(globalStart[root]));
+            }
+        }
+    });
+    return hyperTreeGrid;
+}
+
+// Refine the cells crossed by a sphere and sample the distance to its surface on every cell
+void RefineTowardSphere(vtkHyperTreeGridNonOrientedGeometryCursor* cursor, unsigned int depth, const double center[3], double radius) {
+    if (cursor->GetLevel() >= depth) {
+        return;
+    }
+    double bounds[6];
+    cursor->GetBounds(bounds);
+    double nearest = 0.0;
+    double farthest = 0.0;
+    for (int axis = 0; axis < 3; ++axis) {
+        double below = center[axis] - bounds[2 * axis];
+        double above = bounds[2 * axis + 1] - center[axis];
+        double gap = std::max(0.0, std::max(-below, -above));
+        double reach = std::max(std::abs(below), std::abs(above));
+        nearest += gap * gap;
+        farthest += reach * reach;
+    }
+    if (nearest > radius * radius || farthest < radius * radius) {
+        return;
+    }
+    cursor->SubdivideLeaf();
+    for (unsigned char child = 0; child < cursor->GetNumberOfChildren(); ++child) {
+        cursor->ToChild(child);
+        RefineTowardSphere(cursor, depth, center, radius);
+        cursor->ToParent();
+    }
+}
+
+void SampleSphereDistance(vtkHyperTreeGridNonOrientedGeometryCursor* cursor, const double center[3], double radius, vtkDoubleArray* cellData) {
+    double point[3];
+    cursor->GetPoint(point);
+    double dx = point[0] - center[0];
+    double dy = point[1] - center[1];
+    double dz = point[2] - center[2];
+    cellData->SetValue(cursor->GetGlobalNodeIndex(), std::sqrt(dx * dx + dy * dy + dz * dz) - radius);
+    if (!cursor->IsLeaf()) {
+        for (unsigned char child = 0; child < cursor->GetNumberOfChildren(); ++child) {
+            cursor->ToChild(child);
+            SampleSphereDistance(cursor, center, radius, cellData);
+            cursor->ToParent();
+        }
+    }
+}
+
+// 4x4x4 root trees refined around a sphere
+vtkSmartPointer<vtkUniformHyperTreeGrid> CreateSphereGrid(unsigned int depth) {
+    vtkSmartPointer<vtkUniformHyperTreeGrid> hyperTreeGrid = vtkSmartPointer<vtkUniformHyperTreeGrid>::New();
+    hyperTreeGrid->SetDimensions(5, 5, 5);
+    hyperTreeGrid->SetBranchFactor(2);
+    hyperTreeGrid->SetOrigin(0.0, 0.0, 0.0);
+    hyperTreeGrid->SetGridScale(1.0, 1.0, 1.0);
+    double center[3] = { 2.0, 2.0, 2.0 };
+    double radius = 1.5;
+    vtkIdType numTrees = hyperTreeGrid->GetMaxNumberOfTrees();
+    vtkSmartPointer<vtkHyperTreeGridNonOrientedGeometryCursor> cursor =
+        vtkSmartPointer<vtkHyperTreeGridNonOrientedGeometryCursor>::New();
+    vtkIdType numCells = 0;
+    for (vtkIdType treeIndex = 0; treeIndex < numTrees; ++treeIndex) {
+        hyperTreeGrid->InitializeNonOrientedGeometryCursor(cursor, treeIndex, true);
+        RefineTowardSphere(cursor, depth, center, radius);
+        cursor->GetTree()->SetGlobalIndexStart(numCells);
+        numCells += cursor->GetTree()->GetNumberOfVertices();
+    }
+    vtkSmartPointer<vtkDoubleArray> cellData = vtkSmartPointer<vtkDoubleArray>::New();
+    cellData->SetName("Distance");
+    cellData->SetNumberOfComponents(1);
+    cellData->SetNumberOfTuples(numCells);
+    for (vtkIdType treeIndex = 0; treeIndex < numTrees; ++treeIndex) {
+        hyperTreeGrid->InitializeNonOrientedGeometryCursor(cursor, treeIndex);
+        SampleSphereDistance(cursor, center, radius, cellData);
+    }
+    hyperTreeGrid->GetCellData()->SetScalars(cellData);
+    return hyperTreeGrid;
+}
+
+// Volume-weighted integral of the leaf values, walked with a geometry cursor
+double IntegrateWithCursor(vtkHyperTreeGridNonOrientedGeometryCursor* cursor, vtkDoubleArray* cellData) {
+    if (cursor->IsLeaf()) {
+        double* size = cursor->GetSize();
+        return cellData->GetValue(cursor->GetGlobalNodeIndex()) * size[0] * size[1] * size[2];
+    }
+    double sum = 0.0;
+    for (unsigned char child = 0; child < cursor->GetNumberOfChildren(); ++child) {
+        cursor->ToChild(child);
+        sum += IntegrateWithCursor(cursor, cellData);
+        cursor->ToParent();
+    }
+    return sum;
+}
+
+// Face neighbors that are coarser leaves, found with a Von Neumann super cursor
+vtkIdType CountCoarserNeighborsWithCursor(vtkHyperTreeGridNonOrientedVonNeumannSuperCursor* cursor) {
+    if (!cursor->IsLeaf()) {
+        vtkIdType count = 0;
+        for (unsigned char child = 0; child < cursor->GetNumberOfChildren(); ++child) {
+            cursor->ToChild(child);
+            count += CountCoarserNeighborsWithCursor(cursor);
+            cursor->ToParent();
+        }
+        return count;
+    }
+    vtkIdType count = 0;
+    for (unsigned int neighbor = 0; neighbor < cursor->GetNumberOfCursors(); ++neighbor) {
+        if (neighbor != cursor->GetIndiceCentralCursor() && cursor->HasTree(neighbor) &&
+            cursor->GetLevel(neighbor) < cursor->GetLevel()) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+void BM_CursorIntegrate(benchmark::State& state) {
+    vtkSmartPointer<vtkUniformHyperTreeGrid> hyperTreeGrid = CreateSphereGrid(static_cast<unsigned int>(state.range(0)));
+    vtkDoubleArray* cellData = vtkDoubleArray::SafeDownCast(hyperTreeGrid->GetCellData()->GetScalars());
+    vtkSmartPointer<vtkHyperTreeGridNonOrientedGeometryCursor> cursor =
+        vtkSmartPointer<vtkHyperTreeGridNonOrientedGeometryCursor>::New();
+    for (auto _ : state) {
+        double integral = 0.0;
+        for (vtkIdType treeIndex = 0; treeIndex < hyperTreeGrid->GetMaxNumberOfTrees(); ++treeIndex) {
+            hyperTreeGrid->InitializeNonOrientedGeometryCursor(cursor, treeIndex);
+            integral += IntegrateWithCursor(cursor, cellData);
+        }
+        benchmark::DoNotOptimize(integral);
+    }
+    state.SetItemsProcessed(state.iterations() * hyperTreeGrid->GetNumberOfLeaves());
+}
+
+void BM_LinearIntegrate(benchmark::State& state) {
+    LinearOctree octree = LinearOctreeFromHyperTreeGrid(CreateSphereGrid(static_cast<unsigned int>(state.range(0))));
+    const double* values = octree.fields[0].values.data();
+    double cellVolume = octree.gridScale[0] * octree.gridScale[1] * octree.gridScale[2];
+    for (auto _ : state) {
+        double integral = 0.0;
+        for (size_t leaf = 0; leaf < octree.keys.size(); ++leaf) {
+            integral += values[leaf] * std::ldexp(cellVolume, -3 * static_cast<int>(octree.levels[leaf]));
+        }
+        benchmark::DoNotOptimize(integral);
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<vtkIdType>(octree.keys.size()));
+}
+
+void BM_CursorNeighbors(benchmark::State& state) {
+    vtkSmartPointer<vtkUniformHyperTreeGrid> hyperTreeGrid = CreateSphereGrid(static_cast<unsigned int>(state.range(0)));
+    vtkSmartPointer<vtkHyperTreeGridNonOrientedVonNeumannSuperCursor> cursor =
+        vtkSmartPointer<vtkHyperTreeGridNonOrientedVonNeumannSuperCursor>::New();
+    for (auto _ : state) {
+        vtkIdType count = 0;
+        for (vtkIdType treeIndex = 0; treeIndex < hyperTreeGrid->GetMaxNumberOfTrees(); ++treeIndex) {
+            hyperTreeGrid->InitializeNonOrientedVonNeumannSuperCursor(cursor, treeIndex);
+            count += CountCoarserNeighborsWithCursor(cursor);
+        }
+        benchmark::DoNotOptimize(count);
+    }
+    state.SetItemsProcessed(state.iterations() * hyperTreeGrid->GetNumberOfLeaves());
+}
+
+void BM_LinearNeighbors(benchmark::State& state) {
+    LinearOctree octree = LinearOctreeFromHyperTreeGrid(CreateSphereGrid(static_cast<unsigned int>(state.range(0))));
+    vtkIdType numLeaves = static_cast<vtkIdType>(octree.keys.size());
+    for (auto _ : state) {
+        vtkIdType count = 0;
+        for (vtkIdType leaf = 0; leaf < numLeaves; ++leaf) {
+            for (int face = 0; face < 6; ++face) {
+                vtkIdType neighbor = FindFaceNeighbor(octree, leaf, face);
+                count += neighbor >= 0 && octree.levels[neighbor] < octree.levels[leaf];
+            }
+        }
+        benchmark::DoNotOptimize(count);
+    }
+    state.SetItemsProcessed(state.iterations() * numLeaves);
+}
+
+// Refine every leaf outside the sphere one level, then merge the new families again
+void BM_LinearRefineCoarsen(benchmark::State& state) {
+    LinearOctree octree = LinearOctreeFromHyperTreeGrid(CreateSphereGrid(static_cast<unsigned int>(state.range(0))));
+    vtkIdType numLeaves = static_cast<vtkIdType>(octree.keys.size());
+    std::vector<unsigned char> refine(numLeaves);
+    std::vector<unsigned char> coarsen;
+    for (vtkIdType leaf = 0; leaf < numLeaves; ++leaf) {
+        refine[leaf] = octree.fields[0].values[leaf] > 0.0;
+        coarsen.insert(coarsen.end(), refine[leaf] ? 8 : 1, refine[leaf]);
+    }
+    for (auto _ : state) {
+        state.PauseTiming();
+        LinearOctree adapted = octree;
+        state.ResumeTiming();
+        RefineLeaves(adapted, refine);
+        vtkIdType numFamilies = CoarsenLeaves(adapted, coarsen);
+        benchmark::DoNotOptimize(numFamilies);
+    }
+    state.SetItemsProcessed(state.iterations() * numLeaves);
+}
+
+void BM_LinearBalance(benchmark::State& state) {
+    LinearOctree unbalanced = LinearOctreeFromHyperTreeGrid(CreateSphereGrid(static_cast<unsigned int>(state.range(0))));
+    for (auto _ : state) {
+        state.PauseTiming();
+        LinearOctree octree = unbalanced;
+        state.ResumeTiming();
+        int numSweeps = BalanceLinearOctree(octree);
+        benchmark::DoNotOptimize(numSweeps);
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<vtkIdType>(unbalanced.keys.size()));
+}
+
+void BM_ConvertFromHyperTreeGrid(benchmark::State& state) {
+    vtkSmartPointer<vtkUniformHyperTreeGrid> hyperTreeGrid = CreateSphereGrid(static_cast<unsigned int>(state.range(0)));
+    for (auto _ : state) {
+        LinearOctree octree = LinearOctreeFromHyperTreeGrid(hyperTreeGrid);
+        benchmark::DoNotOptimize(octree.keys.data());
+    }
+    state.SetItemsProcessed(state.iterations() * hyperTreeGrid->GetNumberOfLeaves());
+}
+
+void BM_ConvertToHyperTreeGrid(benchmark::State& state) {
+    LinearOctree octree = LinearOctreeFromHyperTreeGrid(CreateSphereGrid(static_cast<unsigned int>(state.range(0))));
+    for (auto _ : state) {
+        vtkSmartPointer<vtkUniformHyperTreeGrid> hyperTreeGrid = HyperTreeGridFromLinearOctree(octree);
+        benchmark::DoNotOptimize(hyperTreeGrid.Get());
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<vtkIdType>(octree.keys.size()));
+}
+
+// Depths 4 to 7, about 10^4 to 2 10^6 leaves
+BENCHMARK(BM_CursorIntegrate)->DenseRange(4, 7)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_LinearIntegrate)->DenseRange(4, 7)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_CursorNeighbors)->DenseRange(4, 7)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_LinearNeighbors)->DenseRange(4, 7)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_LinearRefineCoarsen)->DenseRange(4, 7)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_LinearBalance)->DenseRange(4, 7)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ConvertFromHyperTreeGrid)->DenseRange(4, 7)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ConvertToHyperTreeGrid)->DenseRange(4, 7)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
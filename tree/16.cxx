@@ -0,0 +1,292 @@
+#include <vtkSmartPointer.h>
+#include <vtkUniformHyperTreeGrid.h>
+#include <vtkHyperTree.h>
+#include <vtkBitArray.h>
+#include <vtkDoubleArray.h>
+#include <vtkCellData.h>
+#include <vtkImplicitFunction.h>
+#include <vtkImplicitFunctionCollection.h>
+#include <vtkImplicitBoolean.h>
+#include <vtkSphere.h>
+#include <vtkPlane.h>
+#include <vtkXMLHyperTreeGridWriter.h>
+#include <vtkSMPTools.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+// A cell of the refinement front, addressed by its tree and its coordinates inside the tree
+struct FrontCell {
+    vtkIdType treeIndex;
+    std::uint32_t ijk[3];
+};
+
+// Refinement bits and center values of every cell of one level, trees in index order and each
+// tree's cells in breadth-first order
+struct SurfaceLevel {
+    std::vector<unsigned char> refine;
+    std::vector<double> values;
+    std::vector<vtkIdType> treeStart;
+};
+
+// Conservative range of an implicit function over a box. Spheres, planes and booleans of them
+// get exact or interval-arithmetic bounds; any other function, or one with a transform, is
+// bounded from its center value with a Lipschitz constant, which must bound |grad f| on the grid.
+void EvaluateRange(vtkImplicitFunction* function, const double bounds[6], double lipschitz, double range[2]) {
+    double center[3];
+    double halfSize[3];
+    for (int axis = 0; axis < 3; ++axis) {
+        center[axis] = 0.5 * (bounds[2 * axis] + bounds[2 * axis + 1]);
+        halfSize[axis] = 0.5 * (bounds[2 * axis + 1] - bounds[2 * axis]);
+    }
+
+    if (!function->GetTransform()) {
+        if (vtkSphere* sphere = vtkSphere::SafeDownCast(function)) {
+            double sphereCenter[3];
+            sphere->GetCenter(sphereCenter);
+            double nearest = 0.0;
+            double farthest = 0.0;
+            for (int axis = 0; axis < 3; ++axis) {
+                double below = sphereCenter[axis] - bounds[2 * axis];
+                double above = bounds[2 * axis + 1] - sphereCenter[axis];
+                double gap = std::max(0.0, std::max(-below, -above));
+                double reach = std::max(std::abs(below), std::abs(above));
+                nearest += gap * gap;
+                farthest += reach * reach;
+            }
+            double radius = sphere->GetRadius();
+            range[0] = nearest - radius * radius;
+            range[1] = farthest - radius * radius;
+            return;
+        }
+        if (vtkPlane* plane = vtkPlane::SafeDownCast(function)) {
+            double normal[3];
+            double origin[3];
+            plane->GetNormal(normal);
+            plane->GetOrigin(origin);
+            double value = 0.0;
+            double spread = 0.0;
+            for (int axis = 0; axis < 3; ++axis) {
+                value += normal[axis] * (center[axis] - origin[axis]);
+                spread += std::abs(normal[axis]) * halfSize[axis];
+            }
+            range[0] = value - spread;
+            range[1] = value + spread;
+            return;
+        }
+        if (vtkImplicitBoolean* boolean = vtkImplicitBoolean::SafeDownCast(function)) {
+            int operation = boolean->GetOperationType();
+            vtkImplicitFunctionCollection* functions = boolean->GetFunction();
+            vtkCollectionSimpleIterator iterator;
+            functions->InitTraversal(iterator);
+            bool first = true;
+            while (vtkImplicitFunction* operand = functions->GetNextImplicitFunction(iterator)) {
+                double operandRange[2];
+                EvaluateRange(operand, bounds, lipschitz, operandRange);
+                if (operation == vtkImplicitBoolean::VTK_UNION_OF_MAGNITUDES) {
+                    double low = operandRange[0] > 0.0 ? operandRange[0] : operandRange[1] < 0.0 ? -operandRange[1] : 0.0;
+                    double high = std::max(std::abs(operandRange[0]), std::abs(operandRange[1]));
+                    operandRange[0] = low;
+                    operandRange[1] = high;
+                } else if (operation == vtkImplicitBoolean::VTK_DIFFERENCE && !first) {
+                    double low = -operandRange[1];
+                    operandRange[1] = -operandRange[0];
+                    operandRange[0] = low;
+                }
+                if (first) {
+                    range[0] = operandRange[0];
+                    range[1] = operandRange[1];
+                } else if (operation == vtkImplicitBoolean::VTK_UNION || operation == vtkImplicitBoolean::VTK_UNION_OF_MAGNITUDES) {
+                    range[0] = std::min(range[0], operandRange[0]);
+                    range[1] = std::min(range[1], operandRange[1]);
+                } else {
+                    range[0] = std::max(range[0], operandRange[0]);
+                    range[1] = std::max(range[1], operandRange[1]);
+                }
+                first = false;
+            }
+            if (!first) {
+                return;
+            }
+        }
+    }
+
+    double value = function->FunctionValue(center);
+    double spread = lipschitz * std::sqrt(halfSize[0] * halfSize[0] + halfSize[1] * halfSize[1] + halfSize[2] * halfSize[2]);
+    range[0] = value - spread;
+    range[1] = value + spread;
+}
+
+// Refine every cell whose range straddles zero, down to maxLevel. Levels are processed one at a
+// time over all trees: the front of a level is classified in parallel and the children of the
+// straddling cells, in order, form the next front. Only cells near the surface and their
+// siblings are ever created, and a front is released as soon as the next one exists.
+std::vector<SurfaceLevel> RefineTowardSurface(vtkUniformHyperTreeGrid* hyperTreeGrid, vtkImplicitFunction* function,
+                                              unsigned int maxLevel, double lipschitz) {
+    vtkIdType numTrees = hyperTreeGrid->GetMaxNumberOfTrees();
+    const double* origin = hyperTreeGrid->GetOrigin();
+    const double* gridScale = hyperTreeGrid->GetGridScale();
+    std::vector<FrontCell> front(numTrees);
+    for (vtkIdType treeIndex = 0; treeIndex < numTrees; ++treeIndex) {
+        front[treeIndex] = FrontCell{ treeIndex, { 0, 0, 0 } };
+    }
+
+    std::vector<SurfaceLevel> levels;
+    for (unsigned int level = 0; !front.empty(); ++level) {
+        vtkIdType numCells = static_cast<vtkIdType>(front.size());
+        levels.emplace_back();
+        SurfaceLevel& surfaceLevel = levels.back();
+        surfaceLevel.refine.resize(numCells);
+        surfaceLevel.values.resize(numCells);
+        double cellScale = std::ldexp(1.0, -static_cast<int>(level));
+        vtkSMPTools::For(0, numCells, [&](vtkIdType first, vtkIdType last) {
+            for (vtkIdType cellId = first; cellId < last; ++cellId) {
+                const FrontCell& cell = front[cellId];
+                unsigned int treeIjk[3];
+                hyperTreeGrid->GetLevelZeroCoordinatesFromIndex(cell.treeIndex, treeIjk[0], treeIjk[1], treeIjk[2]);
+                double bounds[6];
+                double center[3];
+                for (int axis = 0; axis < 3; ++axis) {
+                    bounds[2 * axis] = origin[axis] + gridScale[axis] * (treeIjk[axis] + cell.ijk[axis] * cellScale);
+                    bounds[2 * axis + 1] = bounds[2 * axis] + gridScale[axis] * cellScale;
+                    center[axis] = 0.5 * (bounds[2 * axis] + bounds[2 * axis + 1]);
+                }
+                double range[2];
+                EvaluateRange(function, bounds, lipschitz, range);
+                surfaceLevel.refine[cellId] = level < maxLevel && range[0] <= 0.0 && range[1] >= 0.0;
+                surfaceLevel.values[cellId] = function->FunctionValue(center);
+            }
+        });
+
+        surfaceLevel.treeStart.resize(numTrees + 1);
+        vtkSMPTools::For(0, numTrees + 1, [&](vtkIdType first, vtkIdType last) {
+            for (vtkIdType treeIndex = first; treeIndex < last; ++treeIndex) {
+                surfaceLevel.treeStart[treeIndex] = std::lower_bound(front.begin(), front.end(), treeIndex,
+                    [](const FrontCell& cell, vtkIdType index) { return cell.treeIndex < index; }) - front.begin();
+            }
+        });
+
+        std::vector<vtkIdType> childStart(numCells + 1, 0);
+        for (vtkIdType cellId = 0; cellId < numCells; ++cellId) {
+            childStart[cellId + 1] = childStart[cellId] + (surfaceLevel.refine[cellId] ? 8 : 0);
+        }
+        std::vector<FrontCell> next(childStart[numCells]);
+        vtkSMPTools::For(0, numCells, [&](vtkIdType first, vtkIdType last) {
+            for (vtkIdType cellId = first; cellId < last; ++cellId) {
+                if (!surfaceLevel.refine[cellId]) {
+                    continue;
+                }
+                const FrontCell& cell = front[cellId];
+                for (int child = 0; child < 8; ++child) {
+                    FrontCell& childCell = next[childStart[cellId] + child];
+                    childCell.treeIndex = cell.treeIndex;
+                    for (int axis = 0; axis < 3; ++axis) {
+                        childCell.ijk[axis] = 2 * cell.ijk[axis] + ((child >> axis) & 1);
+                    }
+                }
+            }
+        });
+        front.swap(next);
+    }
+    return levels;
+}
+
+// Build every tree from its slices of the levels: the refinement bits form the breadth-first
+// descriptor and the values are already in the vertex order it produces
+void BuildSurfaceTrees(vtkUniformHyperTreeGrid* hyperTreeGrid, const std::vector<SurfaceLevel>& levels) {
+    vtkIdType numTrees = hyperTreeGrid->GetMaxNumberOfTrees();
+    std::vector<vtkHyperTree*> trees(numTrees);
+    std::vector<vtkIdType> globalStart(numTrees + 1, 0);
+    for (vtkIdType treeIndex = 0; treeIndex < numTrees; ++treeIndex) {
+        trees[treeIndex] = hyperTreeGrid->GetTree(treeIndex, true);
+        vtkIdType numCells = 0;
+        for (const SurfaceLevel& level : levels) {
+            numCells += level.treeStart[treeIndex + 1] - level.treeStart[treeIndex];
+        }
+        globalStart[treeIndex + 1] = globalStart[treeIndex] + numCells;
+    }
+
+    vtkSmartPointer<vtkDoubleArray> cellData = vtkSmartPointer<vtkDoubleArray>::New();
+    cellData->SetName("ImplicitValue");
+    cellData->SetNumberOfComponents(1);
+    cellData->SetNumberOfTuples(globalStart[numTrees]);
+    double* values = cellData->GetPointer(0);
+
+    vtkSMPTools::For(0, numTrees, [&](vtkIdType first, vtkIdType last) {
+        vtkSmartPointer<vtkBitArray> descriptor = vtkSmartPointer<vtkBitArray>::New();
+        for (vtkIdType treeIndex = first; treeIndex < last; ++treeIndex) {
+            descriptor->SetNumberOfTuples(globalStart[treeIndex + 1] - globalStart[treeIndex]);
+            vtkIdType numBits = 0;
+            double* treeValues = values + globalStart[treeIndex];
+            for (const SurfaceLevel& level : levels) {
+                for (vtkIdType cellId = level.treeStart[treeIndex]; cellId < level.treeStart[treeIndex + 1]; ++cellId) {
+                    descriptor->SetValue(numBits, level.refine[cellId]);
+                    treeValues[numBits++] = level.values[cellId];
+                }
+            }
+            trees[treeIndex]->BuildFromBreadthFirstOrderDescriptor(descriptor, numBits);
+            trees[treeIndex]->SetGlobalIndexStart(globalStart[treeIndex]);
+        }
+    });
+    hyperTreeGrid->GetCellData()->SetScalars(cellData);
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned int depth = argc > 1 ? static_cast<unsigned int>(std::atoi(argv[1])) : 8;
+    double lipschitz = argc > 2 ? std::atof(argv[2]) : 10.0; // Only used for functions without interval bounds
+
+    // Create a uniform hyper tree grid with no cells refined yet
+    vtkSmartPointer<vtkUniformHyperTreeGrid> hyperTreeGrid = vtkSmartPointer<vtkUniformHyperTreeGrid>::New();
+    hyperTreeGrid->SetDimensions(5, 5, 5); // 3D grid with 4x4x4 root trees
+    hyperTreeGrid->SetBranchFactor(2); // Each cell can be divided into 2x2x2 subcells
+    hyperTreeGrid->SetOrigin(0.0, 0.0, 0.0);
+    hyperTreeGrid->SetGridScale(1.0, 1.0, 1.0);
+
+    // A sphere cut by a plane, joined with a smaller sphere on the cut
+    vtkSmartPointer<vtkSphere> sphere = vtkSmartPointer<vtkSphere>::New();
+    sphere->SetCenter(2.0, 2.0, 2.0);
+    sphere->SetRadius(1.5);
+    vtkSmartPointer<vtkPlane> plane = vtkSmartPointer<vtkPlane>::New();
+    plane->SetOrigin(2.0, 2.0, 2.5);
+    plane->SetNormal(0.0, 0.0, 1.0);
+    vtkSmartPointer<vtkImplicitBoolean> cut = vtkSmartPointer<vtkImplicitBoolean>::New();
+    cut->SetOperationTypeToIntersection();
+    cut->AddFunction(sphere);
+    cut->AddFunction(plane);
+    vtkSmartPointer<vtkSphere> cap = vtkSmartPointer<vtkSphere>::New();
+    cap->SetCenter(2.0, 2.0, 2.5);
+    cap->SetRadius(0.6);
+    vtkSmartPointer<vtkImplicitBoolean> shape = vtkSmartPointer<vtkImplicitBoolean>::New();
+    shape->SetOperationTypeToUnion();
+    shape->AddFunction(cut);
+    shape->AddFunction(cap);
+
+    // Refine toward the zero level set and build the trees
+    auto start = std::chrono::steady_clock::now();
+    std::vector<SurfaceLevel> levels = RefineTowardSurface(hyperTreeGrid, shape, depth, lipschitz);
+    BuildSurfaceTrees(hyperTreeGrid, levels);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    for (size_t level = 0; level < levels.size(); ++level) {
+        std::cout << "Level " << level << ": " << levels[level].refine.size() << " cells" << std::endl;
+    }
+    double numDense = std::ldexp(static_cast<double>(hyperTreeGrid->GetMaxNumberOfTrees()), 3 * static_cast<int>(depth));
+    std::cout << hyperTreeGrid->GetCellData()->GetScalars()->GetNumberOfTuples() << " cells in " << seconds
+              << " s, a dense grid of the same depth has " << numDense << std::endl;
+
+    // Save the hyper tree grid
+    if (argc > 3) {
+        vtkSmartPointer<vtkXMLHyperTreeGridWriter> writer = vtkSmartPointer<vtkXMLHyperTreeGridWriter>::New();
+        writer->SetFileName(argv[3]);
+        writer->SetInputData(hyperTreeGrid);
+        writer->Write();
+    }
+
+    return EXIT_SUCCESS;
+}
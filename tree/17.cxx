@@ -0,0 +1,694 @@
+#include <vtkSmartPointer.h>
+#include <vtkUniformHyperTreeGrid.h>
+#include <vtkHyperTree.h>
+#include <vtkBitArray.h>
+#include <vtkDoubleArray.h>
+#include <vtkCellData.h>
+#include <vtkSMPTools.h>
+#include <vtkSMPThreadLocal.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+#include "HyperTreePruning.h"
+
+// Offsets of the six face neighbors: -x, +x, -y, +y, -z, +z
+static const int FaceOffsets[6][3] = {
+    { -1, 0, 0 }, { 1, 0, 0 }, { 0, -1, 0 }, { 0, 1, 0 }, { 0, 0, -1 }, { 0, 0, 1 }
+};
+
+// A cell addressed by its level and its integer coordinates over the whole grid at that level
+struct LatticeCell {
+    unsigned int level;
+    vtkIdType ijk[3];
+};
+
+struct Droplet {
+    double center[3];
+    double radius;
+};
+
+// Droplets moving through the grid, seen through the signed distance to the nearest one. Cells store
+// an estimate of the volume fraction the droplets cover, which is exactly 0 or 1 away from the
+// interface, so only cells the interface sweeps over change value.
+struct DropletField {
+    std::vector<Droplet> droplets;
+
+    double Distance(const double point[3]) const {
+        double distance = std::numeric_limits<double>::max();
+        for (const Droplet& droplet : droplets) {
+            double dx = point[0] - droplet.center[0];
+            double dy = point[1] - droplet.center[1];
+            double dz = point[2] - droplet.center[2];
+            distance = std::min(distance, std::sqrt(dx * dx + dy * dy + dz * dz) - droplet.radius);
+        }
+        return distance;
+    }
+};
+
+// Trees of the grid with their cell values indexed by local vertex id, the cells whose value changed
+// beyond the tolerance since the last adaptation, and the families collapsed but not yet compacted
+struct IncrementalGrid {
+    vtkSmartPointer<vtkUniformHyperTreeGrid> hyperTreeGrid;
+    unsigned int treeDims[3];
+    unsigned int maxLevel;
+    double tolerance;
+    std::vector<vtkHyperTree*> trees;
+    std::vector<std::vector<double>> values;
+    std::vector<std::vector<LatticeCell>> dirty;
+    std::vector<std::vector<unsigned char>> collapsed;
+};
+
+// What one time step touched
+struct StepStatistics {
+    vtkIdType visited = 0;
+    vtkIdType dirty = 0;
+    vtkIdType collapsed = 0;
+    vtkIdType refined = 0;
+    vtkIdType balanced = 0;
+    vtkIdType rebuiltTrees = 0;
+};
+
+void CellBounds(const IncrementalGrid& grid, const LatticeCell& cell, double bounds[6]) {
+    const double* origin = grid.hyperTreeGrid->GetOrigin();
+    const double* scale = grid.hyperTreeGrid->GetGridScale();
+    double fraction = std::ldexp(1.0, -static_cast<int>(cell.level));
+    for (int axis = 0; axis < 3; ++axis) {
+        double size = scale[axis] * fraction;
+        bounds[2 * axis] = origin[axis] + cell.ijk[axis] * size;
+        bounds[2 * axis + 1] = bounds[2 * axis] + size;
+    }
+}
+
+double HalfDiagonal(const double bounds[6]) {
+    double diagonal = 0.0;
+    for (int axis = 0; axis < 3; ++axis) {
+        diagonal += (bounds[2 * axis + 1] - bounds[2 * axis]) * (bounds[2 * axis + 1] - bounds[2 * axis]);
+    }
+    return 0.5 * std::sqrt(diagonal);
+}
+
+// Volume fraction estimate from the distance at the cell center: it ramps from 1 to 0 while the
+// interface can cross the cell and is exactly 0 or 1 otherwise
+double CellFraction(const IncrementalGrid& grid, const DropletField& field, const LatticeCell& cell) {
+    double bounds[6];
+    CellBounds(grid, cell, bounds);
+    double center[3] = { 0.5 * (bounds[0] + bounds[1]), 0.5 * (bounds[2] + bounds[3]), 0.5 * (bounds[4] + bounds[5]) };
+    double fraction = 0.5 - field.Distance(center) / (2.0 * HalfDiagonal(bounds));
+    return std::min(1.0, std::max(0.0, fraction));
+}
+
+// A cell is refined while it is cut by the interface and above the finest level
+bool NeedsRefinement(const IncrementalGrid& grid, double value, unsigned int level) {
+    return level < grid.maxLevel && value > 0.0 && value < 1.0;
+}
+
+LatticeCell ChildCell(const LatticeCell& cell, unsigned int child) {
+    LatticeCell childCell = { cell.level + 1, {
+        2 * cell.ijk[0] + (child & 1), 2 * cell.ijk[1] + ((child >> 1) & 1), 2 * cell.ijk[2] + (child >> 2) } };
+    return childCell;
+}
+
+bool IsCollapsed(const IncrementalGrid& grid, vtkIdType treeIndex, vtkIdType vertexId) {
+    const std::vector<unsigned char>& flags = grid.collapsed[treeIndex];
+    return vertexId < static_cast<vtkIdType>(flags.size()) && flags[vertexId];
+}
+
+// Leaf as far as the adaptation is concerned: collapsed families count as leaves until compaction
+bool IsLeafCell(const IncrementalGrid& grid, vtkIdType treeIndex, vtkIdType vertexId) {
+    return grid.trees[treeIndex]->IsLeaf(vertexId) || IsCollapsed(grid, treeIndex, vertexId);
+}
+
+// Descend from the root tree towards a lattice cell and stop at the leaf containing it or at its level
+bool FindCell(const IncrementalGrid& grid, const LatticeCell& cell, vtkIdType& treeIndex, vtkIdType& vertexId,
+              unsigned int& level) {
+    vtkIdType treeIjk[3];
+    for (int axis = 0; axis < 3; ++axis) {
+        if (cell.ijk[axis] < 0) {
+            return false;
+        }
+        treeIjk[axis] = cell.ijk[axis] >> cell.level;
+        if (treeIjk[axis] >= static_cast<vtkIdType>(grid.treeDims[axis])) {
+            return false;
+        }
+    }
+    grid.hyperTreeGrid->GetIndexFromLevelZeroCoordinates(treeIndex, static_cast<unsigned int>(treeIjk[0]),
+        static_cast<unsigned int>(treeIjk[1]), static_cast<unsigned int>(treeIjk[2]));
+    vtkHyperTree* tree = grid.trees[treeIndex];
+
+    vertexId = 0;
+    level = 0;
+    while (level < cell.level && !IsLeafCell(grid, treeIndex, vertexId)) {
+        unsigned int shift = cell.level - level - 1;
+        unsigned int child = ((cell.ijk[0] >> shift) & 1) | (((cell.ijk[1] >> shift) & 1) << 1) | (((cell.ijk[2] >> shift) & 1) << 2);
+        vertexId = tree->GetElderChildIndex(static_cast<unsigned int>(vertexId)) + child;
+        ++level;
+    }
+    return true;
+}
+
+// Subdivide a leaf and sample the interface on the eight new children
+void SubdivideLeaf(IncrementalGrid& grid, const DropletField& field, vtkIdType treeIndex, vtkIdType vertexId,
+                   const LatticeCell& cell) {
+    vtkHyperTree* tree = grid.trees[treeIndex];
+    std::vector<double>& values = grid.values[treeIndex];
+    tree->SubdivideLeaf(vertexId, cell.level);
+    values.resize(tree->GetNumberOfVertices());
+    vtkIdType elderChild = tree->GetElderChildIndex(static_cast<unsigned int>(vertexId));
+    for (unsigned int child = 0; child < 8; ++child) {
+        values[elderChild + child] = CellFraction(grid, field, ChildCell(cell, child));
+    }
+}
+
+// Refine a leaf and its new children for as long as the interface cuts them
+void RefineLeaf(IncrementalGrid& grid, const DropletField& field, vtkIdType treeIndex, vtkIdType vertexId,
+                const LatticeCell& cell, std::vector<LatticeCell>& refined) {
+    if (!NeedsRefinement(grid, grid.values[treeIndex][vertexId], cell.level)) {
+        return;
+    }
+    SubdivideLeaf(grid, field, treeIndex, vertexId, cell);
+    refined.push_back(cell);
+    vtkIdType elderChild = grid.trees[treeIndex]->GetElderChildIndex(static_cast<unsigned int>(vertexId));
+    for (unsigned int child = 0; child < 8; ++child) {
+        RefineLeaf(grid, field, treeIndex, elderChild + child, ChildCell(cell, child), refined);
+    }
+}
+
+// -1 if the box and every cell in it lies inside the droplet with a margin of the box's half diagonal,
+// +1 if all lie outside with that margin, 0 if the droplet's surface may come close to a cell in the box
+int BoxSide(const Droplet& droplet, const double bounds[6]) {
+    double nearest = 0.0;
+    double farthest = 0.0;
+    for (int axis = 0; axis < 3; ++axis) {
+        double below = bounds[2 * axis] - droplet.center[axis];
+        double above = droplet.center[axis] - bounds[2 * axis + 1];
+        double gap = std::max(0.0, std::max(below, above));
+        double reach = std::max(std::abs(below), std::abs(above));
+        nearest += gap * gap;
+        farthest += reach * reach;
+    }
+    double halfDiagonal = HalfDiagonal(bounds);
+    if (std::sqrt(nearest) - droplet.radius >= halfDiagonal) {
+        return 1;
+    }
+    if (std::sqrt(farthest) - droplet.radius <= -halfDiagonal) {
+        return -1;
+    }
+    return 0;
+}
+
+// Whether every cell in the box keeps its value between the two fields. Only droplets that moved
+// matter: if each of them leaves the whole box on the same side with a margin both before and after,
+// every cell its surface could reach is decided by the droplets at rest, and every other cell has a
+// fraction of exactly 0 or 1 either way.
+bool IsBoxUnchanged(const DropletField& from, const DropletField& to, const double bounds[6]) {
+    for (size_t dropletId = 0; dropletId < from.droplets.size(); ++dropletId) {
+        const Droplet& before = from.droplets[dropletId];
+        const Droplet& after = to.droplets[dropletId];
+        if (before.radius == after.radius && before.center[0] == after.center[0] &&
+            before.center[1] == after.center[1] && before.center[2] == after.center[2]) {
+            continue;
+        }
+        int side = BoxSide(before, bounds);
+        if (side == 0 || side != BoxSide(after, bounds)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Resample the cells the interface can have reached while moving and record those whose value changed
+// beyond the tolerance or whose refinement decision flipped. Internal cells are resampled too, since a
+// coarse cell the interface has left must be offered for collapse even when its children no longer
+// change. Subtrees no moving droplet can have changed are skipped, so the sweep visits the band between
+// the old and the new interface rather than the whole tree. Both fields must list the same droplets in
+// the same order.
+void SweepInterface(IncrementalGrid& grid, const DropletField& from, const DropletField& to, vtkIdType treeIndex,
+                    vtkIdType vertexId, const LatticeCell& cell, vtkIdType& visited) {
+    double bounds[6];
+    CellBounds(grid, cell, bounds);
+    if (IsBoxUnchanged(from, to, bounds)) {
+        return;
+    }
+
+    ++visited;
+    double value = CellFraction(grid, to, cell);
+    double& stored = grid.values[treeIndex][vertexId];
+    if (std::abs(value - stored) > grid.tolerance ||
+        NeedsRefinement(grid, value, cell.level) != NeedsRefinement(grid, stored, cell.level)) {
+        grid.dirty[treeIndex].push_back(cell);
+    }
+    stored = value;
+
+    vtkHyperTree* tree = grid.trees[treeIndex];
+    if (!tree->IsLeaf(vertexId)) {
+        vtkIdType elderChild = tree->GetElderChildIndex(static_cast<unsigned int>(vertexId));
+        for (unsigned int child = 0; child < 8; ++child) {
+            SweepInterface(grid, from, to, treeIndex, elderChild + child, ChildCell(cell, child), visited);
+        }
+    }
+}
+
+vtkIdType AdvanceInterface(IncrementalGrid& grid, const DropletField& from, const DropletField& to,
+                           StepStatistics& statistics) {
+    vtkIdType numTrees = static_cast<vtkIdType>(grid.trees.size());
+    std::vector<vtkIdType> visitedPerTree(numTrees, 0);
+    vtkSMPTools::For(0, numTrees, [&](vtkIdType first, vtkIdType last) {
+        for (vtkIdType treeIndex = first; treeIndex < last; ++treeIndex) {
+            unsigned int treeIjk[3];
+            grid.hyperTreeGrid->GetLevelZeroCoordinatesFromIndex(treeIndex, treeIjk[0], treeIjk[1], treeIjk[2]);
+            LatticeCell root = { 0, { treeIjk[0], treeIjk[1], treeIjk[2] } };
+            SweepInterface(grid, from, to, treeIndex, 0, root, visitedPerTree[treeIndex]);
+        }
+    });
+
+    for (vtkIdType treeIndex = 0; treeIndex < numTrees; ++treeIndex) {
+        statistics.visited += visitedPerTree[treeIndex];
+        statistics.dirty += static_cast<vtkIdType>(grid.dirty[treeIndex].size());
+    }
+    return statistics.dirty;
+}
+
+// A family of leaves can be collapsed into its parent when the parent is no longer cut by the
+// interface and no face neighbor one level finer than the parent is refined, which keeps 2:1 balance
+bool CanCollapse(const IncrementalGrid& grid, const DropletField& field, const LatticeCell& cell,
+                 vtkIdType treeIndex, vtkIdType vertexId) {
+    if (NeedsRefinement(grid, CellFraction(grid, field, cell), cell.level)) {
+        return false;
+    }
+    vtkIdType elderChild = grid.trees[treeIndex]->GetElderChildIndex(static_cast<unsigned int>(vertexId));
+    for (unsigned int child = 0; child < 8; ++child) {
+        if (!IsLeafCell(grid, treeIndex, elderChild + child)) {
+            return false;
+        }
+    }
+
+    for (unsigned int child = 0; child < 8; ++child) {
+        LatticeCell childCell = ChildCell(cell, child);
+        for (const int* offset : FaceOffsets) {
+            LatticeCell adjacent = { childCell.level, {
+                childCell.ijk[0] + offset[0], childCell.ijk[1] + offset[1], childCell.ijk[2] + offset[2] } };
+            if ((adjacent.ijk[0] >> 1) == cell.ijk[0] && (adjacent.ijk[1] >> 1) == cell.ijk[1] &&
+                (adjacent.ijk[2] >> 1) == cell.ijk[2]) {
+                continue;
+            }
+            vtkIdType neighborTree;
+            vtkIdType neighborVertex;
+            unsigned int neighborLevel;
+            if (FindCell(grid, adjacent, neighborTree, neighborVertex, neighborLevel) &&
+                neighborLevel == adjacent.level && !IsLeafCell(grid, neighborTree, neighborVertex)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Rebuild a tree without its collapsed families from a pruned breadth-first descriptor, compacting its
+// values alongside. This is the only part of a step that walks the whole tree rather than the swept
+// band, so it runs only on the trees where CoarsenDirty collapsed a family.
+void CompactTree(IncrementalGrid& grid, vtkIdType treeIndex) {
+    vtkHyperTree* tree = grid.trees[treeIndex];
+    const std::vector<double>& values = grid.values[treeIndex];
+    std::vector<double> compacted;
+    vtkSmartPointer<vtkBitArray> descriptor = PruneBreadthFirst(tree, [&](const PrunedVertex& vertex) {
+        compacted.push_back(values[vertex.vertexId]);
+        return !IsLeafCell(grid, treeIndex, vertex.vertexId);
+    });
+    RebuildTree(grid.hyperTreeGrid, tree, treeIndex, descriptor);
+    grid.values[treeIndex].swap(compacted);
+    grid.collapsed[treeIndex].clear();
+}
+
+bool LatticeCellLess(const LatticeCell& a, const LatticeCell& b) {
+    return std::lexicographical_compare(a.ijk, a.ijk + 3, b.ijk, b.ijk + 3);
+}
+
+bool LatticeCellEqual(const LatticeCell& a, const LatticeCell& b) {
+    return a.ijk[0] == b.ijk[0] && a.ijk[1] == b.ijk[1] && a.ijk[2] == b.ijk[2];
+}
+
+// Collapse what the interface left behind, one level at a time from the finest. The candidates are the
+// dirty cells and their parents; a collapse at level l can in turn unblock the cells at level l - 1 around
+// it, which become the candidates of the next round, so refinement kept only for balance unwinds
+// behind the interface as well. Each round checks its candidates in parallel and marks them afterwards;
+// the trees are compacted at the end.
+vtkIdType CoarsenDirty(IncrementalGrid& grid, const DropletField& field, StepStatistics& statistics) {
+    vtkIdType numTrees = static_cast<vtkIdType>(grid.trees.size());
+    std::vector<std::vector<LatticeCell>> candidates(grid.maxLevel + 1);
+    for (vtkIdType treeIndex = 0; treeIndex < numTrees; ++treeIndex) {
+        for (const LatticeCell& cell : grid.dirty[treeIndex]) {
+            if (cell.level < grid.maxLevel) {
+                candidates[cell.level].push_back(cell);
+            }
+            if (cell.level > 0) {
+                LatticeCell parent = { cell.level - 1, { cell.ijk[0] >> 1, cell.ijk[1] >> 1, cell.ijk[2] >> 1 } };
+                candidates[parent.level].push_back(parent);
+            }
+        }
+    }
+
+    std::vector<unsigned char> touched(numTrees, 0);
+    vtkSMPThreadLocal<std::vector<LatticeCell>> localCandidates;
+    vtkIdType numCollapsed = 0;
+    for (unsigned int level = grid.maxLevel; level-- > 0;) {
+        std::vector<LatticeCell>& cells = candidates[level];
+        std::sort(cells.begin(), cells.end(), LatticeCellLess);
+        cells.erase(std::unique(cells.begin(), cells.end(), LatticeCellEqual), cells.end());
+
+        // Locate the candidates that are still refined and size their trees' flags before the checks
+        std::vector<vtkIdType> treeIndices(cells.size());
+        std::vector<vtkIdType> vertexIds(cells.size(), -1);
+        for (size_t cellId = 0; cellId < cells.size(); ++cellId) {
+            unsigned int foundLevel;
+            if (FindCell(grid, cells[cellId], treeIndices[cellId], vertexIds[cellId], foundLevel) &&
+                foundLevel == level && !IsLeafCell(grid, treeIndices[cellId], vertexIds[cellId])) {
+                std::vector<unsigned char>& flags = grid.collapsed[treeIndices[cellId]];
+                flags.resize(grid.trees[treeIndices[cellId]]->GetNumberOfVertices(), 0);
+            } else {
+                vertexIds[cellId] = -1;
+            }
+        }
+
+        std::vector<unsigned char> collapse(cells.size(), 0);
+        vtkSMPTools::For(0, static_cast<vtkIdType>(cells.size()), [&](vtkIdType first, vtkIdType last) {
+            std::vector<LatticeCell>& next = localCandidates.Local();
+            for (vtkIdType cellId = first; cellId < last; ++cellId) {
+                if (vertexIds[cellId] < 0 || !CanCollapse(grid, field, cells[cellId], treeIndices[cellId], vertexIds[cellId])) {
+                    continue;
+                }
+                collapse[cellId] = 1;
+                if (level == 0) {
+                    continue;
+                }
+                for (const int* offset : FaceOffsets) {
+                    LatticeCell around = { level - 1, {
+                        (cells[cellId].ijk[0] + offset[0]) >> 1, (cells[cellId].ijk[1] + offset[1]) >> 1,
+                        (cells[cellId].ijk[2] + offset[2]) >> 1 } };
+                    next.push_back(around);
+                }
+            }
+        });
+
+        // Mark after the checks, so that a round never reads the flags it is writing
+        for (size_t cellId = 0; cellId < cells.size(); ++cellId) {
+            if (collapse[cellId]) {
+                grid.collapsed[treeIndices[cellId]][vertexIds[cellId]] = 1;
+                grid.values[treeIndices[cellId]][vertexIds[cellId]] = CellFraction(grid, field, cells[cellId]);
+                touched[treeIndices[cellId]] = 1;
+                ++numCollapsed;
+            }
+        }
+        for (std::vector<LatticeCell>& next : localCandidates) {
+            if (level > 0) {
+                candidates[level - 1].insert(candidates[level - 1].end(), next.begin(), next.end());
+            }
+            next.clear();
+        }
+        cells.clear();
+    }
+
+    // Compact only the trees that lost cells, trees in parallel
+    std::vector<vtkIdType> rebuilt;
+    for (vtkIdType treeIndex = 0; treeIndex < numTrees; ++treeIndex) {
+        if (touched[treeIndex]) {
+            rebuilt.push_back(treeIndex);
+        } else {
+            grid.collapsed[treeIndex].clear();
+        }
+    }
+    vtkSMPTools::For(0, static_cast<vtkIdType>(rebuilt.size()), 1, [&](vtkIdType first, vtkIdType last) {
+        for (vtkIdType entry = first; entry < last; ++entry) {
+            CompactTree(grid, rebuilt[entry]);
+        }
+    });
+
+    statistics.collapsed += numCollapsed;
+    statistics.rebuiltTrees += static_cast<vtkIdType>(rebuilt.size());
+    return numCollapsed;
+}
+
+// Refine the dirty leaves the interface now cuts, each tree on one thread since a vtkHyperTree cannot
+// take concurrent SubdivideLeaf calls, and return every cell subdivided
+std::vector<LatticeCell> RefineDirty(IncrementalGrid& grid, const DropletField& field, StepStatistics& statistics) {
+    vtkIdType numTrees = static_cast<vtkIdType>(grid.trees.size());
+    std::vector<std::vector<LatticeCell>> refinedPerTree(numTrees);
+    vtkSMPTools::For(0, numTrees, 1, [&](vtkIdType first, vtkIdType last) {
+        for (vtkIdType treeIndex = first; treeIndex < last; ++treeIndex) {
+            for (const LatticeCell& cell : grid.dirty[treeIndex]) {
+                // A collapse may have merged the dirty leaf into an ancestor
+                vtkIdType foundTree;
+                vtkIdType vertexId;
+                unsigned int level;
+                FindCell(grid, cell, foundTree, vertexId, level);
+                if (!grid.trees[treeIndex]->IsLeaf(vertexId)) {
+                    continue;
+                }
+                unsigned int shift = cell.level - level;
+                LatticeCell leaf = { level, { cell.ijk[0] >> shift, cell.ijk[1] >> shift, cell.ijk[2] >> shift } };
+                RefineLeaf(grid, field, treeIndex, vertexId, leaf, refinedPerTree[treeIndex]);
+            }
+        }
+    });
+
+    std::vector<LatticeCell> refined;
+    for (std::vector<LatticeCell>& local : refinedPerTree) {
+        refined.insert(refined.end(), local.begin(), local.end());
+    }
+    statistics.refined += static_cast<vtkIdType>(refined.size());
+    return refined;
+}
+
+// Restore 2:1 face balance around the cells just subdivided. Every subdivision at level l requires the
+// six face neighbors at level l; the worklist ripple is the one of the global balancer, but it is
+// seeded from the subdivided cells instead of a scan of all leaves.
+vtkIdType BalanceAround(IncrementalGrid& grid, const DropletField& field, const std::vector<LatticeCell>& refined,
+                        StepStatistics& statistics) {
+    std::vector<LatticeCell> worklist;
+    auto requireNeighbors = [&](const LatticeCell& cell) {
+        for (const int* offset : FaceOffsets) {
+            LatticeCell adjacent = { cell.level, {
+                cell.ijk[0] + offset[0], cell.ijk[1] + offset[1], cell.ijk[2] + offset[2] } };
+            vtkIdType neighborTree;
+            vtkIdType neighborVertex;
+            unsigned int neighborLevel;
+            if (FindCell(grid, adjacent, neighborTree, neighborVertex, neighborLevel) && neighborLevel < adjacent.level) {
+                worklist.push_back(adjacent);
+            }
+        }
+    };
+    for (const LatticeCell& cell : refined) {
+        requireNeighbors(cell);
+    }
+
+    vtkIdType numRefined = 0;
+    while (!worklist.empty()) {
+        LatticeCell required = worklist.back();
+        worklist.pop_back();
+
+        vtkIdType treeIndex;
+        vtkIdType vertexId;
+        unsigned int level;
+        if (!FindCell(grid, required, treeIndex, vertexId, level)) {
+            continue;
+        }
+        vtkHyperTree* tree = grid.trees[treeIndex];
+        while (level < required.level) {
+            unsigned int shift = required.level - level;
+            LatticeCell leaf = { level, {
+                required.ijk[0] >> shift, required.ijk[1] >> shift, required.ijk[2] >> shift } };
+            SubdivideLeaf(grid, field, treeIndex, vertexId, leaf);
+            requireNeighbors(leaf);
+            ++numRefined;
+
+            // Continue into the child on the way to the required cell
+            --shift;
+            unsigned int child = ((required.ijk[0] >> shift) & 1) | (((required.ijk[1] >> shift) & 1) << 1) |
+                (((required.ijk[2] >> shift) & 1) << 2);
+            vertexId = tree->GetElderChildIndex(static_cast<unsigned int>(vertexId)) + child;
+            ++level;
+        }
+    }
+    statistics.balanced += numRefined;
+    return numRefined;
+}
+
+// Re-adapt the grid around the dirty cells only: coarsen behind the interface, refine in front of it
+// and rebalance the cells that changed, then forget the dirty set
+void AdaptDirty(IncrementalGrid& grid, const DropletField& field, StepStatistics& statistics) {
+    CoarsenDirty(grid, field, statistics);
+    std::vector<LatticeCell> refined = RefineDirty(grid, field, statistics);
+    BalanceAround(grid, field, refined, statistics);
+    for (std::vector<LatticeCell>& dirty : grid.dirty) {
+        dirty.clear();
+    }
+}
+
+// Create the root trees and adapt them to the droplets: with every root dirty, the incremental
+// adaptation is the full one
+void InitializeIncrementalGrid(IncrementalGrid& grid, const DropletField& field, StepStatistics& statistics) {
+    vtkIdType numTrees = grid.hyperTreeGrid->GetMaxNumberOfTrees();
+    grid.trees.resize(numTrees);
+    grid.values.resize(numTrees);
+    grid.dirty.resize(numTrees);
+    grid.collapsed.resize(numTrees);
+
+    // Creating a tree inserts it into the grid, so that part stays serial
+    for (vtkIdType treeIndex = 0; treeIndex < numTrees; ++treeIndex) {
+        grid.trees[treeIndex] = grid.hyperTreeGrid->GetTree(treeIndex, true);
+        unsigned int treeIjk[3];
+        grid.hyperTreeGrid->GetLevelZeroCoordinatesFromIndex(treeIndex, treeIjk[0], treeIjk[1], treeIjk[2]);
+        LatticeCell root = { 0, { treeIjk[0], treeIjk[1], treeIjk[2] } };
+        grid.values[treeIndex].assign(1, CellFraction(grid, field, root));
+        grid.dirty[treeIndex].assign(1, root);
+    }
+    AdaptDirty(grid, field, statistics);
+}
+
+void CreateGrid(IncrementalGrid& grid, unsigned int maxLevel) {
+    grid.hyperTreeGrid = vtkSmartPointer<vtkUniformHyperTreeGrid>::New();
+    grid.hyperTreeGrid->SetDimensions(9, 9, 9); // 3D grid with 8x8x8 root trees
+    grid.hyperTreeGrid->SetBranchFactor(2); // Each cell can be divided into 2x2x2 subcells
+    grid.hyperTreeGrid->SetOrigin(0.0, 0.0, 0.0);
+    grid.hyperTreeGrid->SetGridScale(1.0, 1.0, 1.0);
+    for (int axis = 0; axis < 3; ++axis) {
+        grid.treeDims[axis] = 8;
+    }
+    grid.maxLevel = maxLevel;
+    grid.tolerance = 1e-3;
+}
+
+vtkIdType CountCells(const IncrementalGrid& grid) {
+    vtkIdType numCells = 0;
+    for (vtkHyperTree* tree : grid.trees) {
+        numCells += tree->GetNumberOfVertices();
+    }
+    return numCells;
+}
+
+// Refinement bits of a tree in breadth-first order, reading collapsed families as leaves, so two
+// trees with the same cells give the same descriptor whatever their vertex layout
+std::vector<unsigned char> GetTreeDescriptor(const IncrementalGrid& grid, vtkIdType treeIndex) {
+    std::vector<unsigned char> descriptor;
+    std::vector<vtkIdType> levelVertices(1, 0);
+    std::vector<vtkIdType> nextVertices;
+    while (!levelVertices.empty()) {
+        nextVertices.clear();
+        for (vtkIdType vertexId : levelVertices) {
+            bool refined = !IsLeafCell(grid, treeIndex, vertexId);
+            descriptor.push_back(refined ? 1 : 0);
+            if (refined) {
+                vtkIdType elderChild = grid.trees[treeIndex]->GetElderChildIndex(static_cast<unsigned int>(vertexId));
+                for (unsigned int child = 0; child < 8; ++child) {
+                    nextVertices.push_back(elderChild + child);
+                }
+            }
+        }
+        levelVertices.swap(nextVertices);
+    }
+    return descriptor;
+}
+
+// Number of trees whose cells differ between two grids over the same root trees
+vtkIdType CountMismatchedTrees(const IncrementalGrid& grid, const IncrementalGrid& reference) {
+    vtkIdType numTrees = static_cast<vtkIdType>(grid.trees.size());
+    std::vector<unsigned char> mismatched(numTrees, 0);
+    vtkSMPTools::For(0, numTrees, [&](vtkIdType first, vtkIdType last) {
+        for (vtkIdType treeIndex = first; treeIndex < last; ++treeIndex) {
+            mismatched[treeIndex] = GetTreeDescriptor(grid, treeIndex) != GetTreeDescriptor(reference, treeIndex);
+        }
+    });
+    return std::count(mismatched.begin(), mismatched.end(), 1);
+}
+
+// Give each tree a contiguous run of global indices and gather the values into the grid's cell data
+void FinalizeCellData(IncrementalGrid& grid, const char* name) {
+    vtkIdType numTrees = static_cast<vtkIdType>(grid.trees.size());
+    std::vector<vtkIdType> globalStart(numTrees + 1, 0);
+    for (vtkIdType treeIndex = 0; treeIndex < numTrees; ++treeIndex) {
+        globalStart[treeIndex + 1] = globalStart[treeIndex] + grid.trees[treeIndex]->GetNumberOfVertices();
+    }
+
+    vtkSmartPointer<vtkDoubleArray> cellData = vtkSmartPointer<vtkDoubleArray>::New();
+    cellData->SetName(name);
+    cellData->SetNumberOfComponents(1);
+    cellData->SetNumberOfTuples(globalStart[numTrees]);
+    double* cellValues = cellData->GetPointer(0);
+    vtkSMPTools::For(0, numTrees, [&](vtkIdType first, vtkIdType last) {
+        for (vtkIdType treeIndex = first; treeIndex < last; ++treeIndex) {
+            grid.trees[treeIndex]->SetGlobalIndexStart(globalStart[treeIndex]);
+            std::copy(grid.values[treeIndex].begin(), grid.values[treeIndex].end(), cellValues + globalStart[treeIndex]);
+        }
+    });
+    grid.hyperTreeGrid->GetCellData()->SetScalars(cellData);
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned int maxLevel = argc > 1 ? static_cast<unsigned int>(std::atoi(argv[1])) : 5;
+    int numSteps = argc > 2 ? std::atoi(argv[2]) : 10;
+    double stepLength = argc > 3 ? std::atof(argv[3]) : 0.02;
+
+    // Six droplets at rest and one moving along x between them
+    DropletField field;
+    const double centers[7][3] = {
+        { 2.5, 4.0, 4.0 }, { 6.0, 2.0, 2.0 }, { 6.0, 6.0, 2.0 }, { 6.0, 2.0, 6.0 }, { 6.0, 6.0, 6.0 },
+        { 2.0, 2.0, 6.0 }, { 2.0, 6.0, 2.0 }
+    };
+    for (const double* center : centers) {
+        field.droplets.push_back(Droplet{ { center[0], center[1], center[2] }, 1.2 });
+    }
+
+    // Create a uniform hyper tree grid adapted to the droplets at their starting positions
+    IncrementalGrid grid;
+    CreateGrid(grid, maxLevel);
+    StepStatistics initial;
+    auto start = std::chrono::steady_clock::now();
+    InitializeIncrementalGrid(grid, field, initial);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Initial adaptation: " << CountCells(grid) << " cells, " << initial.refined << " refined, "
+              << initial.balanced << " refined for balance in " << seconds << " s" << std::endl;
+
+    // Move the first droplet and re-adapt only where its interface went
+    for (int step = 1; step <= numSteps; ++step) {
+        DropletField moved = field;
+        moved.droplets[0].center[0] += stepLength;
+        StepStatistics statistics;
+        start = std::chrono::steady_clock::now();
+        AdvanceInterface(grid, field, moved, statistics);
+        AdaptDirty(grid, moved, statistics);
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        field = moved;
+        std::cout << "Step " << step << ": " << statistics.visited << " cells resampled, " << statistics.dirty
+                  << " dirty, " << statistics.collapsed << " collapsed, " << statistics.refined << " refined, "
+                  << statistics.balanced << " refined for balance, " << statistics.rebuiltTrees
+                  << " trees rebuilt, " << CountCells(grid) << " cells in " << seconds << " s" << std::endl;
+    }
+
+    // Compare with adapting a fresh grid to the final positions
+    IncrementalGrid reference;
+    CreateGrid(reference, maxLevel);
+    StepStatistics full;
+    start = std::chrono::steady_clock::now();
+    InitializeIncrementalGrid(reference, field, full);
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Full adaptation at the final positions: " << CountCells(reference) << " cells in " << seconds
+              << " s" << std::endl;
+    vtkIdType numMismatched = CountMismatchedTrees(grid, reference);
+    if (numMismatched > 0) {
+        std::cerr << numMismatched << " trees differ from the full adaptation" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // Add cell data to the grid
+    FinalizeCellData(grid, "VolumeFraction");
+
+    // The grid now follows the moving droplet. Any further processing can be done here.
+
+    return EXIT_SUCCESS;
+}
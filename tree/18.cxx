@@ -0,0 +1,641 @@
+#include <vtkSmartPointer.h>
+#include <vtkUniformHyperTreeGrid.h>
+#include <vtkHyperTree.h>
+#include <vtkHyperTreeGridNonOrientedCursor.h>
+#include <vtkBitArray.h>
+#include <vtkDoubleArray.h>
+#include <vtkCellData.h>
+#include <vtkSMPTools.h>
+#include <vtkSMPThreadLocal.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+#include "HyperTreePruning.h"
+
+// Offsets of the six face neighbors: -x, +x, -y, +y, -z, +z
+static const int FaceOffsets[6][3] = {
+    { -1, 0, 0 }, { 1, 0, 0 }, { 0, -1, 0 }, { 0, 1, 0 }, { 0, 0, -1 }, { 0, 0, 1 }
+};
+
+// One level of the traversal stack: a vertex, its level, its coordinates at that level inside its
+// tree and the next child to visit
+struct TraversalFrame {
+    vtkIdType vertexId;
+    unsigned int level;
+    unsigned int nextChild;
+    unsigned int ijk[3];
+};
+
+// Explicit depth-first stack over raw vtkHyperTree storage. It is sized once for the deepest level a
+// walk may reach and reused for every tree and every walk, so traversal itself allocates nothing.
+struct TreeWalker {
+    std::vector<TraversalFrame> stack;
+};
+
+void InitializeTreeWalker(TreeWalker& walker, unsigned int maxLevel) {
+    walker.stack.resize(maxLevel + 1);
+}
+
+// Walk one tree depth first without recursion. The visitor is a template parameter, so its hooks are
+// resolved at compile time and inline into the loop:
+//   bool Enter(vtkHyperTree* tree, const TraversalFrame& frame)
+//       pre-order; returning true descends into the children. Enter may subdivide the leaf it is
+//       given, so refinement and the walk over the new children happen in the same pass.
+//   void Leave(vtkHyperTree* tree, const TraversalFrame& frame)
+//       post-order, for every cell the walk descended into
+//
+// WalkSubtree starts from any cell of the tree; the stack then has to hold the levels below it.
+template <typename VisitorT>
+void WalkSubtree(TreeWalker& walker, vtkHyperTree* tree, const TraversalFrame& root, VisitorT& visitor) {
+    TraversalFrame* stack = walker.stack.data();
+    stack[0] = root;
+    stack[0].nextChild = 0;
+    if (!visitor.Enter(tree, stack[0]) || tree->IsLeaf(stack[0].vertexId)) {
+        return;
+    }
+
+    size_t top = 0;
+    for (;;) {
+        TraversalFrame& frame = stack[top];
+        if (frame.nextChild == 8) {
+            visitor.Leave(tree, frame);
+            if (top == 0) {
+                return;
+            }
+            --top;
+            continue;
+        }
+        unsigned int child = frame.nextChild++;
+        TraversalFrame& next = stack[top + 1];
+        next.vertexId = tree->GetElderChildIndex(static_cast<unsigned int>(frame.vertexId)) + child;
+        next.level = frame.level + 1;
+        next.nextChild = 0;
+        next.ijk[0] = 2 * frame.ijk[0] + (child & 1);
+        next.ijk[1] = 2 * frame.ijk[1] + ((child >> 1) & 1);
+        next.ijk[2] = 2 * frame.ijk[2] + (child >> 2);
+        if (visitor.Enter(tree, next) && !tree->IsLeaf(next.vertexId)) {
+            ++top;
+        }
+    }
+}
+
+template <typename VisitorT>
+void WalkTree(TreeWalker& walker, vtkHyperTree* tree, VisitorT& visitor) {
+    TraversalFrame root = { 0, 0, 0, { 0, 0, 0 } };
+    WalkSubtree(walker, tree, root, visitor);
+}
+
+// A cell addressed by its level and its integer coordinates over the whole grid at that level
+struct LatticeCell {
+    unsigned int level;
+    vtkIdType ijk[3];
+};
+
+// Trees of the grid with their cell values indexed by local vertex id while they are being adapted
+struct TraversalGrid {
+    vtkSmartPointer<vtkUniformHyperTreeGrid> hyperTreeGrid;
+    unsigned int treeDims[3];
+    std::vector<vtkHyperTree*> trees;
+    std::vector<std::vector<unsigned int>> treeIjk;
+    std::vector<std::vector<double>> values;
+    std::vector<std::vector<unsigned char>> collapsed;
+};
+
+// The lattice cell of a traversal frame of a tree
+LatticeCell GridCell(const TraversalGrid& grid, vtkIdType treeIndex, const TraversalFrame& frame) {
+    LatticeCell cell = { frame.level, { 0, 0, 0 } };
+    for (int axis = 0; axis < 3; ++axis) {
+        cell.ijk[axis] = (static_cast<vtkIdType>(grid.treeIjk[treeIndex][axis]) << frame.level) + frame.ijk[axis];
+    }
+    return cell;
+}
+
+// A smooth bump, high at its center and flat far from it
+double SampleField(const double point[3]) {
+    double dx = point[0] - 1.6;
+    double dy = point[1] - 2.2;
+    double dz = point[2] - 2.0;
+    return 10.0 * std::exp(-2.0 * (dx * dx + dy * dy + dz * dz));
+}
+
+void CellCenter(const TraversalGrid& grid, vtkIdType treeIndex, const TraversalFrame& frame, double center[3]) {
+    const double* origin = grid.hyperTreeGrid->GetOrigin();
+    const double* scale = grid.hyperTreeGrid->GetGridScale();
+    double fraction = std::ldexp(1.0, -static_cast<int>(frame.level));
+    for (int axis = 0; axis < 3; ++axis) {
+        center[axis] = origin[axis] + (grid.treeIjk[treeIndex][axis] + (frame.ijk[axis] + 0.5) * fraction) * scale[axis];
+    }
+}
+
+// Subdivide every leaf whose value exceeds the threshold, down to the given level, and sample the field
+// on the new children. The subdivided cells are recorded when a list is given, to seed the balancer.
+struct RefineVisitor {
+    const TraversalGrid* grid;
+    std::vector<double>* values;
+    vtkIdType treeIndex;
+    double threshold;
+    unsigned int maxLevel;
+    vtkIdType numRefined;
+    std::vector<LatticeCell>* subdivided;
+
+    bool Enter(vtkHyperTree* tree, const TraversalFrame& frame) {
+        if (!tree->IsLeaf(frame.vertexId)) {
+            return true;
+        }
+        if (frame.level >= maxLevel || (*values)[frame.vertexId] <= threshold) {
+            return false;
+        }
+        tree->SubdivideLeaf(frame.vertexId, frame.level);
+        values->resize(tree->GetNumberOfVertices());
+        double* cellValues = values->data();
+        vtkIdType elderChild = tree->GetElderChildIndex(static_cast<unsigned int>(frame.vertexId));
+        for (unsigned int child = 0; child < 8; ++child) {
+            TraversalFrame childFrame = { elderChild + child, frame.level + 1, 0, {
+                2 * frame.ijk[0] + (child & 1), 2 * frame.ijk[1] + ((child >> 1) & 1), 2 * frame.ijk[2] + (child >> 2) } };
+            double center[3];
+            CellCenter(*grid, treeIndex, childFrame, center);
+            cellValues[elderChild + child] = SampleField(center);
+        }
+        if (subdivided) {
+            subdivided->push_back(GridCell(*grid, treeIndex, frame));
+        }
+        ++numRefined;
+        return true;
+    }
+
+    void Leave(vtkHyperTree*, const TraversalFrame&) {}
+};
+
+// Mark, bottom-up in a single walk, every family of leaves whose values agree within the tolerance;
+// the parent takes their mean. Families marked below count as leaves for the cells above them. Every
+// marked parent is recorded, so that the balancer can look around the leaves it leaves behind.
+struct CoarsenVisitor {
+    const TraversalGrid* grid;
+    vtkIdType treeIndex;
+    std::vector<double>* values;
+    std::vector<unsigned char>* collapsed;
+    double tolerance;
+    vtkIdType numCollapsed;
+    std::vector<LatticeCell>* collapsedCells;
+
+    bool Enter(vtkHyperTree* tree, const TraversalFrame& frame) {
+        return !tree->IsLeaf(frame.vertexId);
+    }
+
+    void Leave(vtkHyperTree* tree, const TraversalFrame& frame) {
+        const double* cellValues = values->data();
+        const unsigned char* flags = collapsed->data();
+        vtkIdType elderChild = tree->GetElderChildIndex(static_cast<unsigned int>(frame.vertexId));
+        double low = std::numeric_limits<double>::max();
+        double high = std::numeric_limits<double>::lowest();
+        double sum = 0.0;
+        for (unsigned int child = 0; child < 8; ++child) {
+            vtkIdType childId = elderChild + child;
+            if (!tree->IsLeaf(childId) && !flags[childId]) {
+                return;
+            }
+            low = std::min(low, cellValues[childId]);
+            high = std::max(high, cellValues[childId]);
+            sum += cellValues[childId];
+        }
+        if (high - low > tolerance) {
+            return;
+        }
+        (*collapsed)[frame.vertexId] = 1;
+        (*values)[frame.vertexId] = sum / 8.0;
+        collapsedCells->push_back(GridCell(*grid, treeIndex, frame));
+        ++numCollapsed;
+    }
+};
+
+// Descend from the root tree towards a lattice cell and stop at the leaf containing it or at its level
+bool FindCell(const TraversalGrid& grid, const LatticeCell& cell, vtkIdType& treeIndex, vtkIdType& vertexId,
+              unsigned int& level) {
+    vtkIdType treeIjk[3];
+    for (int axis = 0; axis < 3; ++axis) {
+        if (cell.ijk[axis] < 0) {
+            return false;
+        }
+        treeIjk[axis] = cell.ijk[axis] >> cell.level;
+        if (treeIjk[axis] >= static_cast<vtkIdType>(grid.treeDims[axis])) {
+            return false;
+        }
+    }
+    grid.hyperTreeGrid->GetIndexFromLevelZeroCoordinates(treeIndex, static_cast<unsigned int>(treeIjk[0]),
+        static_cast<unsigned int>(treeIjk[1]), static_cast<unsigned int>(treeIjk[2]));
+    vtkHyperTree* tree = grid.trees[treeIndex];
+
+    vertexId = 0;
+    level = 0;
+    while (level < cell.level && !tree->IsLeaf(vertexId)) {
+        unsigned int shift = cell.level - level - 1;
+        unsigned int child = ((cell.ijk[0] >> shift) & 1) | (((cell.ijk[1] >> shift) & 1) << 1) | (((cell.ijk[2] >> shift) & 1) << 2);
+        vertexId = tree->GetElderChildIndex(static_cast<unsigned int>(vertexId)) + child;
+        ++level;
+    }
+    return true;
+}
+
+// Queue the face neighbors at its level that a subdivided cell requires: its children are one level
+// finer, so every neighbor leaf coarser than the cell itself breaks the balance
+void RequireNeighbors(const TraversalGrid& grid, const LatticeCell& cell, std::vector<LatticeCell>& worklist) {
+    for (const int* offset : FaceOffsets) {
+        LatticeCell adjacent = { cell.level, {
+            cell.ijk[0] + offset[0], cell.ijk[1] + offset[1], cell.ijk[2] + offset[2] } };
+        vtkIdType neighborTree;
+        vtkIdType neighborVertex;
+        unsigned int neighborLevel;
+        if (FindCell(grid, adjacent, neighborTree, neighborVertex, neighborLevel) && neighborLevel < adjacent.level) {
+            worklist.push_back(adjacent);
+        }
+    }
+}
+
+// Walk the cells of a neighbor subtree that touch one face of a coarse leaf. For every leaf there more
+// than one level finer, queue the cell one level above it on the coarse side, which has to exist.
+struct FaceScanVisitor {
+    const TraversalGrid* grid;
+    vtkIdType treeIndex;
+    LatticeCell coarse;
+    const int* offset;
+    std::vector<LatticeCell>* required;
+
+    bool Enter(vtkHyperTree* tree, const TraversalFrame& frame) {
+        unsigned int depth = frame.level - coarse.level;
+        LatticeCell cell = GridCell(*grid, treeIndex, frame);
+        for (int axis = 0; axis < 3; ++axis) {
+            if (offset[axis] > 0 && cell.ijk[axis] != (coarse.ijk[axis] + 1) << depth) {
+                return false;
+            }
+            if (offset[axis] < 0 && cell.ijk[axis] != (coarse.ijk[axis] << depth) - 1) {
+                return false;
+            }
+        }
+        if (!tree->IsLeaf(frame.vertexId)) {
+            return true;
+        }
+        if (depth >= 2) {
+            required->push_back(LatticeCell{ frame.level - 1, {
+                (cell.ijk[0] - offset[0]) >> 1, (cell.ijk[1] - offset[1]) >> 1, (cell.ijk[2] - offset[2]) >> 1 } });
+        }
+        return false;
+    }
+
+    void Leave(vtkHyperTree*, const TraversalFrame&) {}
+};
+
+// Sum of the leaf values weighted by their volume relative to a root cell, read through a typed raw
+// pointer to the tree's slice of the cell array
+template <typename ValueT>
+struct IntegrateVisitor {
+    const ValueT* values;
+    double sum;
+
+    bool Enter(vtkHyperTree* tree, const TraversalFrame& frame) {
+        if (!tree->IsLeaf(frame.vertexId)) {
+            return true;
+        }
+        sum += std::ldexp(static_cast<double>(values[frame.vertexId]), -3 * static_cast<int>(frame.level));
+        return false;
+    }
+
+    void Leave(vtkHyperTree*, const TraversalFrame&) {}
+};
+
+void InitializeTraversalGrid(TraversalGrid& grid) {
+    vtkIdType numTrees = grid.hyperTreeGrid->GetMaxNumberOfTrees();
+    grid.trees.resize(numTrees);
+    grid.treeIjk.resize(numTrees);
+    grid.values.resize(numTrees);
+    grid.collapsed.resize(numTrees);
+
+    // Creating a tree inserts it into the grid, so that part stays serial
+    for (vtkIdType treeIndex = 0; treeIndex < numTrees; ++treeIndex) {
+        grid.trees[treeIndex] = grid.hyperTreeGrid->GetTree(treeIndex, true);
+        grid.treeIjk[treeIndex].resize(3);
+        grid.hyperTreeGrid->GetLevelZeroCoordinatesFromIndex(treeIndex, grid.treeIjk[treeIndex][0],
+            grid.treeIjk[treeIndex][1], grid.treeIjk[treeIndex][2]);
+        TraversalFrame root = { 0, 0, 0, { 0, 0, 0 } };
+        double center[3];
+        CellCenter(grid, treeIndex, root, center);
+        grid.values[treeIndex].assign(1, SampleField(center));
+    }
+}
+
+// Gather the lists each thread filled into one
+void GatherCells(vtkSMPThreadLocal<std::vector<LatticeCell>>& localCells, std::vector<LatticeCell>& cells) {
+    for (std::vector<LatticeCell>& local : localCells) {
+        cells.insert(cells.end(), local.begin(), local.end());
+        local.clear();
+    }
+}
+
+// Refine every tree, each on one thread with that thread's walker. The subdivided cells are appended to
+// 'subdivided' when it is given.
+vtkIdType RefineTrees(TraversalGrid& grid, vtkSMPThreadLocal<TreeWalker>& walkers, double threshold,
+                      unsigned int maxLevel, std::vector<LatticeCell>* subdivided) {
+    vtkIdType numTrees = static_cast<vtkIdType>(grid.trees.size());
+    std::vector<vtkIdType> refinedPerTree(numTrees, 0);
+    vtkSMPThreadLocal<std::vector<LatticeCell>> localSubdivided;
+    vtkSMPTools::For(0, numTrees, 1, [&](vtkIdType first, vtkIdType last) {
+        TreeWalker& walker = walkers.Local();
+        std::vector<LatticeCell>* cells = subdivided ? &localSubdivided.Local() : nullptr;
+        for (vtkIdType treeIndex = first; treeIndex < last; ++treeIndex) {
+            RefineVisitor visitor = { &grid, &grid.values[treeIndex], treeIndex, threshold, maxLevel, 0, cells };
+            WalkTree(walker, grid.trees[treeIndex], visitor);
+            refinedPerTree[treeIndex] = visitor.numRefined;
+        }
+    });
+    if (subdivided) {
+        GatherCells(localSubdivided, *subdivided);
+    }
+
+    vtkIdType numRefined = 0;
+    for (vtkIdType refined : refinedPerTree) {
+        numRefined += refined;
+    }
+    return numRefined;
+}
+
+// Drop the families the coarsen visitor flagged: the tree is rebuilt from a breadth-first descriptor
+// in which they are leaves, and the values are compacted in the same order
+void CompactTree(TraversalGrid& grid, vtkIdType treeIndex) {
+    vtkHyperTree* tree = grid.trees[treeIndex];
+    const std::vector<double>& values = grid.values[treeIndex];
+    const std::vector<unsigned char>& flags = grid.collapsed[treeIndex];
+    std::vector<double> compacted;
+    vtkSmartPointer<vtkBitArray> descriptor = PruneBreadthFirst(tree, [&](const PrunedVertex& vertex) {
+        compacted.push_back(values[vertex.vertexId]);
+        return !flags[vertex.vertexId];
+    });
+    RebuildTree(grid.hyperTreeGrid, tree, treeIndex, descriptor);
+    grid.values[treeIndex].swap(compacted);
+}
+
+// Coarsen every tree where the field is flat, trees in parallel, and compact those that lost cells. The
+// collapsed cells are appended to 'collapsed'.
+vtkIdType CoarsenTrees(TraversalGrid& grid, vtkSMPThreadLocal<TreeWalker>& walkers, double tolerance,
+                       std::vector<LatticeCell>& collapsed) {
+    vtkIdType numTrees = static_cast<vtkIdType>(grid.trees.size());
+    std::vector<vtkIdType> collapsedPerTree(numTrees, 0);
+    vtkSMPThreadLocal<std::vector<LatticeCell>> localCollapsed;
+    vtkSMPTools::For(0, numTrees, 1, [&](vtkIdType first, vtkIdType last) {
+        TreeWalker& walker = walkers.Local();
+        std::vector<LatticeCell>& cells = localCollapsed.Local();
+        for (vtkIdType treeIndex = first; treeIndex < last; ++treeIndex) {
+            std::vector<unsigned char>& flags = grid.collapsed[treeIndex];
+            flags.assign(grid.trees[treeIndex]->GetNumberOfVertices(), 0);
+            CoarsenVisitor visitor = { &grid, treeIndex, &grid.values[treeIndex], &flags, tolerance, 0, &cells };
+            WalkTree(walker, grid.trees[treeIndex], visitor);
+            if (visitor.numCollapsed > 0) {
+                CompactTree(grid, treeIndex);
+            }
+            flags.clear();
+            collapsedPerTree[treeIndex] = visitor.numCollapsed;
+        }
+    });
+    GatherCells(localCollapsed, collapsed);
+
+    vtkIdType numCollapsed = 0;
+    for (vtkIdType count : collapsedPerTree) {
+        numCollapsed += count;
+    }
+    return numCollapsed;
+}
+
+// The traversal frame of a cell of a tree, given its lattice coordinates over the whole grid
+TraversalFrame TreeFrame(const TraversalGrid& grid, vtkIdType treeIndex, vtkIdType vertexId, unsigned int level,
+                         const vtkIdType ijk[3]) {
+    TraversalFrame frame = { vertexId, level, 0, { 0, 0, 0 } };
+    for (int axis = 0; axis < 3; ++axis) {
+        frame.ijk[axis] = static_cast<unsigned int>(ijk[axis] - (static_cast<vtkIdType>(grid.treeIjk[treeIndex][axis]) << level));
+    }
+    return frame;
+}
+
+// Look across the faces of a collapsed cell that is still a leaf, and queue the cells the finer leaves
+// beyond it require on its side. A cell collapsed inside a larger family is no longer in the tree and is
+// skipped; its ancestor was recorded too.
+void RequireAcrossFaces(const TraversalGrid& grid, TreeWalker& walker, const LatticeCell& coarse,
+                        std::vector<LatticeCell>& required) {
+    vtkIdType treeIndex;
+    vtkIdType vertexId;
+    unsigned int level;
+    if (!FindCell(grid, coarse, treeIndex, vertexId, level) || level != coarse.level ||
+        !grid.trees[treeIndex]->IsLeaf(vertexId)) {
+        return;
+    }
+    for (const int* offset : FaceOffsets) {
+        LatticeCell adjacent = { coarse.level, {
+            coarse.ijk[0] + offset[0], coarse.ijk[1] + offset[1], coarse.ijk[2] + offset[2] } };
+        vtkIdType neighborTree;
+        vtkIdType neighborVertex;
+        unsigned int neighborLevel;
+        if (!FindCell(grid, adjacent, neighborTree, neighborVertex, neighborLevel) || neighborLevel != adjacent.level ||
+            grid.trees[neighborTree]->IsLeaf(neighborVertex)) {
+            continue;
+        }
+        FaceScanVisitor visitor = { &grid, neighborTree, coarse, offset, &required };
+        WalkSubtree(walker, grid.trees[neighborTree],
+            TreeFrame(grid, neighborTree, neighborVertex, neighborLevel, adjacent.ijk), visitor);
+    }
+}
+
+// Enforce 2:1 face balance around the cells that just changed, on a grid that was balanced before. The
+// worklist holds cells that must exist, as in tree/9: it is seeded in parallel from the neighbors each
+// subdivided cell requires and from the finer leaves across each collapsed one, and reaching a required
+// cell subdivides the leaf covering it and queues what those subdivisions require in turn. Collapsed
+// cells have to be passed before anything refines them again. The cells a balance subdivision creates
+// are walked with the refinement criterion as well, so the grid still refines every cell above the
+// threshold.
+vtkIdType BalanceGrid(TraversalGrid& grid, vtkSMPThreadLocal<TreeWalker>& walkers, double threshold,
+                      unsigned int maxLevel, const std::vector<LatticeCell>& subdivided,
+                      const std::vector<LatticeCell>& collapsed) {
+    vtkSMPThreadLocal<std::vector<LatticeCell>> localRequired;
+    vtkSMPTools::For(0, static_cast<vtkIdType>(subdivided.size()), [&](vtkIdType first, vtkIdType last) {
+        std::vector<LatticeCell>& required = localRequired.Local();
+        for (vtkIdType i = first; i < last; ++i) {
+            RequireNeighbors(grid, subdivided[i], required);
+        }
+    });
+    vtkSMPTools::For(0, static_cast<vtkIdType>(collapsed.size()), [&](vtkIdType first, vtkIdType last) {
+        TreeWalker& walker = walkers.Local();
+        std::vector<LatticeCell>& required = localRequired.Local();
+        for (vtkIdType i = first; i < last; ++i) {
+            RequireAcrossFaces(grid, walker, collapsed[i], required);
+        }
+    });
+    std::vector<LatticeCell> worklist;
+    GatherCells(localRequired, worklist);
+
+    TreeWalker& walker = walkers.Local();
+    std::vector<LatticeCell> created;
+    vtkIdType numRefined = 0;
+    while (!worklist.empty()) {
+        LatticeCell cell = worklist.back();
+        worklist.pop_back();
+        vtkIdType treeIndex;
+        vtkIdType vertexId;
+        unsigned int level;
+        if (!FindCell(grid, cell, treeIndex, vertexId, level) || level == cell.level) {
+            continue;
+        }
+
+        // Subdivide along the path down to the required cell
+        vtkHyperTree* tree = grid.trees[treeIndex];
+        vtkIdType top[3] = { cell.ijk[0] >> (cell.level - level), cell.ijk[1] >> (cell.level - level),
+            cell.ijk[2] >> (cell.level - level) };
+        TraversalFrame topFrame = TreeFrame(grid, treeIndex, vertexId, level, top);
+        RefineVisitor forced = { &grid, &grid.values[treeIndex], treeIndex,
+            std::numeric_limits<double>::lowest(), cell.level, 0, &created };
+        while (level < cell.level) {
+            unsigned int shift = cell.level - level;
+            vtkIdType ijk[3] = { cell.ijk[0] >> shift, cell.ijk[1] >> shift, cell.ijk[2] >> shift };
+            forced.Enter(tree, TreeFrame(grid, treeIndex, vertexId, level, ijk));
+
+            --shift;
+            unsigned int child = ((cell.ijk[0] >> shift) & 1) | (((cell.ijk[1] >> shift) & 1) << 1) |
+                (((cell.ijk[2] >> shift) & 1) << 2);
+            vertexId = tree->GetElderChildIndex(static_cast<unsigned int>(vertexId)) + child;
+            ++level;
+        }
+
+        // Then refine the new cells like any other, and queue what every subdivision requires
+        RefineVisitor refine = { &grid, &grid.values[treeIndex], treeIndex, threshold, maxLevel, 0, &created };
+        WalkSubtree(walker, tree, topFrame, refine);
+        for (const LatticeCell& subdividedCell : created) {
+            RequireNeighbors(grid, subdividedCell, worklist);
+        }
+        created.clear();
+        numRefined += forced.numRefined + refine.numRefined;
+    }
+    return numRefined;
+}
+
+// Give each tree a contiguous run of global indices and gather the values into the grid's cell data
+vtkSmartPointer<vtkDoubleArray> FinalizeCellData(TraversalGrid& grid, const char* name) {
+    vtkIdType numTrees = static_cast<vtkIdType>(grid.trees.size());
+    std::vector<vtkIdType> globalStart(numTrees + 1, 0);
+    for (vtkIdType treeIndex = 0; treeIndex < numTrees; ++treeIndex) {
+        globalStart[treeIndex + 1] = globalStart[treeIndex] + grid.trees[treeIndex]->GetNumberOfVertices();
+    }
+
+    vtkSmartPointer<vtkDoubleArray> cellData = vtkSmartPointer<vtkDoubleArray>::New();
+    cellData->SetName(name);
+    cellData->SetNumberOfComponents(1);
+    cellData->SetNumberOfTuples(globalStart[numTrees]);
+    double* cellValues = cellData->GetPointer(0);
+    vtkSMPTools::For(0, numTrees, [&](vtkIdType first, vtkIdType last) {
+        for (vtkIdType treeIndex = first; treeIndex < last; ++treeIndex) {
+            grid.trees[treeIndex]->SetGlobalIndexStart(globalStart[treeIndex]);
+            std::copy(grid.values[treeIndex].begin(), grid.values[treeIndex].end(), cellValues + globalStart[treeIndex]);
+        }
+    });
+    grid.hyperTreeGrid->GetCellData()->SetScalars(cellData);
+    return cellData;
+}
+
+// Integrate the leaves through the walker. Each tree's slice of the array is bound once as a typed
+// pointer, which relies on the trees being numbered with SetGlobalIndexStart.
+template <typename ArrayT>
+double IntegrateLeaves(TraversalGrid& grid, TreeWalker& walker, ArrayT* array) {
+    double sum = 0.0;
+    for (vtkHyperTree* tree : grid.trees) {
+        IntegrateVisitor<typename ArrayT::ValueType> visitor = { array->GetPointer(tree->GetGlobalIndexFromLocal(0)), 0.0 };
+        WalkTree(walker, tree, visitor);
+        sum += visitor.sum;
+    }
+    return sum;
+}
+
+// The same integral through a recursive cursor walk reading values through the cell data
+double IntegrateWithCursor(vtkSmartPointer<vtkHyperTreeGridNonOrientedCursor> cursor, vtkHyperTreeGrid* hyperTreeGrid) {
+    if (cursor->IsLeaf()) {
+        double value = hyperTreeGrid->GetCellData()->GetScalars()->GetTuple1(cursor->GetGlobalNodeIndex());
+        return std::ldexp(value, -3 * static_cast<int>(cursor->GetLevel()));
+    }
+    double sum = 0.0;
+    for (unsigned int child = 0; child < cursor->GetNumberOfChildren(); ++child) {
+        cursor->ToChild(child);
+        sum += IntegrateWithCursor(cursor, hyperTreeGrid);
+        cursor->ToParent();
+    }
+    return sum;
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned int maxLevel = argc > 1 ? static_cast<unsigned int>(std::atoi(argv[1])) : 6;
+    int numRepeats = argc > 2 ? std::atoi(argv[2]) : 20;
+
+    // Create a uniform hyper tree grid
+    TraversalGrid grid;
+    grid.hyperTreeGrid = vtkSmartPointer<vtkUniformHyperTreeGrid>::New();
+    grid.hyperTreeGrid->SetDimensions(5, 5, 5); // 3D grid with 4x4x4 root trees
+    grid.hyperTreeGrid->SetBranchFactor(2); // Each cell can be divided into 2x2x2 subcells
+    grid.hyperTreeGrid->SetOrigin(0.0, 0.0, 0.0);
+    grid.hyperTreeGrid->SetGridScale(1.0, 1.0, 1.0);
+    for (int axis = 0; axis < 3; ++axis) {
+        grid.treeDims[axis] = 4;
+    }
+    InitializeTraversalGrid(grid);
+
+    // One walker per thread for every pass below, each sized once for the deepest level a pass reaches
+    TreeWalker exemplar;
+    InitializeTreeWalker(exemplar, std::max(grid.hyperTreeGrid->GetNumberOfLevels() - 1, maxLevel));
+    vtkSMPThreadLocal<TreeWalker> walkers(exemplar);
+
+    // Refine uniformly, then coarsen where the field is flat and rebalance around the collapsed cells
+    double refinementThreshold = 5.0; // Example threshold for refining
+    std::vector<LatticeCell> collapsed;
+    vtkIdType numRefined = RefineTrees(grid, walkers, std::numeric_limits<double>::lowest(), 4, nullptr);
+    vtkIdType numCollapsed = CoarsenTrees(grid, walkers, 1e-2, collapsed);
+    vtkIdType numBalanced = BalanceGrid(grid, walkers, refinementThreshold, maxLevel, std::vector<LatticeCell>(), collapsed);
+    std::cout << numRefined << " cells refined uniformly, " << numCollapsed << " collapsed, " << numBalanced
+              << " refined for balance" << std::endl;
+
+    // Refine based on criteria, then ensure 2:1 balance around the subdivided cells
+    std::vector<LatticeCell> subdivided;
+    numRefined = RefineTrees(grid, walkers, refinementThreshold, maxLevel, &subdivided);
+    numBalanced = BalanceGrid(grid, walkers, refinementThreshold, maxLevel, subdivided, std::vector<LatticeCell>());
+    std::cout << numRefined << " cells refined above the threshold, " << numBalanced << " for balance" << std::endl;
+
+    // Add cell data to the grid
+    vtkSmartPointer<vtkDoubleArray> cellData = FinalizeCellData(grid, "CellData");
+    std::cout << cellData->GetNumberOfTuples() << " cells" << std::endl;
+
+    // Compare a read-only pass through the walker with the same pass through cursors
+    TreeWalker walker;
+    InitializeTreeWalker(walker, grid.hyperTreeGrid->GetNumberOfLevels() - 1);
+    double walkerSum = 0.0;
+    auto start = std::chrono::steady_clock::now();
+    for (int repeat = 0; repeat < numRepeats; ++repeat) {
+        walkerSum = IntegrateLeaves(grid, walker, cellData.GetPointer());
+    }
+    double walkerSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / numRepeats;
+
+    vtkSmartPointer<vtkHyperTreeGridNonOrientedCursor> cursor =
+        vtkSmartPointer<vtkHyperTreeGridNonOrientedCursor>::New();
+    double cursorSum = 0.0;
+    start = std::chrono::steady_clock::now();
+    for (int repeat = 0; repeat < numRepeats; ++repeat) {
+        cursorSum = 0.0;
+        for (vtkIdType treeIndex = 0; treeIndex < static_cast<vtkIdType>(grid.trees.size()); ++treeIndex) {
+            grid.hyperTreeGrid->InitializeNonOrientedCursor(cursor, treeIndex);
+            cursorSum += IntegrateWithCursor(cursor, grid.hyperTreeGrid);
+        }
+    }
+    double cursorSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / numRepeats;
+    std::cout << "Leaf integral " << walkerSum << " in " << walkerSeconds << " s with the walker, " << cursorSum
+              << " in " << cursorSeconds << " s with cursors" << std::endl;
+
+    // The grid is now coarsened, refined, balanced, and cell data is added. Any further processing can be done here.
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,270 @@
+#include <vtkSmartPointer.h>
+#include <vtkImageData.h>
+#include <vtkXMLImageDataReader.h>
+#include <vtkUniformHyperTreeGrid.h>
+#include <vtkHyperTree.h>
+#include <vtkBitArray.h>
+#include <vtkDoubleArray.h>
+#include <vtkPointData.h>
+#include <vtkCellData.h>
+#include <vtkDataArrayRange.h>
+#include <vtkSMPTools.h>
+#include <vtkSMPThreadLocal.h>
+#include <vtkXMLHyperTreeGridWriter.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Dense volume holding one value per voxel, x fastest
+struct DenseVolume {
+    vtkDataArray* values;
+    int dims[3];
+};
+
+// Min, max and mean of every node of one root tree, indexed by [level][i + n * (j + n * k)]
+struct TreePyramid {
+    std::vector<std::vector<double>> minimum;
+    std::vector<std::vector<double>> maximum;
+    std::vector<std::vector<double>> mean;
+};
+
+// Breadth-first descriptor bits and cell values of one root tree
+struct TreeBlock {
+    vtkSmartPointer<vtkBitArray> descriptor;
+    std::vector<double> values;
+};
+
+void AllocateTreePyramid(TreePyramid& pyramid, int depth) {
+    if (static_cast<int>(pyramid.mean.size()) == depth + 1) {
+        return;
+    }
+    pyramid.minimum.resize(depth + 1);
+    pyramid.maximum.resize(depth + 1);
+    pyramid.mean.resize(depth + 1);
+    for (int level = 0; level <= depth; ++level) {
+        size_t side = size_t(1) << level;
+        pyramid.minimum[level].resize(side * side * side);
+        pyramid.maximum[level].resize(side * side * side);
+        pyramid.mean[level].resize(side * side * side);
+    }
+}
+
+// Sample the voxels covered by one root tree and reduce them level by level up to the root.
+// Voxels past the edge of the volume replicate the nearest boundary voxel.
+void BuildTreePyramid(const DenseVolume& volume, const unsigned int treeIjk[3], int depth, TreePyramid& pyramid) {
+    auto values = vtk::DataArrayValueRange(volume.values);
+    int numComponents = volume.values->GetNumberOfComponents();
+
+    // Finest level reads the volume directly
+    int side = 1 << depth;
+    std::vector<double>& finest = pyramid.mean[depth];
+    for (int k = 0; k < side; ++k) {
+        vtkIdType z = std::min<vtkIdType>(static_cast<vtkIdType>(treeIjk[2]) * side + k, volume.dims[2] - 1);
+        for (int j = 0; j < side; ++j) {
+            vtkIdType y = std::min<vtkIdType>(static_cast<vtkIdType>(treeIjk[1]) * side + j, volume.dims[1] - 1);
+            vtkIdType row = (z * volume.dims[1] + y) * volume.dims[0];
+            for (int i = 0; i < side; ++i) {
+                vtkIdType x = std::min<vtkIdType>(static_cast<vtkIdType>(treeIjk[0]) * side + i, volume.dims[0] - 1);
+                finest[i + side * (j + static_cast<size_t>(side) * k)] = values[(row + x) * numComponents];
+            }
+        }
+    }
+    std::copy(finest.begin(), finest.end(), pyramid.minimum[depth].begin());
+    std::copy(finest.begin(), finest.end(), pyramid.maximum[depth].begin());
+
+    // Each coarser node reduces its 2x2x2 children
+    for (int level = depth - 1; level >= 0; --level) {
+        int parentSide = 1 << level;
+        int childSide = parentSide * 2;
+        const std::vector<double>& childMin = pyramid.minimum[level + 1];
+        const std::vector<double>& childMax = pyramid.maximum[level + 1];
+        const std::vector<double>& childMean = pyramid.mean[level + 1];
+        for (int k = 0; k < parentSide; ++k) {
+            for (int j = 0; j < parentSide; ++j) {
+                for (int i = 0; i < parentSide; ++i) {
+                    size_t parent = i + parentSide * (j + static_cast<size_t>(parentSide) * k);
+                    double minimum = childMin[(2 * i) + childSide * ((2 * j) + static_cast<size_t>(childSide) * (2 * k))];
+                    double maximum = minimum;
+                    double sum = 0.0;
+                    for (int child = 0; child < 8; ++child) {
+                        size_t index = (2 * i + (child & 1)) +
+                            childSide * ((2 * j + ((child >> 1) & 1)) + static_cast<size_t>(childSide) * (2 * k + (child >> 2)));
+                        minimum = std::min(minimum, childMin[index]);
+                        maximum = std::max(maximum, childMax[index]);
+                        sum += childMean[index];
+                    }
+                    pyramid.minimum[level][parent] = minimum;
+                    pyramid.maximum[level][parent] = maximum;
+                    pyramid.mean[level][parent] = sum / 8.0;
+                }
+            }
+        }
+    }
+}
+
+// Walk the pyramid breadth-first from the root, emitting the refinement bit and the value of each
+// vertex in the order BuildFromBreadthFirstOrderDescriptor numbers them. A node whose value range
+// stays within the tolerance is a merged leaf; everything below it is dropped.
+void EmitTreeBlock(const TreePyramid& pyramid, int depth, double tolerance, TreeBlock& block) {
+    block.descriptor = vtkSmartPointer<vtkBitArray>::New();
+    block.values.clear();
+
+    std::vector<size_t> levelNodes(1, 0);
+    std::vector<size_t> nextNodes;
+    for (int level = 0; level <= depth && !levelNodes.empty(); ++level) {
+        int side = 1 << level;
+        nextNodes.clear();
+        for (size_t node : levelNodes) {
+            block.values.push_back(pyramid.mean[level][node]);
+            if (level == depth) {
+                continue;
+            }
+
+            bool refine = pyramid.maximum[level][node] - pyramid.minimum[level][node] > tolerance;
+            block.descriptor->InsertNextValue(refine ? 1 : 0);
+            if (refine) {
+                size_t i = node % side;
+                size_t j = (node / side) % side;
+                size_t k = node / (static_cast<size_t>(side) * side);
+                size_t childSide = 2 * static_cast<size_t>(side);
+                for (int child = 0; child < 8; ++child) {
+                    nextNodes.push_back((2 * i + (child & 1)) +
+                        childSide * ((2 * j + ((child >> 1) & 1)) + childSide * (2 * k + (child >> 2))));
+                }
+            }
+        }
+        levelNodes.swap(nextNodes);
+    }
+}
+
+bool BuildHyperTreeGridFromVolume(vtkSmartPointer<vtkImageData> image, int depth, double tolerance,
+                                  vtkSmartPointer<vtkUniformHyperTreeGrid> hyperTreeGrid) {
+    // Voxel values come from the point scalars (as written by data/), or the cell scalars otherwise
+    DenseVolume volume;
+    image->GetDimensions(volume.dims);
+    double origin[3];
+    double spacing[3];
+    image->GetOrigin(origin);
+    image->GetSpacing(spacing);
+    double voxelOffset = 0.5;
+    volume.values = image->GetPointData()->GetScalars();
+    if (!volume.values) {
+        volume.values = image->GetCellData()->GetScalars();
+        for (int axis = 0; axis < 3; ++axis) {
+            volume.dims[axis] = std::max(volume.dims[axis] - 1, 1);
+        }
+        voxelOffset = 0.0;
+    }
+    if (!volume.values) {
+        std::cerr << "Volume has no point or cell scalars" << std::endl;
+        return false;
+    }
+
+    // One root tree per (2^depth)^3 block of voxels
+    int blockSize = 1 << depth;
+    int treeDims[3];
+    for (int axis = 0; axis < 3; ++axis) {
+        treeDims[axis] = (volume.dims[axis] + blockSize - 1) / blockSize;
+    }
+    hyperTreeGrid->Initialize();
+    hyperTreeGrid->SetBranchFactor(2);
+    hyperTreeGrid->SetDimensions(treeDims[0] + 1, treeDims[1] + 1, treeDims[2] + 1);
+    hyperTreeGrid->SetOrigin(origin[0] - voxelOffset * spacing[0],
+                             origin[1] - voxelOffset * spacing[1],
+                             origin[2] - voxelOffset * spacing[2]);
+    hyperTreeGrid->SetGridScale(spacing[0] * blockSize, spacing[1] * blockSize, spacing[2] * blockSize);
+    vtkIdType numTrees = static_cast<vtkIdType>(treeDims[0]) * treeDims[1] * treeDims[2];
+
+    // Build every root tree bottom-up in parallel, each thread reusing one pyramid
+    std::vector<TreeBlock> blocks(numTrees);
+    vtkSMPThreadLocal<TreePyramid> pyramids;
+    vtkSMPTools::For(0, numTrees, 1, [&](vtkIdType first, vtkIdType last) {
+        TreePyramid& pyramid = pyramids.Local();
+        AllocateTreePyramid(pyramid, depth);
+        for (vtkIdType treeIndex = first; treeIndex < last; ++treeIndex) {
+            unsigned int treeIjk[3];
+            hyperTreeGrid->GetLevelZeroCoordinatesFromIndex(treeIndex, treeIjk[0], treeIjk[1], treeIjk[2]);
+            BuildTreePyramid(volume, treeIjk, depth, pyramid);
+            EmitTreeBlock(pyramid, depth, tolerance, blocks[treeIndex]);
+        }
+    });
+
+    // Global indices follow tree order, so every tree owns a contiguous run of the cell array
+    std::vector<vtkIdType> globalStart(numTrees + 1, 0);
+    for (vtkIdType treeIndex = 0; treeIndex < numTrees; ++treeIndex) {
+        globalStart[treeIndex + 1] = globalStart[treeIndex] + static_cast<vtkIdType>(blocks[treeIndex].values.size());
+    }
+
+    vtkSmartPointer<vtkDoubleArray> cellData = vtkSmartPointer<vtkDoubleArray>::New();
+    cellData->SetName(volume.values->GetName() ? volume.values->GetName() : "CellData");
+    cellData->SetNumberOfComponents(1);
+    cellData->SetNumberOfTuples(globalStart[numTrees]);
+
+    // Creating a tree inserts it into the grid, so that part stays serial
+    std::vector<vtkHyperTree*> trees(numTrees);
+    for (vtkIdType treeIndex = 0; treeIndex < numTrees; ++treeIndex) {
+        trees[treeIndex] = hyperTreeGrid->GetTree(treeIndex, true);
+    }
+
+    // Fill the trees and their slices of the cell array in parallel
+    double* cellValues = cellData->GetPointer(0);
+    vtkSMPTools::For(0, numTrees, [&](vtkIdType first, vtkIdType last) {
+        for (vtkIdType treeIndex = first; treeIndex < last; ++treeIndex) {
+            TreeBlock& block = blocks[treeIndex];
+            trees[treeIndex]->BuildFromBreadthFirstOrderDescriptor(block.descriptor, block.descriptor->GetNumberOfTuples());
+            trees[treeIndex]->SetGlobalIndexStart(globalStart[treeIndex]);
+            std::copy(block.values.begin(), block.values.end(), cellValues + globalStart[treeIndex]);
+            block = TreeBlock();
+        }
+    });
+
+    hyperTreeGrid->GetCellData()->SetScalars(cellData);
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " input.vti output.htg [depth] [tolerance]" << std::endl;
+        return EXIT_FAILURE;
+    }
+    int depth = argc > 3 ? std::atoi(argv[3]) : 4; // Each root tree covers 16x16x16 voxels by default
+    double tolerance = argc > 4 ? std::atof(argv[4]) : 0.0; // Labels only merge when identical
+    if (depth < 0 || depth > 10) {
+        std::cerr << "Depth must be between 0 and 10" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // Read the dense volume
+    vtkSmartPointer<vtkXMLImageDataReader> reader = vtkSmartPointer<vtkXMLImageDataReader>::New();
+    reader->SetFileName(argv[1]);
+    reader->Update();
+    vtkSmartPointer<vtkImageData> image = reader->GetOutput();
+
+    // Build the hyper tree grid bottom-up
+    vtkSmartPointer<vtkUniformHyperTreeGrid> hyperTreeGrid = vtkSmartPointer<vtkUniformHyperTreeGrid>::New();
+    if (!BuildHyperTreeGridFromVolume(image, depth, tolerance, hyperTreeGrid)) {
+        return EXIT_FAILURE;
+    }
+
+    vtkIdType numVoxels = static_cast<vtkIdType>(image->GetNumberOfPoints());
+    vtkIdType numLeaves = 0;
+    vtkIdType numTrees = hyperTreeGrid->GetMaxNumberOfTrees();
+    for (vtkIdType treeIndex = 0; treeIndex < numTrees; ++treeIndex) {
+        numLeaves += hyperTreeGrid->GetTree(treeIndex)->GetNumberOfLeaves();
+    }
+    std::cout << numVoxels << " voxels -> " << numTrees << " trees, "
+              << hyperTreeGrid->GetCellData()->GetScalars()->GetNumberOfTuples() << " cells, "
+              << numLeaves << " leaves" << std::endl;
+
+    // Save the hyper tree grid
+    vtkSmartPointer<vtkXMLHyperTreeGridWriter> writer = vtkSmartPointer<vtkXMLHyperTreeGridWriter>::New();
+    writer->SetFileName(argv[2]);
+    writer->SetInputData(hyperTreeGrid);
+    writer->Write();
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,298 @@
+#include <vtkSmartPointer.h>
+#include <vtkUniformHyperTreeGrid.h>
+#include <vtkHyperTree.h>
+#include <vtkHyperTreeGridNonOrientedCursor.h>
+#include <vtkBitArray.h>
+#include <vtkDoubleArray.h>
+#include <vtkCellData.h>
+#include <vtkSMPTools.h>
+#include <vtkSMPThreadLocalObject.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "HyperTreePruning.h"
+
+// A leaf waiting for a refinement decision, with its lattice coordinates at its own level inside the tree
+struct FrontierCell {
+    vtkIdType treeIndex;
+    vtkIdType vertexId;
+    unsigned int level;
+    unsigned int ijk[3];
+};
+
+// Trees of the grid with their cell values indexed by local vertex id while they are being adapted
+struct AdaptiveGrid {
+    vtkSmartPointer<vtkUniformHyperTreeGrid> hyperTreeGrid;
+    std::vector<vtkHyperTree*> trees;
+    std::vector<std::vector<double>> values;
+    std::vector<double> treeOrigins;
+};
+
+// Signed distance to a sphere, the field driving the adaptation
+struct SphereField {
+    double center[3];
+    double radius;
+
+    double Evaluate(const double point[3]) const {
+        double dx = point[0] - center[0];
+        double dy = point[1] - center[1];
+        double dz = point[2] - center[2];
+        return std::sqrt(dx * dx + dy * dy + dz * dz) - radius;
+    }
+};
+
+void CellCenter(const AdaptiveGrid& adaptive, vtkIdType treeIndex, unsigned int level, const unsigned int ijk[3],
+                double center[3], double& halfDiagonal) {
+    const double* scale = adaptive.hyperTreeGrid->GetGridScale();
+    double fraction = std::ldexp(1.0, -static_cast<int>(level));
+    double diagonal = 0.0;
+    for (int axis = 0; axis < 3; ++axis) {
+        double size = scale[axis] * fraction;
+        center[axis] = adaptive.treeOrigins[3 * treeIndex + axis] + (ijk[axis] + 0.5) * size;
+        diagonal += size * size;
+    }
+    halfDiagonal = 0.5 * std::sqrt(diagonal);
+}
+
+// A cell is refined while the interface may cross it and it is above the finest level
+bool NeedsRefinement(const SphereField& field, const double center[3], double halfDiagonal, unsigned int level,
+                     unsigned int maxLevel) {
+    return level < maxLevel && std::abs(field.Evaluate(center)) <= halfDiagonal;
+}
+
+void InitializeAdaptiveGrid(AdaptiveGrid& adaptive, const SphereField& field) {
+    vtkIdType numTrees = adaptive.hyperTreeGrid->GetMaxNumberOfTrees();
+    adaptive.trees.resize(numTrees);
+    adaptive.values.resize(numTrees);
+    adaptive.treeOrigins.resize(3 * numTrees);
+
+    // Creating a tree inserts it into the grid, so that part stays serial
+    const double* origin = adaptive.hyperTreeGrid->GetOrigin();
+    const double* scale = adaptive.hyperTreeGrid->GetGridScale();
+    for (vtkIdType treeIndex = 0; treeIndex < numTrees; ++treeIndex) {
+        adaptive.trees[treeIndex] = adaptive.hyperTreeGrid->GetTree(treeIndex, true);
+        unsigned int treeIjk[3];
+        adaptive.hyperTreeGrid->GetLevelZeroCoordinatesFromIndex(treeIndex, treeIjk[0], treeIjk[1], treeIjk[2]);
+        for (int axis = 0; axis < 3; ++axis) {
+            adaptive.treeOrigins[3 * treeIndex + axis] = origin[axis] + treeIjk[axis] * scale[axis];
+        }
+
+        unsigned int rootIjk[3] = { 0, 0, 0 };
+        double center[3];
+        double halfDiagonal;
+        CellCenter(adaptive, treeIndex, 0, rootIjk, center, halfDiagonal);
+        adaptive.values[treeIndex].assign(1, field.Evaluate(center));
+    }
+}
+
+void CollectLeaves(vtkHyperTreeGridNonOrientedCursor* cursor, unsigned int ijk[3], std::vector<FrontierCell>& leaves) {
+    if (cursor->IsLeaf()) {
+        FrontierCell cell = { cursor->GetTree()->GetTreeIndex(), cursor->GetVertexId(), cursor->GetLevel(), { ijk[0], ijk[1], ijk[2] } };
+        leaves.push_back(cell);
+        return;
+    }
+    for (unsigned char child = 0; child < cursor->GetNumberOfChildren(); ++child) {
+        unsigned int childIjk[3] = { 2 * ijk[0] + (child & 1), 2 * ijk[1] + ((child >> 1) & 1), 2 * ijk[2] + (child >> 2) };
+        cursor->ToChild(child);
+        CollectLeaves(cursor, childIjk, leaves);
+        cursor->ToParent();
+    }
+}
+
+// Concatenate per-tree lists into one flat frontier ordered by tree
+void FlattenFrontier(std::vector<std::vector<FrontierCell>>& perTree, std::vector<FrontierCell>& frontier,
+                     std::vector<vtkIdType>& treeStart) {
+    vtkIdType numTrees = static_cast<vtkIdType>(perTree.size());
+    treeStart.assign(numTrees + 1, 0);
+    for (vtkIdType treeIndex = 0; treeIndex < numTrees; ++treeIndex) {
+        treeStart[treeIndex + 1] = treeStart[treeIndex] + static_cast<vtkIdType>(perTree[treeIndex].size());
+    }
+    frontier.resize(treeStart[numTrees]);
+    vtkSMPTools::For(0, numTrees, [&](vtkIdType first, vtkIdType last) {
+        for (vtkIdType treeIndex = first; treeIndex < last; ++treeIndex) {
+            std::copy(perTree[treeIndex].begin(), perTree[treeIndex].end(), frontier.begin() + treeStart[treeIndex]);
+            perTree[treeIndex].clear();
+        }
+    });
+}
+
+// Refine every leaf of every tree against the field, one frontier round at a time. Each round first
+// evaluates the whole frontier in parallel, so one deep tree spreads over all threads as well as many
+// shallow ones; then each tree applies its own subdivisions, trees in parallel, since a vtkHyperTree
+// cannot take concurrent SubdivideLeaf calls.
+vtkIdType RefineAllTrees(AdaptiveGrid& adaptive, const SphereField& field, unsigned int maxLevel) {
+    vtkIdType numTrees = static_cast<vtkIdType>(adaptive.trees.size());
+    std::vector<std::vector<FrontierCell>> perTree(numTrees);
+
+    // Start from the current leaves, walked with one cursor per thread
+    vtkSMPThreadLocalObject<vtkHyperTreeGridNonOrientedCursor> cursors;
+    vtkSMPTools::For(0, numTrees, [&](vtkIdType first, vtkIdType last) {
+        vtkHyperTreeGridNonOrientedCursor* cursor = cursors.Local();
+        for (vtkIdType treeIndex = first; treeIndex < last; ++treeIndex) {
+            adaptive.hyperTreeGrid->InitializeNonOrientedCursor(cursor, treeIndex);
+            unsigned int rootIjk[3] = { 0, 0, 0 };
+            CollectLeaves(cursor, rootIjk, perTree[treeIndex]);
+        }
+    });
+
+    std::vector<FrontierCell> frontier;
+    std::vector<vtkIdType> treeStart;
+    std::vector<unsigned char> refine;
+    FlattenFrontier(perTree, frontier, treeStart);
+    vtkIdType numRefined = 0;
+    while (!frontier.empty()) {
+        // Evaluate the value and refinement decision of every frontier cell
+        refine.assign(frontier.size(), 0);
+        vtkSMPTools::For(0, static_cast<vtkIdType>(frontier.size()), [&](vtkIdType first, vtkIdType last) {
+            for (vtkIdType cellId = first; cellId < last; ++cellId) {
+                const FrontierCell& cell = frontier[cellId];
+                double center[3];
+                double halfDiagonal;
+                CellCenter(adaptive, cell.treeIndex, cell.level, cell.ijk, center, halfDiagonal);
+                adaptive.values[cell.treeIndex][cell.vertexId] = field.Evaluate(center);
+                refine[cellId] = NeedsRefinement(field, center, halfDiagonal, cell.level, maxLevel) ? 1 : 0;
+            }
+        });
+
+        // Subdivide, each tree on one thread, and queue the new children for the next round
+        vtkSMPTools::For(0, numTrees, 1, [&](vtkIdType first, vtkIdType last) {
+            for (vtkIdType treeIndex = first; treeIndex < last; ++treeIndex) {
+                vtkHyperTree* tree = adaptive.trees[treeIndex];
+                for (vtkIdType cellId = treeStart[treeIndex]; cellId < treeStart[treeIndex + 1]; ++cellId) {
+                    if (!refine[cellId]) {
+                        continue;
+                    }
+                    const FrontierCell& cell = frontier[cellId];
+                    tree->SubdivideLeaf(cell.vertexId, cell.level);
+                    vtkIdType elderChild = tree->GetElderChildIndex(static_cast<unsigned int>(cell.vertexId));
+                    for (unsigned int child = 0; child < 8; ++child) {
+                        FrontierCell childCell = { treeIndex, elderChild + child, cell.level + 1,
+                            { 2 * cell.ijk[0] + (child & 1), 2 * cell.ijk[1] + ((child >> 1) & 1), 2 * cell.ijk[2] + (child >> 2) } };
+                        perTree[treeIndex].push_back(childCell);
+                    }
+                }
+                adaptive.values[treeIndex].resize(tree->GetNumberOfVertices());
+            }
+        });
+
+        for (unsigned char decision : refine) {
+            numRefined += decision;
+        }
+        FlattenFrontier(perTree, frontier, treeStart);
+    }
+    return numRefined;
+}
+
+// Collapse every internal node the field no longer needs, rebuilding each tree that loses cells from its
+// pruned breadth-first descriptor, trees in parallel
+vtkIdType CoarsenAllTrees(AdaptiveGrid& adaptive, const SphereField& field, unsigned int maxLevel) {
+    vtkIdType numTrees = static_cast<vtkIdType>(adaptive.trees.size());
+    std::vector<vtkIdType> collapsedPerTree(numTrees, 0);
+    vtkSMPTools::For(0, numTrees, 1, [&](vtkIdType first, vtkIdType last) {
+        std::vector<double> values;
+        for (vtkIdType treeIndex = first; treeIndex < last; ++treeIndex) {
+            vtkHyperTree* tree = adaptive.trees[treeIndex];
+            if (tree->IsLeaf(0)) {
+                continue;
+            }
+            values.clear();
+            vtkIdType collapsed = 0;
+            vtkSmartPointer<vtkBitArray> descriptor = PruneBreadthFirst(tree, [&](const PrunedVertex& vertex) {
+                bool keep = false;
+                double value = adaptive.values[treeIndex][vertex.vertexId];
+                if (!tree->IsLeaf(vertex.vertexId)) {
+                    double center[3];
+                    double halfDiagonal;
+                    CellCenter(adaptive, treeIndex, vertex.level, vertex.ijk, center, halfDiagonal);
+                    keep = NeedsRefinement(field, center, halfDiagonal, vertex.level, maxLevel);
+                    if (!keep) {
+                        value = field.Evaluate(center);
+                        ++collapsed;
+                    }
+                }
+                values.push_back(value);
+                return keep;
+            });
+            if (collapsed == 0) {
+                continue;
+            }
+
+            RebuildTree(adaptive.hyperTreeGrid, tree, treeIndex, descriptor);
+            adaptive.values[treeIndex].swap(values);
+            collapsedPerTree[treeIndex] = collapsed;
+        }
+    });
+
+    vtkIdType numCollapsed = 0;
+    for (vtkIdType collapsed : collapsedPerTree) {
+        numCollapsed += collapsed;
+    }
+    return numCollapsed;
+}
+
+// Give each tree a contiguous run of global indices and gather the values into the grid's cell data
+void FinalizeCellData(AdaptiveGrid& adaptive, const char* name) {
+    vtkIdType numTrees = static_cast<vtkIdType>(adaptive.trees.size());
+    std::vector<vtkIdType> globalStart(numTrees + 1, 0);
+    for (vtkIdType treeIndex = 0; treeIndex < numTrees; ++treeIndex) {
+        globalStart[treeIndex + 1] = globalStart[treeIndex] + adaptive.trees[treeIndex]->GetNumberOfVertices();
+    }
+
+    vtkSmartPointer<vtkDoubleArray> cellData = vtkSmartPointer<vtkDoubleArray>::New();
+    cellData->SetName(name);
+    cellData->SetNumberOfComponents(1);
+    cellData->SetNumberOfTuples(globalStart[numTrees]);
+    double* cellValues = cellData->GetPointer(0);
+    vtkSMPTools::For(0, numTrees, [&](vtkIdType first, vtkIdType last) {
+        for (vtkIdType treeIndex = first; treeIndex < last; ++treeIndex) {
+            adaptive.trees[treeIndex]->SetGlobalIndexStart(globalStart[treeIndex]);
+            std::copy(adaptive.values[treeIndex].begin(), adaptive.values[treeIndex].end(),
+                      cellValues + globalStart[treeIndex]);
+        }
+    });
+    adaptive.hyperTreeGrid->GetCellData()->SetScalars(cellData);
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned int maxLevel = argc > 1 ? static_cast<unsigned int>(std::atoi(argv[1])) : 6;
+
+    // Create a uniform hyper tree grid
+    AdaptiveGrid adaptive;
+    adaptive.hyperTreeGrid = vtkSmartPointer<vtkUniformHyperTreeGrid>::New();
+    adaptive.hyperTreeGrid->SetDimensions(5, 5, 5); // 3D grid with 4x4x4 root trees
+    adaptive.hyperTreeGrid->SetBranchFactor(2); // Each cell can be divided into 2x2x2 subcells
+    adaptive.hyperTreeGrid->SetOrigin(0.0, 0.0, 0.0);
+    adaptive.hyperTreeGrid->SetGridScale(1.0, 1.0, 1.0);
+
+    SphereField field = { { 2.0, 2.0, 2.0 }, 1.2 };
+    InitializeAdaptiveGrid(adaptive, field);
+
+    // Refine all root trees in parallel
+    auto start = std::chrono::steady_clock::now();
+    vtkIdType numRefined = RefineAllTrees(adaptive, field, maxLevel);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Refined " << numRefined << " cells in " << seconds << " s ("
+              << (seconds > 0.0 ? numRefined / seconds : 0.0) << " cells/s)" << std::endl;
+
+    // Move the sphere, then coarsen what it left behind and refine where it arrived
+    field.center[0] = 2.6;
+    start = std::chrono::steady_clock::now();
+    vtkIdType numCollapsed = CoarsenAllTrees(adaptive, field, maxLevel);
+    numRefined = RefineAllTrees(adaptive, field, maxLevel);
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Collapsed " << numCollapsed << " and refined " << numRefined << " cells in "
+              << seconds << " s" << std::endl;
+
+    // Add cell data to the grid
+    FinalizeCellData(adaptive, "Distance");
+    std::cout << adaptive.hyperTreeGrid->GetCellData()->GetScalars()->GetNumberOfTuples() << " cells" << std::endl;
+
+    // The grid is now adapted to the moved sphere on every root tree. Any further processing can be done here.
+
+    return EXIT_SUCCESS;
+}
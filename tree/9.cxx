@@ -0,0 +1,257 @@
+#include <vtkSmartPointer.h>
+#include <vtkUniformHyperTreeGrid.h>
+#include <vtkHyperTree.h>
+#include <vtkHyperTreeGridNonOrientedGeometryCursor.h>
+#include <vtkHyperTreeGridNonOrientedVonNeumannSuperCursor.h>
+#include <vtkDoubleArray.h>
+#include <vtkCellData.h>
+#include <vtkSMPTools.h>
+#include <vtkSMPThreadLocal.h>
+#include <vtkSMPThreadLocalObject.h>
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+// Offsets of the Von Neumann super cursor entries: -z, -y, -x, center, +x, +y, +z
+static const int VonNeumannOffsets[7][3] = {
+    { 0, 0, -1 }, { 0, -1, 0 }, { -1, 0, 0 }, { 0, 0, 0 }, { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 }
+};
+
+// A cell addressed by its level and its integer coordinates over the whole grid at that level
+struct LatticeCell {
+    unsigned int level;
+    vtkIdType ijk[3];
+};
+
+// Trees of the grid with their cell values indexed by local vertex id while they are being refined
+struct BalancedGrid {
+    vtkSmartPointer<vtkUniformHyperTreeGrid> hyperTreeGrid;
+    unsigned int treeDims[3];
+    std::vector<std::vector<double>> values;
+};
+
+// Subdivide a leaf, injecting its value into the eight new children
+void SubdivideLeaf(BalancedGrid& balanced, vtkIdType treeIndex, vtkIdType vertexId, unsigned int level) {
+    vtkHyperTree* tree = balanced.hyperTreeGrid->GetTree(treeIndex);
+    std::vector<double>& values = balanced.values[treeIndex];
+    double value = values[vertexId];
+    tree->SubdivideLeaf(vertexId, level);
+    values.resize(tree->GetNumberOfVertices(), value);
+}
+
+// Descend from the root tree towards a lattice cell and stop at the leaf containing it or at its level
+bool FindCell(BalancedGrid& balanced, const LatticeCell& cell, vtkIdType& treeIndex, vtkIdType& vertexId,
+              unsigned int& level) {
+    vtkIdType treeIjk[3];
+    for (int axis = 0; axis < 3; ++axis) {
+        if (cell.ijk[axis] < 0) {
+            return false;
+        }
+        treeIjk[axis] = cell.ijk[axis] >> cell.level;
+        if (treeIjk[axis] >= static_cast<vtkIdType>(balanced.treeDims[axis])) {
+            return false;
+        }
+    }
+    balanced.hyperTreeGrid->GetIndexFromLevelZeroCoordinates(treeIndex, static_cast<unsigned int>(treeIjk[0]),
+        static_cast<unsigned int>(treeIjk[1]), static_cast<unsigned int>(treeIjk[2]));
+    vtkHyperTree* tree = balanced.hyperTreeGrid->GetTree(treeIndex);
+    if (!tree) {
+        return false;
+    }
+
+    vertexId = 0;
+    level = 0;
+    while (level < cell.level && !tree->IsLeaf(vertexId)) {
+        unsigned int shift = cell.level - level - 1;
+        unsigned int child = ((cell.ijk[0] >> shift) & 1) | (((cell.ijk[1] >> shift) & 1) << 1) | (((cell.ijk[2] >> shift) & 1) << 2);
+        vertexId = tree->GetElderChildIndex(static_cast<unsigned int>(vertexId)) + child;
+        ++level;
+    }
+    return true;
+}
+
+// For every face neighbor leaf more than one level coarser than the leaf under the cursor, queue the
+// cell one level above that leaf which has to exist on the neighbor's side
+void ScanLeaves(vtkHyperTreeGridNonOrientedVonNeumannSuperCursor* cursor, const vtkIdType ijk[3],
+                std::vector<LatticeCell>& worklist) {
+    unsigned int level = cursor->GetLevel();
+    if (!cursor->IsLeaf()) {
+        for (unsigned char child = 0; child < cursor->GetNumberOfChildren(); ++child) {
+            vtkIdType childIjk[3] = { 2 * ijk[0] + (child & 1), 2 * ijk[1] + ((child >> 1) & 1), 2 * ijk[2] + (child >> 2) };
+            cursor->ToChild(child);
+            ScanLeaves(cursor, childIjk, worklist);
+            cursor->ToParent();
+        }
+        return;
+    }
+
+    unsigned int central = cursor->GetNumberOfCursors() / 2;
+    for (unsigned int neighbor = 0; neighbor < cursor->GetNumberOfCursors(); ++neighbor) {
+        if (neighbor == central || !cursor->HasTree(neighbor)) {
+            continue;
+        }
+        if (cursor->GetLevel(neighbor) + 1 < level && cursor->IsLeaf(neighbor)) {
+            LatticeCell required = { level - 1, {
+                (ijk[0] + VonNeumannOffsets[neighbor][0]) >> 1,
+                (ijk[1] + VonNeumannOffsets[neighbor][1]) >> 1,
+                (ijk[2] + VonNeumannOffsets[neighbor][2]) >> 1 } };
+            worklist.push_back(required);
+        }
+    }
+}
+
+// Walk every leaf once with a Von Neumann super cursor per thread and gather the violations
+std::vector<LatticeCell> ScanViolations(BalancedGrid& balanced) {
+    vtkIdType numTrees = balanced.hyperTreeGrid->GetMaxNumberOfTrees();
+    vtkSMPThreadLocalObject<vtkHyperTreeGridNonOrientedVonNeumannSuperCursor> cursors;
+    vtkSMPThreadLocal<std::vector<LatticeCell>> localWorklists;
+    vtkSMPTools::For(0, numTrees, [&](vtkIdType first, vtkIdType last) {
+        vtkHyperTreeGridNonOrientedVonNeumannSuperCursor* cursor = cursors.Local();
+        std::vector<LatticeCell>& worklist = localWorklists.Local();
+        for (vtkIdType treeIndex = first; treeIndex < last; ++treeIndex) {
+            if (!balanced.hyperTreeGrid->GetTree(treeIndex)) {
+                continue;
+            }
+            balanced.hyperTreeGrid->InitializeNonOrientedVonNeumannSuperCursor(cursor, treeIndex);
+            unsigned int treeIjk[3];
+            balanced.hyperTreeGrid->GetLevelZeroCoordinatesFromIndex(treeIndex, treeIjk[0], treeIjk[1], treeIjk[2]);
+            vtkIdType rootIjk[3] = { treeIjk[0], treeIjk[1], treeIjk[2] };
+            ScanLeaves(cursor, rootIjk, worklist);
+        }
+    });
+
+    std::vector<LatticeCell> worklist;
+    for (std::vector<LatticeCell>& local : localWorklists) {
+        worklist.insert(worklist.end(), local.begin(), local.end());
+    }
+    return worklist;
+}
+
+// Enforce 2:1 face balance. The worklist holds cells that must exist; reaching one subdivides the
+// leaf covering it down to its level, and each subdivision at level l in turn requires the six face
+// neighbors at level l. One scan seeds the worklist and the ripple stops once it drains, so every
+// leaf is visited once plus a constant per refinement.
+vtkIdType BalanceTwoToOne(BalancedGrid& balanced) {
+    std::vector<LatticeCell> worklist = ScanViolations(balanced);
+    vtkIdType numRefined = 0;
+    while (!worklist.empty()) {
+        LatticeCell required = worklist.back();
+        worklist.pop_back();
+
+        vtkIdType treeIndex;
+        vtkIdType vertexId;
+        unsigned int level;
+        if (!FindCell(balanced, required, treeIndex, vertexId, level)) {
+            continue;
+        }
+        vtkHyperTree* tree = balanced.hyperTreeGrid->GetTree(treeIndex);
+        while (level < required.level) {
+            SubdivideLeaf(balanced, treeIndex, vertexId, level);
+            ++numRefined;
+
+            // The new children need every face neighbor at this level or finer
+            unsigned int shift = required.level - level;
+            for (unsigned int neighbor = 0; neighbor < 7; ++neighbor) {
+                if (neighbor == 3) {
+                    continue;
+                }
+                LatticeCell adjacent = { level, {
+                    (required.ijk[0] >> shift) + VonNeumannOffsets[neighbor][0],
+                    (required.ijk[1] >> shift) + VonNeumannOffsets[neighbor][1],
+                    (required.ijk[2] >> shift) + VonNeumannOffsets[neighbor][2] } };
+                vtkIdType neighborTree;
+                vtkIdType neighborVertex;
+                unsigned int neighborLevel;
+                if (FindCell(balanced, adjacent, neighborTree, neighborVertex, neighborLevel) && neighborLevel < level) {
+                    worklist.push_back(adjacent);
+                }
+            }
+
+            // Continue into the child on the way to the required cell
+            --shift;
+            unsigned int child = ((required.ijk[0] >> shift) & 1) | (((required.ijk[1] >> shift) & 1) << 1) |
+                (((required.ijk[2] >> shift) & 1) << 2);
+            vertexId = tree->GetElderChildIndex(static_cast<unsigned int>(vertexId)) + child;
+            ++level;
+        }
+    }
+    return numRefined;
+}
+
+// Refine the leaves containing a point down to the given level, leaving their neighbors coarse
+void RefineTowardPoint(BalancedGrid& balanced, vtkHyperTreeGridNonOrientedGeometryCursor* cursor, const double point[3],
+                       unsigned int maxLevel) {
+    double bounds[6];
+    cursor->GetBounds(bounds);
+    if (point[0] < bounds[0] || point[0] > bounds[1] || point[1] < bounds[2] || point[1] > bounds[3] ||
+        point[2] < bounds[4] || point[2] > bounds[5] || cursor->GetLevel() >= maxLevel) {
+        return;
+    }
+    if (cursor->IsLeaf()) {
+        SubdivideLeaf(balanced, cursor->GetTree()->GetTreeIndex(), cursor->GetVertexId(), cursor->GetLevel());
+    }
+    for (unsigned char child = 0; child < cursor->GetNumberOfChildren(); ++child) {
+        cursor->ToChild(child);
+        RefineTowardPoint(balanced, cursor, point, maxLevel);
+        cursor->ToParent();
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned int maxLevel = argc > 1 ? static_cast<unsigned int>(std::atoi(argv[1])) : 7;
+
+    // Create a uniform hyper tree grid
+    BalancedGrid balanced;
+    balanced.hyperTreeGrid = vtkSmartPointer<vtkUniformHyperTreeGrid>::New();
+    balanced.hyperTreeGrid->SetDimensions(5, 5, 5); // 3D grid with 4x4x4 root trees
+    balanced.hyperTreeGrid->SetBranchFactor(2); // Each cell can be divided into 2x2x2 subcells
+    balanced.hyperTreeGrid->SetOrigin(0.0, 0.0, 0.0);
+    balanced.hyperTreeGrid->SetGridScale(1.0, 1.0, 1.0);
+    for (int axis = 0; axis < 3; ++axis) {
+        balanced.treeDims[axis] = 4;
+    }
+
+    vtkIdType numTrees = balanced.hyperTreeGrid->GetMaxNumberOfTrees();
+    balanced.values.resize(numTrees);
+    for (vtkIdType treeIndex = 0; treeIndex < numTrees; ++treeIndex) {
+        balanced.hyperTreeGrid->GetTree(treeIndex, true);
+        balanced.values[treeIndex].assign(1, static_cast<double>(treeIndex));
+    }
+
+    // Refine sharply around two points so that neighboring leaves differ by several levels
+    vtkSmartPointer<vtkHyperTreeGridNonOrientedGeometryCursor> cursor =
+        vtkSmartPointer<vtkHyperTreeGridNonOrientedGeometryCursor>::New();
+    const double points[2][3] = { { 1.0, 1.0, 1.0 }, { 2.7, 3.1, 0.4 } };
+    for (const double* point : points) {
+        for (vtkIdType treeIndex = 0; treeIndex < numTrees; ++treeIndex) {
+            balanced.hyperTreeGrid->InitializeNonOrientedGeometryCursor(cursor, treeIndex);
+            RefineTowardPoint(balanced, cursor, point, maxLevel);
+        }
+    }
+
+    // Ensure 2:1 balance
+    std::cout << ScanViolations(balanced).size() << " violations before balancing" << std::endl;
+    vtkIdType numRefined = BalanceTwoToOne(balanced);
+    std::cout << numRefined << " cells refined, " << ScanViolations(balanced).size()
+              << " violations after balancing" << std::endl;
+
+    // Give each tree a contiguous run of global indices and add cell data to the grid
+    vtkSmartPointer<vtkDoubleArray> cellData = vtkSmartPointer<vtkDoubleArray>::New();
+    cellData->SetName("CellData");
+    cellData->SetNumberOfComponents(1);
+    vtkIdType globalIndex = 0;
+    for (vtkIdType treeIndex = 0; treeIndex < numTrees; ++treeIndex) {
+        balanced.hyperTreeGrid->GetTree(treeIndex)->SetGlobalIndexStart(globalIndex);
+        for (double value : balanced.values[treeIndex]) {
+            cellData->InsertNextValue(value);
+        }
+        globalIndex += static_cast<vtkIdType>(balanced.values[treeIndex].size());
+    }
+    balanced.hyperTreeGrid->GetCellData()->SetScalars(cellData);
+
+    // The grid is now 2:1 balanced across faces, including across root tree boundaries.
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,63 @@
+#ifndef HyperTreePruning_h
+#define HyperTreePruning_h
+
+#include <vtkSmartPointer.h>
+#include <vtkHyperTreeGrid.h>
+#include <vtkHyperTree.h>
+#include <vtkBitArray.h>
+
+#include <vector>
+
+// Coarsening a hyper tree. vtkHyperTree can subdivide a leaf but not collapse a refined cell, so the
+// programs that coarsen describe the tree they want breadth first and build the tree again from that
+// descriptor. The new tree numbers its vertices in the order of the descriptor.
+
+// A vertex of the tree being pruned, with its level and its coordinates at that level inside the tree
+struct PrunedVertex {
+    vtkIdType vertexId;
+    unsigned int level;
+    unsigned int ijk[3];
+};
+
+// Walk a tree breadth first and describe it without the families that 'keep' drops. 'keep(vertex)' is
+// called once for every vertex of the pruned tree, in the order the rebuilt tree numbers them, and
+// returns whether the vertex stays refined; what it returns for a leaf is ignored.
+template <typename KeepT>
+vtkSmartPointer<vtkBitArray> PruneBreadthFirst(vtkHyperTree* tree, KeepT keep) {
+    unsigned int branchFactor = tree->GetBranchFactor();
+    unsigned int numChildren = tree->GetNumberOfChildren();
+    vtkSmartPointer<vtkBitArray> descriptor = vtkSmartPointer<vtkBitArray>::New();
+    std::vector<PrunedVertex> levelVertices(1, PrunedVertex{ 0, 0, { 0, 0, 0 } });
+    std::vector<PrunedVertex> nextVertices;
+    while (!levelVertices.empty()) {
+        nextVertices.clear();
+        for (const PrunedVertex& vertex : levelVertices) {
+            bool refined = keep(vertex) && !tree->IsLeaf(vertex.vertexId);
+            descriptor->InsertNextValue(refined ? 1 : 0);
+            if (!refined) {
+                continue;
+            }
+            vtkIdType elderChild = tree->GetElderChildIndex(static_cast<unsigned int>(vertex.vertexId));
+            for (unsigned int child = 0; child < numChildren; ++child) {
+                nextVertices.push_back(PrunedVertex{ elderChild + child, vertex.level + 1, {
+                    branchFactor * vertex.ijk[0] + child % branchFactor,
+                    branchFactor * vertex.ijk[1] + (child / branchFactor) % branchFactor,
+                    branchFactor * vertex.ijk[2] + child / (branchFactor * branchFactor) } });
+            }
+        }
+        levelVertices.swap(nextVertices);
+    }
+    return descriptor;
+}
+
+// Build a tree of the grid again from a pruned descriptor. Initialize() also clears the tree index,
+// which is set back before the vertices are created.
+inline void RebuildTree(vtkHyperTreeGrid* hyperTreeGrid, vtkHyperTree* tree, vtkIdType treeIndex,
+                        vtkBitArray* descriptor) {
+    tree->Initialize(static_cast<unsigned char>(hyperTreeGrid->GetBranchFactor()),
+        static_cast<unsigned char>(hyperTreeGrid->GetDimension()), static_cast<unsigned char>(tree->GetNumberOfChildren()));
+    tree->SetTreeIndex(treeIndex);
+    tree->BuildFromBreadthFirstOrderDescriptor(descriptor, descriptor->GetNumberOfTuples());
+}
+
+#endif